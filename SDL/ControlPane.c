@@ -7,6 +7,7 @@
 #include "armarc.h"
 #include "ControlPane.h"
 #include "arch/dbugsys.h"
+#include "arch/hdc63463.h"
 
 #include <stdarg.h>
 #include <stdio.h>
@@ -38,10 +39,35 @@ void ControlPane_Error(int code,const char *fmt,...)
   log_msgv(LOG_ERROR,fmt,args);
   va_end(args);
 #endif
+  /* Don't lose any disc changes that haven't been written back yet */
+  FDC_Sync();
+  HDC_Sync();
+
   /* Quit */
   exit(code);
 }
 
+void ControlPane_Warning(const char *fmt,...)
+{
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+  va_list args;
+  char err[100];
+
+  va_start(args,fmt);
+  SDL_vsnprintf(err, sizeof(err), fmt, args);
+  va_end(args);
+
+  SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_WARNING, "ArcEm", err, NULL);
+  log_msg(LOG_WARN, "%s", err);
+#else
+  va_list args;
+
+  va_start(args,fmt);
+  log_msgv(LOG_WARN,fmt,args);
+  va_end(args);
+#endif
+}
+
 void log_msgv(int type, const char *format, va_list ap)
 {
 #if SDL_VERSION_ATLEAST(2, 0, 0)
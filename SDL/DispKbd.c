@@ -116,6 +116,19 @@ static void ProcessMouseMotion(ARMul_State *state, const SDL_MouseMotionEvent *m
 
 }
 
+/*-----------------------------------------------------------------------------*/
+bool
+Kbd_HostInputPending(ARMul_State *state)
+{
+  SDL_PumpEvents();
+#if SDL_VERSION_ATLEAST(2, 0, 0)
+  return SDL_HasEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+#else
+  SDL_Event event;
+  return SDL_PeepEvents(&event, 1, SDL_PEEKEVENT, SDL_ALLEVENTS) > 0;
+#endif
+}
+
 /*-----------------------------------------------------------------------------*/
 int
 Kbd_PollHostKbd(ARMul_State *state)
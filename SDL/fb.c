@@ -19,6 +19,7 @@
 #include "archio.h"
 #include "arch/dbugsys.h"
 #include "arch/displaydev.h"
+#include "arch/ArcemConfig.h"
 #include "ControlPane.h"
 
 /* An upper limit on how big to support monitor size, used for
@@ -49,6 +50,7 @@ static void PollDisplay(ARMul_State *state,int XScale,int YScale);
 #define SDD_Name(x) sdd16_##x
 #define SDD_RowsAtOnce 1
 #define SDD_Row SDD_HostColour *
+#define SDD_DirectRow
 #define SDD_DisplayDev SDD16_DisplayDev
 
 static SDD_HostColour SDD_Name(Host_GetColour)(ARMul_State *state,unsigned int col) { return GetColour(state, col); }
@@ -123,6 +125,7 @@ static void SDD_Name(Host_PollDisplay)(ARMul_State *state) {
 #undef SDD_Name
 #undef SDD_RowsAtOnce
 #undef SDD_Row
+#undef SDD_DirectRow
 #undef SDD_DisplayDev
 
 /* Standard display device, 32bpp */
@@ -131,6 +134,7 @@ static void SDD_Name(Host_PollDisplay)(ARMul_State *state) {
 #define SDD_Name(x) sdd32_##x
 #define SDD_RowsAtOnce 1
 #define SDD_Row SDD_HostColour *
+#define SDD_DirectRow
 #define SDD_DisplayDev SDD32_DisplayDev
 
 static SDD_HostColour SDD_Name(Host_GetColour)(ARMul_State *state,unsigned int col) { return GetColour(state, col); }
@@ -205,6 +209,7 @@ static void SDD_Name(Host_PollDisplay)(ARMul_State *state) {
 #undef SDD_Name
 #undef SDD_RowsAtOnce
 #undef SDD_Row
+#undef SDD_DirectRow
 #undef SDD_DisplayDev
 
 /* ------------------------------------------------------------------ */
@@ -452,6 +457,7 @@ static void PollDisplay(ARMul_State *state,int XScale,int YScale)
 
   SDL_BlitSurface(sdd_surface, NULL, screen, NULL);
   SDL_BlitSurface(mouse_surface, NULL, screen, &mouse_rect);
+  DisplayDev_HostBytes += sdd_surface->pitch*sdd_surface->h;
 
 #if SDL_VERSION_ATLEAST(2, 0, 0)
   SDL_UpdateWindowSurface(window);
@@ -463,6 +469,10 @@ static void PollDisplay(ARMul_State *state,int XScale,int YScale)
 /*-----------------------------------------------------------------------------*/
 int DisplayDev_Init(ARMul_State *state)
 {
+  if (CONFIG.bHeadless) {
+    return DisplayDev_Set(state,&NullDD_DisplayDev);
+  }
+
   /* Setup display and cursor bitmaps */
 #if SDL_VERSION_ATLEAST(2, 0, 0)
   window = SDL_CreateWindow("ArcEm", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
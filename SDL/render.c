@@ -8,6 +8,7 @@
 */
 
 #include <SDL.h>
+#include <limits.h>
 
 #if SDL_VERSION_ATLEAST(2, 0, 0)
 
@@ -16,6 +17,7 @@
 #include "archio.h"
 #include "arch/dbugsys.h"
 #include "arch/displaydev.h"
+#include "arch/ArcemConfig.h"
 #include "ControlPane.h"
 
 /* An upper limit on how big to support monitor size, used for
@@ -36,10 +38,34 @@ static SDL_Texture *mouse_texture = NULL;
 static SDL_Rect mouse_rect;
 static int xscale = 1, yscale = 1;
 
+/* Parts of sdd_surface which need uploading to sdd_texture. Rows with
+   dirty_maxx < 0 are clean. */
+static int dirty_miny = INT_MAX, dirty_maxy = -1;
+static int dirty_minx[MaxVideoHeight], dirty_maxx[MaxVideoHeight];
+
 static uint32_t GetColour(ARMul_State *state,unsigned int col);
 static void SetupScreen(ARMul_State *state,int width,int height,int hz);
 static void PollDisplay(ARMul_State *state);
 
+/* Note that 'count' pixels from 'pixels' onwards have been written to */
+static inline void MarkDirty(const void *pixels,unsigned int count)
+{
+  size_t offset = (const uint8_t *)pixels - (const uint8_t *)sdd_surface->pixels;
+  int y = offset / sdd_surface->pitch;
+  int x = (offset % sdd_surface->pitch) / sdd_surface->format->BytesPerPixel;
+  if (!count)
+    return;
+  if (dirty_maxx[y] < 0) {
+    dirty_minx[y] = x;
+    dirty_maxx[y] = x+count-1;
+  } else {
+    dirty_minx[y] = MIN(dirty_minx[y], x);
+    dirty_maxx[y] = MAX(dirty_maxx[y], (int)(x+count-1));
+  }
+  dirty_miny = MIN(dirty_miny, y);
+  dirty_maxy = MAX(dirty_maxy, y);
+}
+
 /* ------------------------------------------------------------------ */
 
 /* Standard display device, 16bpp */
@@ -48,6 +74,7 @@ static void PollDisplay(ARMul_State *state);
 #define SDD_Name(x) sdd16_##x
 #define SDD_RowsAtOnce 1
 #define SDD_Row SDD_HostColour *
+#define SDD_DirectRow
 #define SDD_DisplayDev SDD16R_DisplayDev
 
 static SDD_HostColour SDD_Name(Host_GetColour)(ARMul_State *state,unsigned int col) { return GetColour(state, col); }
@@ -61,7 +88,7 @@ static inline SDD_Row SDD_Name(Host_BeginRow)(ARMul_State *state,int row,int off
 
 static inline void SDD_Name(Host_EndRow)(ARMul_State *state,SDD_Row *row) { /* nothing */ }
 
-static inline void SDD_Name(Host_BeginUpdate)(ARMul_State *state,SDD_Row *row,unsigned int count) { /* nothing */ }
+static inline void SDD_Name(Host_BeginUpdate)(ARMul_State *state,SDD_Row *row,unsigned int count) { MarkDirty(*row, count); }
 
 static inline void SDD_Name(Host_EndUpdate)(ARMul_State *state,SDD_Row *row) { /* nothing */ }
 
@@ -94,6 +121,7 @@ static void SDD_Name(Host_ChangeMode)(ARMul_State *state,int width,int height,in
 #undef SDD_Name
 #undef SDD_RowsAtOnce
 #undef SDD_Row
+#undef SDD_DirectRow
 #undef SDD_DisplayDev
 
 /* Standard display device, 32bpp */
@@ -102,6 +130,7 @@ static void SDD_Name(Host_ChangeMode)(ARMul_State *state,int width,int height,in
 #define SDD_Name(x) sdd32_##x
 #define SDD_RowsAtOnce 1
 #define SDD_Row SDD_HostColour *
+#define SDD_DirectRow
 #define SDD_DisplayDev SDD32R_DisplayDev
 
 static SDD_HostColour SDD_Name(Host_GetColour)(ARMul_State *state,unsigned int col) { return GetColour(state, col); }
@@ -115,7 +144,7 @@ static inline SDD_Row SDD_Name(Host_BeginRow)(ARMul_State *state,int row,int off
 
 static inline void SDD_Name(Host_EndRow)(ARMul_State *state,SDD_Row *row) { /* nothing */ }
 
-static inline void SDD_Name(Host_BeginUpdate)(ARMul_State *state,SDD_Row *row,unsigned int count) { /* nothing */ }
+static inline void SDD_Name(Host_BeginUpdate)(ARMul_State *state,SDD_Row *row,unsigned int count) { MarkDirty(*row, count); }
 
 static inline void SDD_Name(Host_EndUpdate)(ARMul_State *state,SDD_Row *row) { /* nothing */ }
 
@@ -148,6 +177,7 @@ static void SDD_Name(Host_ChangeMode)(ARMul_State *state,int width,int height,in
 #undef SDD_Name
 #undef SDD_RowsAtOnce
 #undef SDD_Row
+#undef SDD_DirectRow
 #undef SDD_DisplayDev
 
 /* ------------------------------------------------------------------ */
@@ -230,8 +260,13 @@ static void RefreshMouse(ARMul_State *state) {
 
 static void SetupScreen(ARMul_State *state,int width,int height,int hz)
 {
-  /* TODO: Use SDL_LockTexture() instead of creating a separate surface? */
-  if (!sdd_surface)
+  int y;
+
+  /* The display driver only redraws the parts of the screen which have
+     changed, so it needs a buffer which keeps its contents between frames.
+     Memory from SDL_LockTexture() is write-only and may be a fresh buffer
+     each time, so draw into a surface and upload just the dirty rows. */
+  if (sdd_surface)
     SDL_FreeSurface(sdd_surface);
   sdd_surface = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height,
                                      format->BitsPerPixel,
@@ -240,10 +275,21 @@ static void SetupScreen(ARMul_State *state,int width,int height,int hz)
                                      format->Bmask,
                                      format->Amask);
 
-  if (!sdd_texture)
+  if (sdd_texture)
     SDL_DestroyTexture(sdd_texture);
   sdd_texture = SDL_CreateTexture(renderer, format->format, SDL_TEXTUREACCESS_STREAMING, width, height);
 
+  /* New texture, so everything needs uploading */
+  for (y = 0; y < height; y++) {
+    dirty_minx[y] = 0;
+    dirty_maxx[y] = width-1;
+  }
+  for (; y < MaxVideoHeight; y++) {
+    dirty_maxx[y] = -1;
+  }
+  dirty_miny = 0;
+  dirty_maxy = height-1;
+
   /* Try and detect rectangular pixel modes */
   if((width >= height*2) && (height*2 <= MaxVideoHeight))
   {
@@ -275,9 +321,46 @@ static void SetupScreen(ARMul_State *state,int width,int height,int hz)
   SDL_RenderSetLogicalSize(renderer, width, height);
 }
 
+/* Upload the dirty parts of sdd_surface to sdd_texture. Each run of
+   consecutive dirty rows is sent as one rectangle, spanning the union of the
+   dirty columns of those rows. */
+static void UploadDirty(void)
+{
+  int bpp = sdd_surface->format->BytesPerPixel;
+  int y = dirty_miny;
+
+  while (y <= dirty_maxy) {
+    SDL_Rect rect;
+    int minx = dirty_minx[y];
+    int maxx = dirty_maxx[y];
+
+    if (maxx < 0) {
+      y++;
+      continue;
+    }
+    rect.y = y;
+    do {
+      minx = MIN(minx, dirty_minx[y]);
+      maxx = MAX(maxx, dirty_maxx[y]);
+      dirty_maxx[y] = -1;
+      y++;
+    } while ((y <= dirty_maxy) && (dirty_maxx[y] >= 0));
+    rect.x = minx;
+    rect.w = maxx-minx+1;
+    rect.h = y-rect.y;
+
+    SDL_UpdateTexture(sdd_texture, &rect,
+                      (uint8_t *)sdd_surface->pixels + rect.y*sdd_surface->pitch + rect.x*bpp,
+                      sdd_surface->pitch);
+    DisplayDev_HostBytes += rect.w*rect.h*bpp;
+  }
+  dirty_miny = INT_MAX;
+  dirty_maxy = -1;
+}
+
 static void PollDisplay(ARMul_State *state)
 {
-  SDL_UpdateTexture(sdd_texture, NULL, sdd_surface->pixels, sdd_surface->pitch);
+  UploadDirty();
   RefreshMouse(state);
 
   DisplayDev_GetCursorPos(state,&mouse_rect.x,&mouse_rect.y);
@@ -296,6 +379,10 @@ int DisplayDev_Init(ARMul_State *state)
   Uint32 i, fmt, pf = SDL_PIXELFORMAT_UNKNOWN;
   SDL_RendererInfo info;
 
+  if (CONFIG.bHeadless) {
+    return DisplayDev_Set(state,&NullDD_DisplayDev);
+  }
+
   /* Setup display and cursor bitmaps */
   window = SDL_CreateWindow("ArcEm", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
                             640, 512, SDL_WINDOW_RESIZABLE);
@@ -6,6 +6,7 @@
 #include "X11/Xutil.h"
 #include "X11/keysym.h"
 #include "X11/extensions/shape.h"
+#include "X11/extensions/XShm.h"
 
 #include "../armdefs.h"
 #include "archio.h"
@@ -15,6 +16,7 @@
 #include "arch/displaydev.h"
 #include "platform.h"
 #include "arch/keyboard.h"
+#include "arch/hdc63463.h"
 
 #include <string.h>
 #include <stdarg.h>
@@ -147,7 +149,8 @@ static void ControlPane_Redraw(ARMul_State *state, XExposeEvent *e) {
             0, y, CTRLPANEWIDTH-1, y);
 
   y += 2;
-  y = TextCenteredH(state, "Type `q' to quit.", y, 0, CTRLPANEWIDTH);
+  y = TextCenteredH(state, "Type `q' to quit, or `s' to save changes to disc "
+      "images.", y, 0, CTRLPANEWIDTH);
 
   y += 2;
   y = TextCenteredH(state, "Type `0', `1', `2', or `3' to "
@@ -171,6 +174,13 @@ void ControlPane_Event(ARMul_State *state, XEvent *event) {
       if (sym >= XK_0 && sym <= XK_3) {
         insert_or_eject_floppy(sym - XK_0);
 
+      } else if (sym == XK_s) {
+        /* Both, even if one fails */
+        bool saved = FDC_Sync();
+        if (HDC_Sync() && saved) {
+          warn_fdc("disc images saved\n");
+        }
+
       } else if (sym == XK_q) {
         warn("arcem: user requested exit\n");
         hostdisplay_change_focus(false);
@@ -254,10 +264,24 @@ void ControlPane_Error(int code,const char *fmt,...)
   log_msgv(LOG_ERROR,fmt,args);
   va_end(args);
 
+  /* Don't lose any disc changes that haven't been written back yet */
+  FDC_Sync();
+  HDC_Sync();
+
   /* Quit */
   exit(code);
 }
 
+void ControlPane_Warning(const char *fmt,...)
+{
+  va_list args;
+
+  /* Log it */
+  va_start(args,fmt);
+  log_msgv(LOG_WARN,fmt,args);
+  va_end(args);
+}
+
 
 /*----------------------------------------------------------------------------*/
 
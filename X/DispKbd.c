@@ -10,12 +10,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 
 #include <X11/X.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/keysym.h>
 #include <X11/extensions/shape.h>
+#include <X11/extensions/XShm.h>
 
 #if defined(sun) && defined(__SVR4)
 # include <X11/Sunkeysym.h>
@@ -31,6 +36,7 @@
 #include "arch/sound.h"
 #endif
 #include "arch/displaydev.h"
+#include "arch/ArcemConfig.h"
 
 #include "ControlPane.h"
 #include "platform.h"
@@ -323,6 +329,175 @@ static int DisplayKbd_XError(Display* disp, XErrorEvent *err)
   exit(EXIT_FAILURE);
 }
 
+/*----------------------------------------------------------------------------*/
+
+static bool shm_attach_failed;
+
+static int ShmAttach_XError(Display* disp, XErrorEvent *err)
+{
+  shm_attach_failed = true;
+  return 0;
+}
+
+/* Try and create a MIT-SHM backed display image. Returns false if the server
+   won't play ball, e.g. because it's on a different machine */
+static bool CreateShmDisplayImage(int x,int y)
+{
+  int (*handler)(Display *, XErrorEvent *);
+
+  PD.DisplayImage = XShmCreateImage(PD.disp,
+                                    DefaultVisual(PD.disp, PD.ScreenNum),
+                                    PD.visInfo.depth, ZPixmap, NULL,
+                                    &PD.ShmInfo, x, y);
+  if (!PD.DisplayImage) {
+    return false;
+  }
+
+  PD.ShmInfo.shmid = shmget(IPC_PRIVATE,
+                            PD.DisplayImage->bytes_per_line * y,
+                            IPC_CREAT | 0600);
+  if (PD.ShmInfo.shmid < 0) {
+    XDestroyImage(PD.DisplayImage);
+    return false;
+  }
+
+  PD.ShmInfo.shmaddr = shmat(PD.ShmInfo.shmid, NULL, 0);
+  if (PD.ShmInfo.shmaddr == (char *) -1) {
+    shmctl(PD.ShmInfo.shmid, IPC_RMID, NULL);
+    XDestroyImage(PD.DisplayImage);
+    return false;
+  }
+  PD.ShmInfo.readOnly = False;
+
+  /* Attach failures are reported asynchronously, so sync before and after
+     to make sure any error is caught by our handler */
+  XSync(PD.disp, False);
+  shm_attach_failed = false;
+  handler = XSetErrorHandler(ShmAttach_XError);
+  XShmAttach(PD.disp, &PD.ShmInfo);
+  XSync(PD.disp, False);
+  XSetErrorHandler(handler);
+
+  /* Mark for deletion now, so the segment goes away when we exit */
+  shmctl(PD.ShmInfo.shmid, IPC_RMID, NULL);
+
+  if (shm_attach_failed) {
+    shmdt(PD.ShmInfo.shmaddr);
+    XDestroyImage(PD.DisplayImage);
+    return false;
+  }
+
+  PD.ImageData = PD.DisplayImage->data = PD.ShmInfo.shmaddr;
+  return true;
+}
+
+static void CreateDisplayImage(int x,int y)
+{
+  if (PD.UseShm) {
+    if (CreateShmDisplayImage(x, y)) {
+      return;
+    }
+    warn("arcem: MIT-SHM not available, using XPutImage.\n");
+    PD.UseShm = false;
+  }
+
+  PD.ImageData = emalloc(x * 4 * y, "host screen image memory");
+  PD.DisplayImage = XCreateImage(PD.disp,
+                                 DefaultVisual(PD.disp, PD.ScreenNum),
+                                 PD.visInfo.depth, ZPixmap, 0,
+                                 PD.ImageData,
+                                 x, y, 32,
+                                 0);
+    insist(!!PD.DisplayImage, "creating host screen image");
+}
+
+static void DestroyDisplayImage(void)
+{
+  if (PD.UseShm) {
+    XShmDetach(PD.disp, &PD.ShmInfo);
+    shmdt(PD.ShmInfo.shmaddr);
+    PD.DisplayImage->data = NULL;
+  }
+  XDestroyImage(PD.DisplayImage);
+}
+
+/**
+ * DisplayImage_Put
+ *
+ * Copy a region of the display image to the main window.
+ */
+void DisplayImage_Put(int x,int y,int width,int height)
+{
+  if (PD.UseShm) {
+    XShmPutImage(PD.disp, PD.MainPane, PD.MainPaneGC, PD.DisplayImage,
+                 x, y, x, y, width, height, False);
+  } else {
+    XPutImage(PD.disp, PD.MainPane, PD.MainPaneGC, PD.DisplayImage,
+              x, y, x, y, width, height);
+  }
+  DisplayDev_HostBytes += width*height*(PD.DisplayImage->bits_per_pixel/8);
+}
+
+/**
+ * DisplayImage_MarkAll
+ *
+ * Mark the top-left width x height pixels of the display image as needing
+ * to be sent to the server, and the rest as clean.
+ */
+void DisplayImage_MarkAll(int width,int height)
+{
+  int y;
+  for (y = 0; y < height; y++) {
+    PD.DirtyMinX[y] = 0;
+    PD.DirtyMaxX[y] = width-1;
+  }
+  for (; y < MaxVideoHeight; y++) {
+    PD.DirtyMinX[y] = INT_MAX;
+    PD.DirtyMaxX[y] = -1;
+  }
+}
+
+/**
+ * DisplayImage_Flush
+ *
+ * Send all the dirty parts of the display image to the server. Each run of
+ * consecutive dirty rows is sent as one rectangle, spanning the union of the
+ * dirty columns of those rows.
+ */
+void DisplayImage_Flush(void)
+{
+  int height = MIN(PD.DisplayImage->height, MaxVideoHeight);
+  int y = 0;
+  bool sent = false;
+
+  while (y < height) {
+    int starty = y;
+    int minx = PD.DirtyMinX[y];
+    int maxx = PD.DirtyMaxX[y];
+
+    if (maxx < 0) {
+      y++;
+      continue;
+    }
+    do {
+      minx = MIN(minx, PD.DirtyMinX[y]);
+      maxx = MAX(maxx, PD.DirtyMaxX[y]);
+      PD.DirtyMinX[y] = INT_MAX;
+      PD.DirtyMaxX[y] = -1;
+      y++;
+    } while ((y < height) && (PD.DirtyMaxX[y] >= 0));
+
+    DisplayImage_Put(minx, starty, maxx-minx+1, y-starty);
+    sent = true;
+  }
+
+  /* The server reads shared images asynchronously, so wait for it to finish
+     before we start drawing the next frame into it */
+  if (sent && PD.UseShm) {
+    XSync(PD.disp, False);
+  }
+}
+
 /*----------------------------------------------------------------------------*/
 int
 DisplayDev_Init(ARMul_State *state)
@@ -331,10 +506,15 @@ DisplayDev_Init(ARMul_State *state)
   KeySym ks;
   XSetWindowAttributes attr;
   unsigned long attrmask;
-  int prescol;
+  int prescol, row;
   XTextProperty name;
   int shape_event_base, shape_error_base;
 
+  if (CONFIG.bHeadless) {
+    /* Don't connect to the X server at all */
+    return DisplayDev_Set(state,&NullDD_DisplayDev);
+  }
+
   PD.disp=XOpenDisplay(NULL);
     insist(!!PD.disp, "opening X display in DisplayKbd_InitHost()");
 
@@ -350,6 +530,36 @@ DisplayDev_Init(ARMul_State *state)
     warn("arcem: no-XWarpPointer mode selected.\n");
   }
 
+  PD.UseShm = XShmQueryExtension(PD.disp);
+  if (getenv("ARCEMNOSHM")) {
+    PD.UseShm = false;
+    warn("arcem: MIT-SHM disabled.\n");
+  }
+
+#ifdef RENDER_THREAD
+  /* Leave a core free for the emulator itself */
+  PD.RenderThreads = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+  PD.RenderThreads = MIN(4, MAX(1, (int) sysconf(_SC_NPROCESSORS_ONLN)-1));
+#endif
+  if ((s = getenv("ARCEMRENDERTHREADS"))) {
+    PD.RenderThreads = atoi(s);
+    warn("arcem: %d render threads selected.\n", PD.RenderThreads);
+  }
+#endif
+
+  if (getenv("ARCEMROWHASH")) {
+    /* Keep guest screen writes fast, and find changed rows by hashing */
+    DisplayDev_UseUpdateFlags = false;
+    DisplayDev_UseRowHashes = true;
+    warn("arcem: row hashing selected.\n");
+  }
+
+  if (getenv("ARCEMGOVERNOR")) {
+    DisplayDev_Governor = true;
+    warn("arcem: display governor enabled.\n");
+  }
+
   if ((s = getenv("ARCEMXMOUSEKEY"))) {
     if ((ks = XStringToKeysym(s))) {
       mouse_key.name = s;
@@ -453,14 +663,11 @@ DisplayDev_Init(ARMul_State *state)
 
 
     /* Allocate the memory for the actual display image */
-    /* TODO!! Need to allocate more for truecolour */
-    PD.ImageData = emalloc((InitialVideoWidth + 32) *
-        InitialVideoHeight * 4, "host screen image memory");
-  PD.DisplayImage = XCreateImage(PD.disp, DefaultVisual(PD.disp, PD.ScreenNum),
-                                 PD.visInfo.depth, ZPixmap, 0, PD.ImageData,
-                                 InitialVideoWidth, InitialVideoHeight, 32,
-                                 0);
-    insist(!!PD.DisplayImage, "creating host screen image");
+  CreateDisplayImage(InitialVideoWidth, InitialVideoHeight);
+  for (row = 0; row < MaxVideoHeight; row++) {
+    PD.DirtyMinX[row] = INT_MAX;
+    PD.DirtyMaxX[row] = -1;
+  }
 
     /* Now the same for the cursor image */
     PD.CursorImageData = emalloc(64 * InitialVideoHeight * 4,
@@ -568,6 +775,12 @@ DisplayDev_Init(ARMul_State *state)
 
   if(PD.visInfo.class==PseudoColor)
     return DisplayDev_Set(state,&pseudo_DisplayDev);
+#ifdef HOST_BIGENDIAN
+  else if((PD.DisplayImage->bits_per_pixel == 32) && (PD.DisplayImage->byte_order == MSBFirst))
+#else
+  else if((PD.DisplayImage->bits_per_pixel == 32) && (PD.DisplayImage->byte_order == LSBFirst))
+#endif
+    return DisplayDev_Set(state,&true32_DisplayDev);
   else
     return DisplayDev_Set(state,&true_DisplayDev);
 } /* DisplayKbd_InitHost */
@@ -795,10 +1008,8 @@ static void MainPane_Event(ARMul_State *state,XEvent *e) {
       break;
 
     case Expose:
-      XPutImage(PD.disp,PD.MainPane,PD.MainPaneGC,PD.DisplayImage,
-                e->xexpose.x,e->xexpose.y, /* source pos. in image */
-                e->xexpose.x,e->xexpose.y, /* Position on window */
-                e->xexpose.width,e->xexpose.height);
+      DisplayImage_Put(e->xexpose.x,e->xexpose.y,
+                       e->xexpose.width,e->xexpose.height);
       break;
 
     case ButtonPress:
@@ -879,11 +1090,40 @@ void hostdisplay_change_focus(bool focus)
 
 /*----------------------------------------------------------------------------*/
 
+bool
+Kbd_HostInputPending(ARMul_State *state)
+{
+  struct pollfd pfd;
+
+  if (!PD.disp) {
+    /* Running headless */
+    return false;
+  }
+
+  /* Events Xlib has already read in while doing something else */
+  if (XEventsQueued(PD.disp, QueuedAlready)) {
+    return true;
+  }
+
+  /* Otherwise see if the server has sent anything, without blocking */
+  pfd.fd = ConnectionNumber(PD.disp);
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  return poll(&pfd, 1, 0) > 0;
+} /* Kbd_HostInputPending */
+
+/*----------------------------------------------------------------------------*/
+
 int
 Kbd_PollHostKbd(ARMul_State *state)
 {
   XEvent e;
 
+  if (!PD.disp) {
+    /* Running headless */
+    return 0;
+  }
+
   if (XCheckMaskEvent(PD.disp, ULONG_MAX, &e)) {
 #ifdef DEBUG_X_PROTOCOL
     if (e.xany.window == PD.BackingWindow) {
@@ -933,19 +1173,13 @@ void Resize_Window(ARMul_State *state,int x,int y)
     XResizeWindow(PD.disp, PD.MainPane, x, y);
 
     /* clean up previous images used as display and cursor */
-    XDestroyImage(PD.DisplayImage);
+    DestroyDisplayImage();
     XDestroyImage(PD.CursorImage);
     free(PD.ShapePixmapData);
 
     /* realocate space for new screen image */
-    PD.ImageData = emalloc(x * 4 * y, "host screen image memory");
-    PD.DisplayImage = XCreateImage(PD.disp,
-                                   DefaultVisual(PD.disp, PD.ScreenNum),
-                                   PD.visInfo.depth, ZPixmap, 0,
-                                   PD.ImageData,
-                                   x, y, 32,
-                                   0);
-    insist(!!PD.DisplayImage, "creating host screen image");
+    CreateDisplayImage(x, y);
+    DisplayImage_MarkAll(x, y);
 
     /* realocate space for new cursor image */
     PD.CursorImageData = emalloc(32 * 4 * y, "host cursor image memory");
@@ -40,11 +40,50 @@ struct plat_display {
   int blue_shift,blue_prec;
 
   int DoingMouseFollow;
+
+  /* MIT-SHM support for DisplayImage */
+  bool UseShm;
+  XShmSegmentInfo ShmInfo;
+
+  /* Parts of DisplayImage which need sending to the server. Rows with
+     DirtyMaxX < 0 are clean. Only tracked per row, so that different rows
+     can be marked by different render threads at once. */
+  int DirtyMinX[MaxVideoHeight],DirtyMaxX[MaxVideoHeight];
 /*  } HostDisplay; */
+
+#ifdef RENDER_THREAD
+  int RenderThreads; /* Number of render threads for the display driver */
+#endif
 };
 
 extern struct plat_display PD;
 
+/**
+ * DisplayImage_MarkDirty
+ *
+ * Note that 'count' pixels of the display image, starting from (x,y), have
+ * been updated.
+ */
+static inline void DisplayImage_MarkDirty(int x,int y,int count)
+{
+  if (count <= 0) {
+    return;
+  }
+  if (PD.DirtyMaxX[y] < 0) {
+    PD.DirtyMinX[y] = x;
+    PD.DirtyMaxX[y] = x+count-1;
+  } else {
+    PD.DirtyMinX[y] = MIN(PD.DirtyMinX[y],x);
+    PD.DirtyMaxX[y] = MAX(PD.DirtyMaxX[y],x+count-1);
+  }
+}
+
+extern void DisplayImage_MarkAll(int width,int height);
+
+extern void DisplayImage_Flush(void);
+
+extern void DisplayImage_Put(int x,int y,int width,int height);
+
 extern void Resize_Window(ARMul_State *state,int x,int y);
 
 extern unsigned int vidc_col_to_x_col(unsigned int col);
@@ -53,6 +92,7 @@ extern void hostdisplay_change_focus(bool focus);
 
 extern void UpdateCursorPos(ARMul_State *state,int xscale,int xoffset,int yscale,int yoffset);
 
+extern const DisplayDev true32_DisplayDev;
 extern const DisplayDev true_DisplayDev;
 extern const DisplayDev pseudo_DisplayDev;
 
@@ -17,6 +17,7 @@
 #include <X11/Xutil.h>
 #include <X11/keysym.h>
 #include <X11/extensions/shape.h>
+#include <X11/extensions/XShm.h>
 
 #if defined(sun) && defined(__SVR4)
 # include <X11/Sunkeysym.h>
@@ -37,8 +38,6 @@ static const int SDD_RowsAtOnce = 1;
 typedef SDD_HostColour *SDD_Row;
 #define SDD_DisplayDev pseudo_DisplayDev
 
-static int UpdateStart=INT_MAX,UpdateEnd=-1;
-
 static SDD_HostColour SDD_Name(Host_GetColour)(ARMul_State *state,unsigned int col)
 {
   /* We use a fixed palette which matches the standard 256 colour RISC OS one */
@@ -54,8 +53,9 @@ static inline void SDD_Name(Host_EndRow)(ARMul_State *state,SDD_Row *row) { /* n
 
 static inline void SDD_Name(Host_BeginUpdate)(ARMul_State *state,SDD_Row *row,unsigned int count)
 {
-  UpdateStart = MIN(UpdateStart,*row-PD.ImageData);
-  UpdateEnd = MAX(UpdateEnd,(*row-PD.ImageData)+(int)count-1);
+  int offset = *row-PD.ImageData;
+  int bpl = PD.DisplayImage->bytes_per_line;
+  DisplayImage_MarkDirty(offset % bpl,offset / bpl,count);
 }
 
 static inline void SDD_Name(Host_EndUpdate)(ARMul_State *state,SDD_Row *row) { /* nothing */ }
@@ -72,7 +72,7 @@ static void SDD_Name(Host_PollDisplay)(ARMul_State *state);
 
 static inline SDD_Row SDD_Name(Host_BeginRow)(ARMul_State *state,int row,int offset)
 {
-  return PD.ImageData+row*HD.Width+offset;
+  return PD.ImageData+row*PD.DisplayImage->bytes_per_line+offset;
 }
 
 static void SDD_Name(Host_ChangeMode)(ARMul_State *state,int width,int height,int hz)
@@ -107,9 +107,6 @@ static void SDD_Name(Host_ChangeMode)(ARMul_State *state,int width,int height,in
   HD.Height = MIN(MaxVideoHeight,height + (VIDC_BORDER * 2));
 
   Resize_Window(state,HD.Width,HD.Height);
-
-  UpdateStart = 0;
-  UpdateEnd = HD.Width*HD.Height-1;
 }
 
 /* Refresh the mouses image                                                   */
@@ -173,26 +170,7 @@ static void RefreshMouse(ARMul_State *state) {
 
 static void SDD_Name(Host_PollDisplay)(ARMul_State *state)
 {
-  if(UpdateEnd >= 0)
-  {
-    /* Work out the rectangle that covers this region */
-    int startx = UpdateStart % HD.Width;
-    int starty = UpdateStart / HD.Width;
-    int endx = UpdateEnd % HD.Width;
-    int endy = UpdateEnd / HD.Width;
-    if(starty != endy)
-    {
-      startx = 0;
-      endx = HD.Width-1;
-    }
-    XPutImage(PD.disp, PD.MainPane, PD.MainPaneGC, PD.DisplayImage,
-              startx, starty, /* source pos. in image */
-              startx, starty, /* Position on window */
-              endx-startx+1,
-              endy-starty+1);
-    UpdateStart = INT_MAX;
-    UpdateEnd = -1;
-  }
+  DisplayImage_Flush();
 
   RefreshMouse(state);
 
@@ -9,7 +9,9 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#ifdef SOUND_PTHREAD
 #include <pthread.h>
+#endif
 
 #include "../armdefs.h"
 #include "../arch/sound.h"
@@ -22,34 +24,45 @@ static uint32_t sampleRate = 44100;
 
 static int soundDevice;
 
-/* Threading currently doesn't work very well - no priority control is in place, so the sound thread hardly ever gets any CPU time */
-/*#define SOUND_THREAD*/
-
-#ifdef SOUND_THREAD
+#ifdef SOUND_PTHREAD
+/* Sound is passed to a dedicated output thread through a single
+   producer/single consumer ring buffer. The emulator thread only ever writes
+   sound_buffer_in, and the output thread only writes sound_buffer_out, so
+   neither side needs to take a lock. The output thread does the (blocking)
+   device writes, so it naturally runs at the pace of the sound device. */
 static pthread_t thread;
-static pthread_mutex_t mut = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static bool thread_running = false;
+static int thread_quit = 0;
 
 #define BUFFER_SAMPLES (16384) /* 8K stereo pairs */
+#define WRITE_SAMPLES (2048) /* Max samples to write to the device at once */
 
-SoundData sound_buffer[BUFFER_SAMPLES];
-volatile int32_t sound_buffer_in=BUFFER_SAMPLES; /* Number of samples we've placed in the buffer */
-volatile int32_t sound_buffer_out=0; /* Number of samples read out by the sound thread */
-static const int32_t sound_buff_mask=BUFFER_SAMPLES-1;
+static SoundData sound_buffer[BUFFER_SAMPLES];
+static uint32_t sound_buffer_in=0; /* Number of samples we've placed in the buffer */
+static uint32_t sound_buffer_out=0; /* Number of samples read out by the sound thread */
+static const uint32_t sound_buff_mask=BUFFER_SAMPLES-1;
+
+#define ring_load(x) __atomic_load_n(&(x),__ATOMIC_ACQUIRE)
+#define ring_store(x,v) __atomic_store_n(&(x),(v),__ATOMIC_RELEASE)
 #else
 SoundData sound_buffer[256*2]; /* Must be >= 2*Sound_BatchSize! */
 #endif
 
 SoundData *Sound_GetHostBuffer(int32_t *destavail)
 {
-#ifdef SOUND_THREAD
+#ifdef SOUND_PTHREAD
+  static bool overrun = false;
   /* Work out how much space is available until next wrap point, or we start overwriting data */
-  pthread_mutex_lock(&mut);
-  int32_t local_buffer_in = sound_buffer_in;
-  int32_t used = local_buffer_in-sound_buffer_out;
-  pthread_mutex_unlock(&mut);
-  int32_t ofs = local_buffer_in & sound_buff_mask;
-  int32_t buffree = BUFFER_SAMPLES-MAX(ofs,used);
+  uint32_t local_buffer_in = sound_buffer_in;
+  uint32_t used = local_buffer_in-ring_load(sound_buffer_out);
+  uint32_t ofs = local_buffer_in & sound_buff_mask;
+  uint32_t buffree = MIN(BUFFER_SAMPLES-ofs,BUFFER_SAMPLES-used);
+  if(!buffree && !overrun)
+  {
+    /* Count each time the ring fills up, rather than every attempt to add to it */
+    Sound_HostOverruns++;
+  }
+  overrun = !buffree;
   *destavail = buffree>>1;
   return sound_buffer + ofs;
 #else
@@ -62,92 +75,40 @@ SoundData *Sound_GetHostBuffer(int32_t *destavail)
 void Sound_HostBuffered(SoundData *buffer,int32_t numSamples)
 {
   numSamples <<= 1;
-#ifdef SOUND_THREAD
-  pthread_mutex_lock(&mut);
-  int32_t local_buffer_in = sound_buffer_in;
-  int32_t used = local_buffer_in-sound_buffer_out;
-  pthread_mutex_unlock(&mut);
-  int32_t ofs = local_buffer_in & sound_buff_mask;
-
-  local_buffer_in += numSamples;
-  
-  if(buffree == numSamples)
-  {
-    warn_vidc("*** sound overflow! ***\n");
-    if(Sound_FudgeRate < -10)
-      Sound_FudgeRate = Sound_FudgeRate/2;
-    else
-      Sound_FudgeRate+=10;
-  }
-  else if(!used)
+#ifdef SOUND_PTHREAD
   {
-    warn_vidc("*** sound underflow! ***\n");
-    if(Sound_FudgeRate > 10)
-      Sound_FudgeRate = Sound_FudgeRate/2;
-    else
-      Sound_FudgeRate-=10;
-  }
-  else if(used < BUFFER_SAMPLES/4)
-  {
-    Sound_FudgeRate--;
-  }
-  else if(buffree < BUFFER_SAMPLES/4)
-  {
-    Sound_FudgeRate++;
-  }
-  else if(Sound_FudgeRate)
-  {
-    /* Bring the fudge value back towards 0 until we go out of the comfort zone */
-    Sound_FudgeRate += (Sound_FudgeRate>0?-1:1);
-  }
+    uint32_t local_buffer_in = sound_buffer_in+numSamples;
+    uint32_t used = local_buffer_in-ring_load(sound_buffer_out);
 
-  pthread_mutex_lock(&mut);
-  sound_buffer_in = local_buffer_in;
-  pthread_mutex_unlock(&mut);
-  pthread_cond_broadcast(&cond);
+    /* Hand the data over. The output thread counts any underruns */
+    ring_store(sound_buffer_in,local_buffer_in);
 
-  pthread_yield();
+    /* Report the fill level, for the latency controller */
+    Sound_HostFill = used>>1;
+    Sound_HostCapacity = BUFFER_SAMPLES>>1;
+  }
 #else
   audio_buf_info buf;
   if (ioctl(soundDevice, SOUND_PCM_GETOSPACE, &buf) != -1) {
-    /* Adjust fudge rate based around how much buffer space is available
-       We aim for the buffer to be somewhere between 1/4 and 3/4 full, but don't
-       explicitly set the buffer size, so we're at the mercy of the sound system
-       in terms of how much lag there'll be */
+    /* Report the fill level of the device buffer, for the latency controller.
+       We don't explicitly set the buffer size, so we're at the mercy of the
+       sound system in terms of how much lag there can be */
     int32_t bufsize = buf.fragsize*buf.fragstotal;
     int32_t buffree = buf.bytes/sizeof(SoundData);
     int32_t used = (bufsize-buf.bytes)/sizeof(SoundData);
-    int32_t stepsize = Sound_DMARate>>2;
     bufsize /= sizeof(SoundData);
+    Sound_HostFill = (used+MIN(numSamples,buffree))>>1;
+    Sound_HostCapacity = bufsize>>1;
     if(numSamples > buffree)
     {
-      warn_vidc("*** sound overflow! %d %d %d %d ***\n",numSamples-buffree,ARMul_EmuRate,Sound_FudgeRate,Sound_DMARate);
-      numSamples = buffree; /* We could block until space is available, but I'm woried we'd get stuck blocking forever because the FudgeRate increase wouldn't compensate for the ARMul cycles lost due to blocking */
-      if(Sound_FudgeRate < -stepsize)
-        Sound_FudgeRate = Sound_FudgeRate/2;
-      else
-        Sound_FudgeRate+=stepsize;
+      warn_vidc("*** sound overflow! %d %d %d ***\n",numSamples-buffree,ARMul_EmuRate,Sound_DMARate);
+      Sound_HostOverruns++;
+      numSamples = buffree; /* We could block until space is available, but I'm woried we'd get stuck blocking forever because the rate adjustment wouldn't compensate for the ARMul cycles lost due to blocking */
     }
     else if(!used)
     {
-      warn_vidc("*** sound underflow! %d %d %d ***\n",ARMul_EmuRate,Sound_FudgeRate,Sound_DMARate);
-      if(Sound_FudgeRate > stepsize)
-        Sound_FudgeRate = Sound_FudgeRate/2;
-      else
-        Sound_FudgeRate-=stepsize;
-    }
-    else if(used < bufsize/4)
-    {
-      Sound_FudgeRate-=stepsize>>4;
-    }
-    else if(buffree < bufsize/4)
-    {
-      Sound_FudgeRate+=stepsize>>4;
-    }
-    else if(Sound_FudgeRate)
-    {
-      /* Bring the fudge value back towards 0 until we go out of the comfort zone */
-      Sound_FudgeRate += (Sound_FudgeRate>0?-1:1);
+      warn_vidc("*** sound underflow! %d %d ***\n",ARMul_EmuRate,Sound_DMARate);
+      Sound_HostUnderruns++;
     }
   }
   
@@ -155,36 +116,46 @@ void Sound_HostBuffered(SoundData *buffer,int32_t numSamples)
 #endif
 }
 
-#ifdef SOUND_THREAD
+#ifdef SOUND_PTHREAD
 static void *
 sound_writeThread(void *arg)
 {
-  int32_t local_buffer_out = sound_buffer_out;
-  for (;;) {
-    int32_t avail;
+  uint32_t local_buffer_out = sound_buffer_out;
+  bool playing = false;
+  while (!ring_load(thread_quit)) {
+    uint32_t avail = ring_load(sound_buffer_in)-local_buffer_out;
 
-    pthread_mutex_lock(&mut);
-    sound_buffer_out = local_buffer_out;
-    avail = sound_buffer_in-local_buffer_out;
-    pthread_mutex_unlock(&mut);
-
-    dbug_vidc("%d\n",avail);
     if (avail) {
-      int32_t ofs = local_buffer_out & sound_buff_mask;
-
-      if(ofs + avail > BUFFER_SAMPLES) {
-        /* We're about to wrap */
-        avail = BUFFER_SAMPLES-ofs;
+      uint32_t ofs = local_buffer_out & sound_buff_mask;
+      ssize_t written;
+
+      /* Stop at the wrap point, and don't hold on to too much at once so
+         that the emulator sees the space freeing up steadily */
+      avail = MIN(avail,BUFFER_SAMPLES-ofs);
+      avail = MIN(avail,WRITE_SAMPLES);
+
+      written = write(soundDevice, sound_buffer + ofs,
+                      avail * sizeof(SoundData));
+      if (written > 0) {
+        local_buffer_out += written/sizeof(SoundData);
+        ring_store(sound_buffer_out,local_buffer_out);
       }
-
-      write(soundDevice, sound_buffer + ofs,
-            avail * sizeof(SoundData));
-
-      local_buffer_out += avail;
+      playing = true;
     } else {
-      pthread_mutex_lock(&mut);
-      pthread_cond_wait(&cond, &mut);
-      pthread_mutex_unlock(&mut);
+      if (playing) {
+        /* The ring being empty is normal, since the device has its own
+           buffer to play from. Only count an underrun once that has drained
+           as well */
+        audio_buf_info buf;
+        if ((ioctl(soundDevice, SOUND_PCM_GETOSPACE, &buf) == -1) ||
+            (buf.bytes >= buf.fragsize*buf.fragstotal)) {
+          __atomic_fetch_add(&Sound_HostUnderruns,1,__ATOMIC_RELAXED);
+          dbug_vidc("*** sound underflow! %d %d ***\n",ARMul_EmuRate,Sound_DMARate);
+          playing = false;
+        }
+      }
+      /* Nothing to do, wait a couple of milliseconds for more */
+      usleep(2000);
     }
   }
 
@@ -245,8 +216,12 @@ Sound_InitHost(ARMul_State *state)
 
   Sound_HostRate = sampleRate<<10;
 
-#ifdef SOUND_THREAD
-  pthread_create(&thread, NULL, sound_writeThread, 0);
+#ifdef SOUND_PTHREAD
+  thread_running = !pthread_create(&thread, NULL, sound_writeThread, 0);
+  if (!thread_running) {
+    warn_vidc("Could not create sound thread\n");
+    return -1;
+  }
 #endif
 
   return 0;
@@ -255,7 +230,14 @@ Sound_InitHost(ARMul_State *state)
 void
 Sound_ShutdownHost(ARMul_State *state)
 {
-  /* TODO */
+#ifdef SOUND_PTHREAD
+  if (thread_running) {
+    ring_store(thread_quit,1);
+    pthread_join(thread, NULL);
+    thread_running = false;
+  }
+#endif
+  close(soundDevice);
 }
 
 #endif
@@ -15,6 +15,7 @@
 #include <X11/Xutil.h>
 #include <X11/keysym.h>
 #include <X11/extensions/shape.h>
+#include <X11/extensions/XShm.h>
 
 #if defined(sun) && defined(__SVR4)
 # include <X11/Sunkeysym.h>
@@ -29,16 +30,98 @@
 #include "platform.h"
 #include "ControlPane.h"
 
-typedef unsigned int SDD_HostColour;
-#define SDD_Name(x) true_##x
-static const int SDD_RowsAtOnce = 1;
-typedef struct {
+/* Two drivers: true32, for the common case of a 32bpp display image in the
+   host's byte order, which writes straight into the image (and so can use
+   the vectorised row converters), and true, which goes through XPutPixel
+   and copes with any other pixel format */
+
+static void ScaleMode(int *width,int *height,int *xscale,int *yscale);
+static void RefreshMouse(ARMul_State *state);
+static void PollDisplay(ARMul_State *state,int xscale,int xoffset,int yscale,int yoffset);
+
+#ifdef RENDER_THREAD
+#define SDD_RenderThread
+#define SDD_RenderThreads PD.RenderThreads
+#endif
+
+/* ------------------------------------------------------------------ */
+
+/* Direct access display device, 32bpp */
+
+#define SDD_HostColour uint32_t
+#define SDD_Name(x) true32_##x
+#define SDD_RowsAtOnce 1
+#define SDD_Row SDD_HostColour *
+#define SDD_DirectRow
+#define SDD_DisplayDev true32_DisplayDev
+
+static SDD_HostColour SDD_Name(Host_GetColour)(ARMul_State *state,unsigned int col)
+{
+  return vidc_col_to_x_col(col);
+}
+
+static void SDD_Name(Host_ChangeMode)(ARMul_State *state,int width,int height,int hz);
+
+static inline SDD_Row SDD_Name(Host_BeginRow)(ARMul_State *state,int row,int offset)
+{
+  return ((SDD_Row)(void *) (PD.ImageData+row*PD.DisplayImage->bytes_per_line))+offset;
+}
+
+static inline void SDD_Name(Host_EndRow)(ARMul_State *state,SDD_Row *row) { /* nothing */ }
+
+static inline void SDD_Name(Host_BeginUpdate)(ARMul_State *state,SDD_Row *row,unsigned int count)
+{
+  int offset = ((char *) *row)-PD.ImageData;
+  int bpl = PD.DisplayImage->bytes_per_line;
+  DisplayImage_MarkDirty((offset % bpl)/sizeof(SDD_HostColour),offset / bpl,count);
+}
+
+static inline void SDD_Name(Host_EndUpdate)(ARMul_State *state,SDD_Row *row) { /* nothing */ }
+
+static inline void SDD_Name(Host_SkipPixels)(ARMul_State *state,SDD_Row *row,unsigned int count) { (*row) += count; }
+
+static inline void SDD_Name(Host_WritePixel)(ARMul_State *state,SDD_Row *row,SDD_HostColour pix) { *(*row)++ = pix; }
+
+static inline void SDD_Name(Host_WritePixels)(ARMul_State *state,SDD_Row *row,SDD_HostColour pix,unsigned int count) { while(count--) *(*row)++ = pix; }
+
+static void SDD_Name(Host_PollDisplay)(ARMul_State *state);
+
+#include "../arch/stddisplaydev.c"
+
+static void SDD_Name(Host_ChangeMode)(ARMul_State *state,int width,int height,int hz)
+{
+  ScaleMode(&width,&height,&HD.XScale,&HD.YScale);
+  HD.Width = MIN(MaxVideoWidth,width + (VIDC_BORDER * 2));
+  HD.Height = MIN(MaxVideoHeight,height + (VIDC_BORDER * 2));
+
+  Resize_Window(state,HD.Width,HD.Height);
+}
+
+static void SDD_Name(Host_PollDisplay)(ARMul_State *state)
+{
+  PollDisplay(state,HD.XScale,HD.XOffset,HD.YScale,HD.YOffset);
+}
+
+#undef SDD_HostColour
+#undef SDD_Name
+#undef SDD_RowsAtOnce
+#undef SDD_Row
+#undef SDD_DirectRow
+#undef SDD_DisplayDev
+
+/* ------------------------------------------------------------------ */
+
+/* Generic display device, any truecolour format */
+
+struct true_row {
   int x,y; /* Current image position */
-} SDD_Row;
-#define SDD_DisplayDev true_DisplayDev
+};
 
-static int UpdateMinX=INT_MAX,UpdateMaxX=-1;
-static int UpdateMinY=INT_MAX,UpdateMaxY=-1;
+#define SDD_HostColour unsigned int
+#define SDD_Name(x) true_##x
+#define SDD_RowsAtOnce 1
+#define SDD_Row struct true_row
+#define SDD_DisplayDev true_DisplayDev
 
 static SDD_HostColour SDD_Name(Host_GetColour)(ARMul_State *state,unsigned int col)
 {
@@ -59,10 +142,7 @@ static inline void SDD_Name(Host_EndRow)(ARMul_State *state,SDD_Row *row) { /* n
 
 static inline void SDD_Name(Host_BeginUpdate)(ARMul_State *state,SDD_Row *row,unsigned int count)
 {
-  UpdateMinX = MIN(UpdateMinX,row->x);
-  UpdateMaxX = MAX(UpdateMaxX,(int)(row->x+count-1));
-  UpdateMinY = MIN(UpdateMinY,row->y);
-  UpdateMaxY = MAX(UpdateMaxY,row->y);
+  DisplayImage_MarkDirty(row->x,row->y,count);
 }
 
 static inline void SDD_Name(Host_EndUpdate)(ARMul_State *state,SDD_Row *row) { /* nothing */ }
@@ -88,40 +168,56 @@ static void SDD_Name(Host_PollDisplay)(ARMul_State *state);
 
 static void SDD_Name(Host_ChangeMode)(ARMul_State *state,int width,int height,int hz)
 {
-  if (width > MaxVideoWidth || height > MaxVideoHeight) {
+  ScaleMode(&width,&height,&HD.XScale,&HD.YScale);
+  HD.Width = MIN(MaxVideoWidth,width + (VIDC_BORDER * 2));
+  HD.Height = MIN(MaxVideoHeight,height + (VIDC_BORDER * 2));
+
+  Resize_Window(state,HD.Width,HD.Height);
+}
+
+static void SDD_Name(Host_PollDisplay)(ARMul_State *state)
+{
+  PollDisplay(state,HD.XScale,HD.XOffset,HD.YScale,HD.YOffset);
+}
+
+#undef SDD_HostColour
+#undef SDD_Name
+#undef SDD_RowsAtOnce
+#undef SDD_Row
+#undef SDD_DisplayDev
+
+/* ------------------------------------------------------------------ */
+
+/* Work out the pixel scaling to use for an emulated display mode, and scale
+   the size up to match */
+static void ScaleMode(int *width,int *height,int *xscale,int *yscale)
+{
+  if (*width > MaxVideoWidth || *height > MaxVideoHeight) {
       ControlPane_Error(EXIT_FAILURE,"Resize_Window: new size (%d, %d) exceeds maximum (%d, %d)\n",
-          width, height, MaxVideoWidth, MaxVideoHeight);
+          *width, *height, MaxVideoWidth, MaxVideoHeight);
   }
 
-  HD.XScale = 1;
-  HD.YScale = 1;
+  *xscale = 1;
+  *yscale = 1;
   /* Try and detect rectangular pixel modes */
-  if((width >= height*2) && (height*2 <= MaxVideoHeight))
+  if((*width >= *height*2) && (*height*2 <= MaxVideoHeight))
   {
-    HD.YScale = 2;
-    height *= 2;
+    *yscale = 2;
+    *height *= 2;
   }
-  else if((height >= width) && (width*2 <= MaxVideoWidth))
+  else if((*height >= *width) && (*width*2 <= MaxVideoWidth))
   {
-    HD.XScale = 2;
-    width *= 2;
+    *xscale = 2;
+    *width *= 2;
   }
   /* Try and detect small screen resolutions */
-  else if((width < MinVideoWidth) && (width * 2 <= MaxVideoWidth) && (height * 2 <= MaxVideoHeight))
+  else if((*width < MinVideoWidth) && (*width * 2 <= MaxVideoWidth) && (*height * 2 <= MaxVideoHeight))
   {
-    HD.XScale = 2;
-    HD.YScale = 2;
-    width *= 2;
-    height *= 2;
+    *xscale = 2;
+    *yscale = 2;
+    *width *= 2;
+    *height *= 2;
   }
-  HD.Width = MIN(MaxVideoWidth,width + (VIDC_BORDER * 2));
-  HD.Height = MIN(MaxVideoHeight,height + (VIDC_BORDER * 2));
-
-  Resize_Window(state,HD.Width,HD.Height);
-
-  UpdateMinX=UpdateMinY=0;
-  UpdateMaxX=HD.Width-1;
-  UpdateMaxY=HD.Height-1;
 }
 
 /* Refresh the mouses image                                                   */
@@ -137,10 +233,10 @@ static void RefreshMouse(ARMul_State *state) {
   TransPtr = PD.ShapePixmapData;
   TransBit = 0;
 
-  SDD_HostColour cursorPalette[3];
+  unsigned int cursorPalette[3];
   for(x=0;x<3;x++)
   {
-    cursorPalette[x] = SDD_Name(Host_GetColour)(state,VIDC.CursorPalette[x]);
+    cursorPalette[x] = vidc_col_to_x_col(VIDC.CursorPalette[x]);
   }
 
   for(y=0; y<height; y++,memptr+=8,offset+=8,TransPtr+=4) {
@@ -183,31 +279,13 @@ static void RefreshMouse(ARMul_State *state) {
   }; /* Shape enabled */
 } /* RefreshMouse */
 
-static void SDD_Name(Host_PollDisplay)(ARMul_State *state)
+static void PollDisplay(ARMul_State *state,int xscale,int xoffset,int yscale,int yoffset)
 {
-  if(UpdateMaxY >= 0)
-  {
-    int startx = UpdateMinX;
-    int starty = UpdateMinY;
-    int endx = UpdateMaxX;
-    int endy = UpdateMaxY;
-    if(starty != endy)
-    {
-      startx = 0;
-      endx = HD.Width-1;
-    }
-    XPutImage(PD.disp, PD.MainPane, PD.MainPaneGC, PD.DisplayImage,
-              startx, starty, /* source pos. in image */
-              startx, starty, /* Position on window */
-              endx-startx+1,
-              endy-starty+1);
-    UpdateMinX = UpdateMinY = INT_MAX;
-    UpdateMaxX = UpdateMaxY = -1;
-  }
+  DisplayImage_Flush();
 
   RefreshMouse(state);
   
-  UpdateCursorPos(state,HD.XScale,HD.XOffset,HD.YScale,HD.YOffset);
+  UpdateCursorPos(state,xscale,xoffset,yscale,yoffset);
 
   XPutImage(PD.disp, PD.CursorPane, PD.MainPaneGC, PD.CursorImage,
               0, 0,
@@ -794,6 +794,14 @@ void MouseMoved(ARMul_State *state,int xdiff,int ydiff)
 /* refreshmouse(state); */
 }
 
+/* There's no cheap way to tell whether there's input waiting, so always
+   let Kbd_PollHostKbd look */
+bool
+Kbd_HostInputPending(ARMul_State *state)
+{
+  return true;
+}
+
 int
 Kbd_PollHostKbd(ARMul_State *state)
 {
@@ -907,8 +915,9 @@ Kbd_PollHostKbd(ARMul_State *state)
 	#ifdef __amigaos4__
 	ARexx_Handle();
 	
+	/* Shut down through the emulator so the disc images get written back */
 	if(arexx_quit)
-		cleanup();
+		ARMul_Exit(state, 0);
 	#endif
 
   return 0;
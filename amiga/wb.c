@@ -167,6 +167,9 @@ static void gettooltypes(struct WBArg *wbarg, ArcemConfig *pConfig)
 		if(FindToolType(toolarray, "AUTOUPDATEFLAGS"))
 			DisplayDev_AutoUpdateFlags = 1;
 
+		if(FindToolType(toolarray, "DISPLAYGOVERNOR"))
+			DisplayDev_Governor = 1;
+
 		if(FindToolType(toolarray, "NOCONSOLEOUTPUT"))
 		{
 			/* if we are launching from WB, we don't need console windows popping up */
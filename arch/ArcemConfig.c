@@ -34,6 +34,7 @@ void wblaunch(struct WBStartup *, ArcemConfig *pConfig);
 static char *arcemconfig_StringDuplicate(const char *sInput);
 static void arcemconfig_StringReplace(char** sPtr, const char* sNew);
 static bool arcemconfig_StringToEnum(unsigned int* uPtr, const char* sInput, const ArcemConfig_Label *labels);
+static bool arcemconfig_StringToSpeed(unsigned int* uPtr, const char* sInput);
 
 static const ArcemConfig_Label memsize_labels[] = {
     { "256K", MemSize_256K },
@@ -54,6 +55,12 @@ static const ArcemConfig_Label processor_labels[] = {
     { NULL, 0 }
 };
 
+static const ArcemConfig_Label resampler_labels[] = {
+    { "fast", Resampler_Fast },
+    { "sinc", Resampler_Sinc },
+    { NULL, 0 }
+};
+
 /** 
  * ArcemConfig_SetupDefaults
  *
@@ -102,7 +109,29 @@ void ArcemConfig_SetupDefaults(ArcemConfig *pConfig)
   /* Default for drive details is all NULL/zeros */
   memset(pConfig->aFloppyPaths, 0, sizeof(char *) * 4);
   memset(pConfig->aST506Paths, 0, sizeof(char *) * 4);
+  memset(pConfig->aFloppyOverlays, 0, sizeof(char *) * 4);
+  memset(pConfig->aST506Overlays, 0, sizeof(char *) * 4);
   memset(pConfig->aST506DiskShapes, 0, sizeof(struct HDCshape) * 4);
+  pConfig->bST506Mmap = false;
+  pConfig->bST506WriteBack = false;
+  pConfig->bDiscTurbo = false;
+
+  /* Run as fast as the host allows */
+  pConfig->uSpeedLimit = 0;
+
+  /* Default sound latency */
+  pConfig->uSoundLatency = 0;
+
+  /* Cheap resampling, as always used before */
+  pConfig->eResampler = Resampler_Fast;
+
+  /* Display in a window, no snapshots */
+  pConfig->bHeadless = false;
+  pConfig->uSnapshotInterval = 0;
+  pConfig->sSnapshotPrefix = NULL;
+
+  /* No recording */
+  pConfig->sCapturePrefix = NULL;
 
 #if defined(SYSTEM_win)
   pConfig->eDisplayDriver = DisplayDriver_Standard;
@@ -157,6 +186,26 @@ static int ArcemConfig_Handler(void* user, const char* section,
                 warn("Unrecognised value for %s: %s\n", name, value);
                 return 0;
             }
+        } else if (0 == strcmp(name, "speed")) {
+            if (!arcemconfig_StringToSpeed(&pConfig->uSpeedLimit, value)) {
+                warn("Unrecognised value for %s: %s\n", name, value);
+                return 0;
+            }
+        } else if (0 == strcmp(name, "soundlatency")) {
+            pConfig->uSoundLatency = atoi(value);
+        } else if (0 == strcmp(name, "turbodisc")) {
+            pConfig->bDiscTurbo = (atoi(value) != 0);
+        } else if (0 == strcmp(name, "hdmmap")) {
+            pConfig->bST506Mmap = (atoi(value) != 0);
+        } else if (0 == strcmp(name, "hdwriteback")) {
+            pConfig->bST506WriteBack = (atoi(value) != 0);
+        } else if (0 == strcmp(name, "resampler")) {
+            if (arcemconfig_StringToEnum(&uValue, value, resampler_labels)) {
+                pConfig->eResampler = uValue;
+            } else {
+                warn("Unrecognised value for %s: %s\n", name, value);
+                return 0;
+            }
         } else {
             warn("Unknown section/name: %s, %s, %s\n", section, name, value);
             return 0;
@@ -166,6 +215,8 @@ static int ArcemConfig_Handler(void* user, const char* section,
         int drive = section[3] - '0';
         if (0 == strcmp(name, "path")) {
             arcemconfig_StringReplace(&pConfig->aFloppyPaths[drive], value);
+        } else if (0 == strcmp(name, "overlay")) {
+            arcemconfig_StringReplace(&pConfig->aFloppyOverlays[drive], value);
         } else {
             warn("Unknown section/name: %s, %s, %s\n", section, name, value);
             return 0;
@@ -175,6 +226,8 @@ static int ArcemConfig_Handler(void* user, const char* section,
         int drive = section[3] - '0';
         if (0 == strcmp(name, "path")) {
             arcemconfig_StringReplace(&pConfig->aST506Paths[drive], value);
+        } else if (0 == strcmp(name, "overlay")) {
+            arcemconfig_StringReplace(&pConfig->aST506Overlays[drive], value);
         } else if (0 == strcmp(name, "cylinders")) {
             pConfig->aST506DiskShapes[drive].NCyls = atoi(value);
         } else if (0 == strcmp(name, "heads")) {
@@ -260,6 +313,23 @@ void ArcemConfig_ParseCommandLine(ArcemConfig *pConfig, int argc, char *argv[])
     "     '8M', '12M' or '16M'\n"
     "  --processor <value> - Set the emulated CPU\n"
     "     Where value is one of 'ARM2', 'ARM250', 'ARM3'\n"
+    "  --speed <value> - Limit the emulation speed\n"
+    "     Where value is 'max' (unthrottled), 'realtime' (8MHz ARM2),\n"
+    "     or a multiple of realtime, e.g. '2x' or '0.5x'\n"
+    "  --soundlatency <value> - Target sound latency in milliseconds\n"
+    "  --resampler <value> - Set the sound resampling quality\n"
+    "     Where value is 'fast' (default) or 'sinc' (higher quality)\n"
+    "  --hdmmap - Memory map the ST506 hard disc images, where supported\n"
+    "  --hdwriteback - Write to the ST506 hard disc images in the background,\n"
+    "     where supported\n"
+    "  --turbodisc - Transfer disc data as fast as the emulated OS accepts it\n"
+#if defined(SYSTEM_X) || defined(SYSTEM_SDL)
+    "  --headless - Run without a display\n"
+    "  --snapshot <value> - When headless, save the screen every <value> frames\n"
+    "     (also on SIGUSR1)\n"
+    "  --snapshotprefix <value> - Start of the snapshot filenames, default 'snapshot'\n"
+    "  --capture <value> - Record video and sound to <value>.y4m and <value>.wav\n"
+#endif /* SYSTEM_X || SYSTEM_SDL */
 #if defined(SYSTEM_riscos_single) || defined(SYSTEM_win)
     "  --display <mode> - Select display driver, 'pal' or 'std'\n"
 #endif /* SYSTEM_riscos_single || SYSTEM_win */
@@ -381,6 +451,81 @@ void ArcemConfig_ParseCommandLine(ArcemConfig *pConfig, int argc, char *argv[])
         ControlPane_Error(EXIT_FAILURE,"No argument following the --processor option\n");
       }
     }
+    else if(0 == strcmp("--speed", argv[iArgument])) {
+      if(iArgument+1 < argc) { /* Is there a following argument? */
+        if (arcemconfig_StringToSpeed(&pConfig->uSpeedLimit, argv[iArgument + 1])) {
+          iArgument += 2;
+        } else {
+          ControlPane_Error(EXIT_FAILURE,"Unrecognised value '%s' to the --speed option\n", argv[iArgument + 1]);
+        }
+      } else {
+        /* No argument following the --speed option */
+        ControlPane_Error(EXIT_FAILURE,"No argument following the --speed option\n");
+      }
+    }
+    else if(0 == strcmp("--soundlatency", argv[iArgument])) {
+      if(iArgument+1 < argc) { /* Is there a following argument? */
+        pConfig->uSoundLatency = atoi(argv[iArgument + 1]);
+        iArgument += 2;
+      } else {
+        ControlPane_Error(EXIT_FAILURE,"No argument following the --soundlatency option\n");
+      }
+    }
+    else if(0 == strcmp("--resampler", argv[iArgument])) {
+      if(iArgument+1 < argc) { /* Is there a following argument? */
+        if (arcemconfig_StringToEnum(&uValue, argv[iArgument + 1], resampler_labels)) {
+          pConfig->eResampler = uValue;
+          iArgument += 2;
+        } else {
+          ControlPane_Error(EXIT_FAILURE,"Unrecognised value '%s' to the --resampler option\n", argv[iArgument + 1]);
+        }
+      } else {
+        /* No argument following the --resampler option */
+        ControlPane_Error(EXIT_FAILURE,"No argument following the --resampler option\n");
+      }
+    }
+    else if(0 == strcmp("--hdmmap", argv[iArgument])) {
+      pConfig->bST506Mmap = true;
+      iArgument += 1;
+    }
+    else if(0 == strcmp("--hdwriteback", argv[iArgument])) {
+      pConfig->bST506WriteBack = true;
+      iArgument += 1;
+    }
+    else if(0 == strcmp("--turbodisc", argv[iArgument])) {
+      pConfig->bDiscTurbo = true;
+      iArgument += 1;
+    }
+#if defined(SYSTEM_X) || defined(SYSTEM_SDL)
+    else if(0 == strcmp("--headless", argv[iArgument])) {
+      pConfig->bHeadless = true;
+      iArgument += 1;
+    }
+    else if(0 == strcmp("--snapshot", argv[iArgument])) {
+      if(iArgument+1 < argc) { /* Is there a following argument? */
+        pConfig->uSnapshotInterval = atoi(argv[iArgument + 1]);
+        iArgument += 2;
+      } else {
+        ControlPane_Error(EXIT_FAILURE,"No argument following the --snapshot option\n");
+      }
+    }
+    else if(0 == strcmp("--snapshotprefix", argv[iArgument])) {
+      if(iArgument+1 < argc) { /* Is there a following argument? */
+        arcemconfig_StringReplace(&pConfig->sSnapshotPrefix, argv[iArgument + 1]);
+        iArgument += 2;
+      } else {
+        ControlPane_Error(EXIT_FAILURE,"No argument following the --snapshotprefix option\n");
+      }
+    }
+    else if(0 == strcmp("--capture", argv[iArgument])) {
+      if(iArgument+1 < argc) { /* Is there a following argument? */
+        arcemconfig_StringReplace(&pConfig->sCapturePrefix, argv[iArgument + 1]);
+        iArgument += 2;
+      } else {
+        ControlPane_Error(EXIT_FAILURE,"No argument following the --capture option\n");
+      }
+    }
+#endif /* SYSTEM_X || SYSTEM_SDL */
 #if defined(SYSTEM_riscos_single) || defined(SYSTEM_win)
     else if(0 == strcmp("--display", argv[iArgument])) {
       if(iArgument+1 < argc) { /* Is there a following argument? */
@@ -494,3 +639,24 @@ static bool arcemconfig_StringToEnum(unsigned int *uPtr, const char *sInput, con
     }
     return false;
 }
+
+static bool arcemconfig_StringToSpeed(unsigned int *uPtr, const char *sInput) {
+    char *sEnd;
+    double dMultiplier;
+
+    if (0 == strcmp(sInput, "max")) {
+        *uPtr = 0;
+        return true;
+    }
+    if (0 == strcmp(sInput, "realtime")) {
+        *uPtr = 100;
+        return true;
+    }
+
+    dMultiplier = strtod(sInput, &sEnd);
+    if (sEnd == sInput || (*sEnd != 'x' && *sEnd != 0) || dMultiplier < 0.01) {
+        return false;
+    }
+    *uPtr = (unsigned int) (dMultiplier * 100 + 0.5);
+    return true;
+}
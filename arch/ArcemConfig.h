@@ -62,6 +62,11 @@ typedef enum ArcemConfig_DisplayDriver_e {
   DisplayDriver_Standard /* i.e. 16/32bpp true colour */
 } ArcemConfig_DisplayDriver;
 
+typedef enum ArcemConfig_Resampler_e {
+  Resampler_Fast,                 /* Area-sum mixer */
+  Resampler_Sinc                  /* Windowed-sinc polyphase filter */
+} ArcemConfig_Resampler;
+
 typedef struct ArcemConfig_Label_s {
     const char *name;
     unsigned int value;
@@ -88,9 +93,48 @@ struct ArcemConfig_s {
   char *aFloppyPaths[4];
   char *aST506Paths[4];
 
+  /* Copy-on-write overlays for the floppy and ST506 images; if set, writes
+     go to these files and the images themselves are only read */
+  char *aFloppyOverlays[4];
+  char *aST506Overlays[4];
+
   /* Shapes of the MFM ST506 drives as set in the config file */
   struct HDCshape aST506DiskShapes[4];
 
+  /* Access the ST506 images through memory mappings rather than stdio, on
+     hosts that support it */
+  bool bST506Mmap;
+
+  /* Queue writes to the ST506 images and write them out on a separate
+     thread, on builds that support it */
+  bool bST506WriteBack;
+
+  /* Transfer floppy and hard disc data as fast as the guest will take it,
+     rather than at the speed of the real drives */
+  bool bDiscTurbo;
+
+  /* Speed governor target, as a percentage of a real 8MHz ARM2. 100 is
+     real-time, 0 is unthrottled */
+  unsigned int uSpeedLimit;
+
+  /* Target sound output latency in milliseconds, for hosts that report how
+     much sound they have queued. 0 for the default */
+  unsigned int uSoundLatency;
+
+  /* How the sound output is converted to the host sample rate */
+  ArcemConfig_Resampler eResampler;
+
+  /* Run with the null display device instead of opening a window. If
+     uSnapshotInterval is nonzero, a snapshot of the screen is written every
+     uSnapshotInterval frames, to files named after sSnapshotPrefix */
+  bool bHeadless;
+  unsigned int uSnapshotInterval;
+  char *sSnapshotPrefix;
+
+  /* If set, record the display and sound output to <sCapturePrefix>.y4m and
+     <sCapturePrefix>.wav */
+  char *sCapturePrefix;
+
   /* Platform-specific bits */
 #if defined(SYSTEM_riscos_single) || defined(SYSTEM_win)
   ArcemConfig_DisplayDriver eDisplayDriver;
@@ -16,4 +16,7 @@ void ControlPane_Event(ARMul_State *state, XEvent *e);
 /* Report an error and exit */
 void ControlPane_Error(int code,const char *fmt,...);
 
+/* Report a problem the user should know about, and carry on */
+void ControlPane_Warning(const char *fmt,...);
+
 #endif
@@ -23,15 +23,7 @@
 struct IOCStruct ioc;
 
 static void UpdateTimerRegisters_Event(ARMul_State *state,CycleCount time);
-
-/*-----------------------------------------------------------------------------*/
-
-static void FDCHDC_Poll(ARMul_State *state,CycleCount nowtime)
-{
-  EventQ_RescheduleHead(state,nowtime+250,FDCHDC_Poll); /* TODO - This probably needs to be made realtime */
-  FDC_Regular(state);
-  HDC_Regular(state);
-}
+static void ScheduleTimerEvent(ARMul_State *state,CycleCount nowtime,int idx);
 
 /*-----------------------------------------------------------------------------*/
 void
@@ -50,12 +42,12 @@ IO_Init(ARMul_State *state)
   ioc.TimerInputLatch[2] = 0xffff;
   ioc.TimerInputLatch[3] = 0xffff;
   ioc.Timer0CanInt = ioc.Timer1CanInt = 1;
-  ioc.TimersLastUpdated = -1;
-  ioc.NextTimerTrigger = ARMul_Time;
+  ioc.TimerCount[0] = ioc.TimerCount[1] = ioc.TimerCount[2] = ioc.TimerCount[3] = 0;
+  ioc.TimersLastUpdated = ARMul_Time;
   ioc.TimerFracBit = 0; 
   ioc.IOCRate = ioc.InvIOCRate = 0x10000; /* Default values shouldn't matter so much */
   ioc.IOEBControlReg = 0;
-  EventQ_Insert(state,ARMul_Time,UpdateTimerRegisters_Event);
+  ScheduleTimerEvent(state,ARMul_Time,-1);
 
   IO_UpdateNirq(state);
   IO_UpdateNfiq(state);
@@ -64,7 +56,6 @@ IO_Init(ARMul_State *state)
   FDC_Init(state);
   HDC_Init(state);
   Kbd_Init(state);
-  EventQ_Insert(state,ARMul_Time+250,FDCHDC_Poll);
 } /* IO_Init */
 
 /*------------------------------------------------------------------------------*/
@@ -123,113 +114,127 @@ CalcCanTimerInt(ARMul_State *state)
     UpdateTimerRegisters(state);
 } /* CalcCanTimerInt */
 
-/** Get the value of a timer uptodate - don't actually update anything - just
- * return the current value (for the Latch command)
+/** Work out the value of a timer after the given number of IOC ticks have
+ *  elapsed since TimersLastUpdated. The timer counts down to zero, reloads
+ *  from the input latch on the next tick, and repeats every latch+1 ticks
  */
 static int32_t
-GetCurrentTimerVal(ARMul_State *state,int toget)
+TimerValAfter(int timer,int32_t ticks)
 {
-  CycleDiff timeSinceLastUpdate = ARMul_Time - ioc.TimersLastUpdated;
-  int32_t scaledTimeSlip = (int32_t)((((uint64_t) timeSinceLastUpdate) * ioc.IOCRate + ioc.TimerFracBit)>>16);
-  int32_t tmpL;
-  int32_t result;
+  int32_t count = ioc.TimerCount[timer];
+  int32_t latch = ioc.TimerInputLatch[timer];
 
-  tmpL = ioc.TimerInputLatch[toget]+1;
-  result = ioc.TimerCount[toget] - (scaledTimeSlip % tmpL);
-  if (result < 0) result += tmpL;
+  if (ticks <= count)
+    return count - ticks;
+  return latch - ((ticks - count - 1) % (latch + 1));
+}
 
-  return result;
+/** Number of whole IOC ticks which have elapsed since TimersLastUpdated */
+static int32_t
+TimerTicksSince(CycleCount nowtime)
+{
+  CycleCount timeSinceLastUpdate = nowtime - ioc.TimersLastUpdated;
+  return (int32_t)((((uint64_t) timeSinceLastUpdate) * ioc.IOCRate + ioc.TimerFracBit)>>16);
 }
 
+/** Get the value of a timer uptodate - don't actually update anything - just
+ * return the current value (for the Latch command)
+ */
+static int32_t
+GetCurrentTimerVal(ARMul_State *state,int toget)
+{
+  return TimerValAfter(toget,TimerTicksSince(ARMul_Time));
+}
 
 /*------------------------------------------------------------------------------*/
-static void UpdateTimerRegisters_Internal(ARMul_State *state,CycleCount nowtime,int idx)
+/** Fold the time elapsed since TimersLastUpdated into the timer counts,
+ *  raising any timer interrupts which have become due. The counts are
+ *  otherwise derived on demand, so this is only needed before the timer
+ *  state or the IOC rate changes, or when an interrupt is due
+ */
+static void
+UpdateTimerCounts(ARMul_State *state,CycleCount nowtime)
 {
-  uint32_t tmpL;
-  CycleDiff scaledTimeSlip, nextTrigger;
-  CycleDiff timeSinceLastUpdate = nowtime - ioc.TimersLastUpdated;
+  CycleCount timeSinceLastUpdate = nowtime - ioc.TimersLastUpdated;
   /* Take into account any lost fractions of an IOC tick */
   uint64_t TimeSlip = (((uint64_t) timeSinceLastUpdate) * ioc.IOCRate)+ioc.TimerFracBit;
+  int32_t scaledTimeSlip = (int32_t) (TimeSlip>>16);
+  int timer;
+
   ioc.TimerFracBit = (uint_least16_t) (TimeSlip & 0xffff);
-  scaledTimeSlip = (CycleDiff) (TimeSlip>>16);
-
-  /* In theory we should be able to use MAX_CYCLES_INTO_FUTURE as our default
-     next trigger time. But some software (e.g. Lotus Turbo Challenge II) seems
-     to break and get stuck in a loop waiting for an interrupt which never
-     happens (presumably due a bug in ArcEm somewhere).
-     So use a failsafe default next trigger time of 65536 IOC cycles from now
-     (i.e. the max possible timer period) */
-  nextTrigger = ioc.InvIOCRate; /* a.k.a. 65536 IOC cycles from now */
-
-  /* ----------------------------------------------------------------- */
-  tmpL = ioc.TimerInputLatch[0]+1;
+  ioc.TimersLastUpdated = nowtime;
+  if (!scaledTimeSlip)
+    return;
+
   if (ioc.TimerCount[0] < scaledTimeSlip) {
     KBD.TimerIntHasHappened++;
     ioc.IRQStatus |= IRQA_TM0;
-    IO_UpdateNirq(state);
     ioc.Timer0CanInt = 0; /* Because it's just caused one which hasn't cleared yet */
   }
-  ioc.TimerCount[0] -= (scaledTimeSlip % tmpL);
-  if (ioc.TimerCount[0] < 0) ioc.TimerCount[0] += tmpL;
-
-  if (ioc.Timer0CanInt) {
-    tmpL = (uint32_t)((((uint64_t) (ioc.TimerCount[0]+1)) * ioc.InvIOCRate) >> 16);
-    if ((int)tmpL < nextTrigger) nextTrigger = tmpL;
-  }
-
-  /* ----------------------------------------------------------------- */
-  tmpL = ioc.TimerInputLatch[1]+1;
   if (ioc.TimerCount[1] < scaledTimeSlip) {
     ioc.IRQStatus |= IRQA_TM1;
-    IO_UpdateNirq(state);
     ioc.Timer1CanInt = 0; /* Because its just caused one which hasn't cleared yet */
   }
-  ioc.TimerCount[1] -= (scaledTimeSlip % tmpL);
-  if (ioc.TimerCount[1] < 0) ioc.TimerCount[1] += tmpL;
-
-  if (ioc.Timer1CanInt) {
-    tmpL = (uint32_t)((((uint64_t) (ioc.TimerCount[1]+1)) * ioc.InvIOCRate) >> 16);
-    if ((int)tmpL < nextTrigger) nextTrigger = tmpL;
-  }
+  if (ioc.IRQStatus & (IRQA_TM0 | IRQA_TM1))
+    IO_UpdateNirq(state);
 
-  /* ----------------------------------------------------------------- */
-  if (ioc.TimerInputLatch[2]) {
-    tmpL = ioc.TimerInputLatch[2]+1;
-    ioc.TimerCount[2] -= (scaledTimeSlip % tmpL);
-    if(ioc.TimerCount[2] < 0) ioc.TimerCount[2] += tmpL;
-  }
+  for (timer = 0; timer < 4; timer++)
+    ioc.TimerCount[timer] = TimerValAfter(timer,scaledTimeSlip);
+}
 
-  /* ----------------------------------------------------------------- */
-  if (ioc.TimerInputLatch[3]) {
-    tmpL = ioc.TimerInputLatch[3]+1;
-    ioc.TimerCount[3] -= (scaledTimeSlip % tmpL);
-    if(ioc.TimerCount[3] < 0) ioc.TimerCount[3] += tmpL;
+/** Make sure the timer event is scheduled for the next Timer 0/1 interrupt.
+ *  If neither timer can currently interrupt, the event is only kept as a
+ *  failsafe while a timer interrupt is unmasked, and is otherwise removed
+ */
+static void
+ScheduleTimerEvent(ARMul_State *state,CycleCount nowtime,int idx)
+{
+  uint32_t ticks = 0;
+  CycleDiff nextTrigger;
+
+  if (ioc.Timer0CanInt)
+    ticks = ioc.TimerCount[0]+1;
+  if (ioc.Timer1CanInt && (!ticks || (uint32_t) (ioc.TimerCount[1]+1) < ticks))
+    ticks = ioc.TimerCount[1]+1;
+
+  if (!ticks) {
+    /* Some software (e.g. Lotus Turbo Challenge II) seems to break and get
+       stuck in a loop waiting for an interrupt which never happens
+       (presumably due a bug in ArcEm somewhere). So while the timer
+       interrupts are unmasked, wake up at least every 65536 IOC cycles
+       (i.e. the max possible timer period) */
+    if (!(ioc.IRQMask & (IRQA_TM0 | IRQA_TM1))) {
+      if (idx >= 0)
+        EventQ_Remove(state,idx);
+      return;
+    }
+    ticks = 65536;
   }
 
-  ioc.TimersLastUpdated = nowtime;
-
-  /* Don't get stuck if we're waiting for something that's about to fire */
-  if(!idx && (nextTrigger < 32768) && (nextTrigger*ioc.IOCRate < 65536))
-  {
-    do {
-      nextTrigger = (nextTrigger<<1) | 1;
-    } while(nextTrigger*ioc.IOCRate < 65536);
-  }
+  /* Convert to emu cycles, rounding up so that we don't wake before the
+     timer has actually underflowed */
+  nextTrigger = (CycleDiff) ((((((uint64_t) ticks)<<16) - ioc.TimerFracBit) * ioc.InvIOCRate + 0xffffffff) >> 32);
+  if (nextTrigger < 1)
+    nextTrigger = 1;
 
-  ioc.NextTimerTrigger = nowtime + nextTrigger;
-  EventQ_Reschedule(state,nowtime + nextTrigger,UpdateTimerRegisters_Event,idx);
+  if (idx >= 0)
+    EventQ_Reschedule(state,nowtime + nextTrigger,UpdateTimerRegisters_Event,idx);
+  else
+    EventQ_Insert(state,nowtime + nextTrigger,UpdateTimerRegisters_Event);
 }
 
 void
 UpdateTimerRegisters(ARMul_State *state)
 {
-  UpdateTimerRegisters_Internal(state,ARMul_Time,EventQ_Find(state,UpdateTimerRegisters_Event));
+  UpdateTimerCounts(state,ARMul_Time);
+  ScheduleTimerEvent(state,ARMul_Time,EventQ_Find(state,UpdateTimerRegisters_Event));
 }
 
-void
+static void
 UpdateTimerRegisters_Event(ARMul_State *state,CycleCount nowtime)
 {
-  UpdateTimerRegisters_Internal(state,nowtime,0);
+  UpdateTimerCounts(state,nowtime);
+  ScheduleTimerEvent(state,nowtime,0);
 }
 
 /** Called when there has been a write to the IOC control register - this
@@ -378,6 +383,7 @@ PutVal_IOCReg(ARMul_State *state, int Register, ARMword data, bool bNw)
       ioc.IRQStatus &= ~IRQB_STX; /* Clear KART Tx empty */
       dbug_ioc("IOC Write: Serial Tx Reg Val=0x%x\n", data);
       IO_UpdateNirq(state);
+      Kbd_TxDataWritten(state);
       break;
 
     case 5: /* IRQ Clear */
@@ -395,6 +401,9 @@ PutVal_IOCReg(ARMul_State *state, int Register, ARMword data, bool bNw)
       ioc.IRQMask &= 0xff00;
       ioc.IRQMask |= (data & 0xff);
       CalcCanTimerInt(state);
+      /* Unmasking a timer may need the failsafe wakeup */
+      if ((ioc.IRQMask & (IRQA_TM0 | IRQA_TM1)) && (EventQ_Find(state,UpdateTimerRegisters_Event) < 0))
+        UpdateTimerRegisters(state);
       dbug_ioc("IOC Write: IRQ Mask A Val=0x%x\n", data);
       IO_UpdateNirq(state);
       break;
@@ -417,10 +426,10 @@ PutVal_IOCReg(ARMul_State *state, int Register, ARMword data, bool bNw)
     case 0x18: /* T2 latch low */
     case 0x1c: /* T3 latch low */
       Timer = (Register & 0xf) >> 2;
-      UpdateTimerRegisters(state);
+      /* Doesn't affect when the next interrupt is due */
+      UpdateTimerCounts(state,ARMul_Time);
       ioc.TimerInputLatch[Timer] &= 0xff00;
       ioc.TimerInputLatch[Timer] |= data;
-      UpdateTimerRegisters(state);
       dbug_ioc("IOC Write: Timer %d latch write low Val=0x%x InpLatch=0x%x\n",
               Timer, data, ioc.TimerInputLatch[Timer]);
       break;
@@ -430,10 +439,10 @@ PutVal_IOCReg(ARMul_State *state, int Register, ARMword data, bool bNw)
     case 0x19: /* T2 latch High */
     case 0x1d: /* T3 latch High */
       Timer = (Register & 0xf) >> 2;
-      UpdateTimerRegisters(state);
+      /* Doesn't affect when the next interrupt is due */
+      UpdateTimerCounts(state,ARMul_Time);
       ioc.TimerInputLatch[Timer] &= 0xff;
       ioc.TimerInputLatch[Timer] |= data << 8;
-      UpdateTimerRegisters(state);
       dbug_ioc("IOC Write: Timer %d latch write high Val=0x%x InpLatch=0x%x\n",
               Timer, data, ioc.TimerInputLatch[Timer]);
       break;
@@ -443,9 +452,10 @@ PutVal_IOCReg(ARMul_State *state, int Register, ARMword data, bool bNw)
     case 0x1a: /* T2 Go */
     case 0x1e: /* T3 Go */
       Timer = (Register & 0xf) >> 2;
-      UpdateTimerRegisters(state);
+      UpdateTimerCounts(state,ARMul_Time);
       ioc.TimerCount[Timer] = ioc.TimerInputLatch[Timer];
-      UpdateTimerRegisters(state);
+      if (Timer < 2)
+        ScheduleTimerEvent(state,ARMul_Time,EventQ_Find(state,UpdateTimerRegisters_Event));
       dbug_ioc("IOC Write: Timer %d Go! Counter=0x%x\n",
               Timer, ioc.TimerCount[Timer]);
       break;
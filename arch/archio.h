@@ -23,7 +23,6 @@ struct IOCStruct {
   uint_least16_t TimerOutputLatch[4];
 
   CycleCount TimersLastUpdated;
-  CycleCount NextTimerTrigger;
   uint_least16_t TimerFracBit;
   bool Timer0CanInt;
   bool Timer1CanInt;
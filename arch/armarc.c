@@ -25,10 +25,12 @@
 #include "archio.h"
 #include "archio.h"
 #include "fdc1772.h"
+#include "hdc63463.h"
 #include "extnrom.h"
 #include "ArcemConfig.h"
 #include "sound.h"
 #include "displaydev.h"
+#include "capture.h"
 #include "filecalls.h"
 #include "ControlPane.h"
 
@@ -356,6 +358,8 @@ ARMul_MemoryInit(ARMul_State *state)
     ControlPane_Error(EXIT_FAILURE,"Could not initialise sound output - exiting\n");
   }
 
+  Capture_Init(state);
+
   for (i = 0; i < 512 * 1024 / UPDATEBLOCKSIZE; i++) {
     MEMC.UpdateFlags[i] = 1;
   }
@@ -379,8 +383,11 @@ ARMul_MemoryInit(ARMul_State *state)
  */
 void ARMul_MemoryExit(ARMul_State *state)
 {
+  Capture_Shutdown(state);
   Sound_Shutdown(state);
   DisplayDev_Shutdown(state);
+  HDC_Shutdown(state);
+  FDC_Shutdown(state);
   free(MEMC.ROMRAMChunk);
 #ifdef ARMUL_INSTR_FUNC_CACHE
   free(MEMC.EmuFuncChunk);
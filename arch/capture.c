@@ -0,0 +1,610 @@
+/*
+   arch/capture.c
+
+   Part of Arcem, covered under the GNU GPL, see file COPYING for details
+
+   Recording of the emulated display and sound output, for making demo
+   recordings and for comparing runs.
+
+   At the end of each frame the display device hands over to Capture_Frame,
+   which copies the display area of screen memory (along with the palette) into
+   a small queue. Mixed sound output is copied into a second queue as it's
+   produced. Both queues are single producer/single consumer rings, drained by
+   a writer thread (where RENDER_THREAD is enabled) which converts the frames
+   to an uncompressed 4:4:4 Y4M file and appends the sound to a 16 bit stereo
+   WAV file. The emulator never waits for the writer; if a queue is full then
+   the frame or sound is dropped. Dropped frames are replaced by repeats of the
+   previous frame, and missing sound by silence, so that the two files stay in
+   step. Without RENDER_THREAD everything is written out immediately instead.
+
+   Video uses the emulated frame rate, so a recording made while running
+   faster or slower than real time still plays back at the right speed. A new
+   Y4M file is started whenever the size of the display area changes.
+
+   Like the null display device's snapshots, frames only show the display
+   area; the border and mouse pointer are not drawn, and palette changes part
+   way through a frame aren't seen.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef RENDER_THREAD
+#include <pthread.h>
+#endif
+
+#include "../armdefs.h"
+#include "armarc.h"
+#include "dbugsys.h"
+#include "displaydev.h"
+#include "ArcemConfig.h"
+#include "capture.h"
+
+#define CAPTURE_FRAMES 8 /* Size of video queue, must be power of two */
+#define CAPTURE_CHUNKS 32 /* Size of sound queue, must be power of two */
+#define CAPTURE_CHUNKSIZE 1024 /* Stereo pairs per sound queue entry */
+
+/* A queued frame */
+struct Capture_Frame {
+  uint32_t Frame; /* Frame number, counted from the start of the recording */
+  int Width,Height;
+  uint32_t RateNum,RateDen; /* Frame rate, RateNum/RateDen Hz, in lowest terms */
+  uint_fast16_t CR; /* VIDC.ControlReg */
+  bool DMAEn; /* Whether video DMA was enabled */
+  uint_least16_t Palette[16];
+  uint_least16_t BorderCol;
+  ARMword Data[(512*1024)/4]; /* Screen memory, unwrapped */
+};
+
+/* A queued run of sound */
+struct Capture_Chunk {
+  uint32_t Time; /* Where the samples are due in the output, in stereo pairs */
+  uint32_t Rate; /* Sample rate, in Hz */
+  int32_t Count; /* Number of stereo pairs */
+  SoundData Data[CAPTURE_CHUNKSIZE*2];
+};
+
+static struct {
+  bool Active;
+
+  /* Emulator thread */
+  uint32_t Frame; /* Next frame number */
+  uint64_t SoundTime; /* Expected sound output position, in 1/1024ths of a stereo pair */
+  uint64_t SoundFrac; /* Fraction of a 1/1024th carried between frames, over the frame rate's numerator */
+  uint32_t DroppedFrames,DroppedChunks;
+
+  /* Queues; the heads are only written by the emulator thread, and the tails
+     by the writer */
+  struct Capture_Frame *Frames;
+  struct Capture_Chunk *Chunks;
+  uint32_t FrameHead,FrameTail;
+  uint32_t ChunkHead,ChunkTail;
+
+  /* Writer */
+  const char *Prefix;
+  FILE *Video,*Sound;
+  bool VideoFailed,SoundFailed; /* Set if a file couldn't be opened */
+  int VideoWidth,VideoHeight;
+  uint32_t VideoFrame; /* Frame number expected next in the video file */
+  uint32_t VideoFrames,RepeatedFrames; /* Frame counts, for the summary */
+  uint8_t *Planes; /* YUV of the last frame written */
+  uint32_t SoundRate;
+  uint32_t SoundPos; /* Stereo pairs written */
+  uint32_t SilencePairs; /* Stereo pairs of padding written */
+
+#ifdef RENDER_THREAD
+  bool Running; /* Whether the writer thread was started */
+  bool Quit; /* Set to make the writer thread exit */
+  int Sleeping; /* Set while the writer is (about to be) waiting on Wake */
+  pthread_t Thread;
+  pthread_mutex_t Mutex; /* Protects Quit */
+  pthread_cond_t Wake;
+#endif
+} capture;
+
+/* The queue indices are shared between the emulator thread and the writer.
+   Using sequentially consistent accesses means the emulator only needs to take
+   the mutex when it has to wake the writer up. */
+#ifdef RENDER_THREAD
+#define Capture_Load(x) __atomic_load_n(&(x),__ATOMIC_SEQ_CST)
+#define Capture_Store(x,v) __atomic_store_n(&(x),(v),__ATOMIC_SEQ_CST)
+#else
+#define Capture_Load(x) (x)
+#define Capture_Store(x,v) ((x) = (v))
+#endif
+
+/*
+
+  Writer
+
+*/
+
+static void Capture_Put32(uint8_t *out,uint32_t val)
+{
+  out[0] = val;
+  out[1] = val>>8;
+  out[2] = val>>16;
+  out[3] = val>>24;
+}
+
+static uint32_t Capture_VIDCToYUV(uint_fast16_t col)
+{
+  /* BT.601, studio range */
+  int r = (col & 0xf)*0x11;
+  int g = ((col>>4) & 0xf)*0x11;
+  int b = ((col>>8) & 0xf)*0x11;
+  int y = ((66*r+129*g+25*b+128)>>8)+16;
+  int u = ((-38*r-74*g+112*b+128)>>8)+128;
+  int v = ((112*r-94*g-18*b+128)>>8)+128;
+  return y | (u<<8) | (v<<16);
+}
+
+static void Capture_CloseVideo(void)
+{
+  if(!capture.Video)
+    return;
+  if(ferror(capture.Video) | fclose(capture.Video)) {
+    warn_vidc("Failed to write capture video\n");
+  }
+  capture.Video = NULL;
+}
+
+static bool Capture_OpenVideo(const struct Capture_Frame *f)
+{
+  char *filename = malloc(strlen(capture.Prefix)+16);
+  uint8_t *planes = realloc(capture.Planes,f->Width*f->Height*3);
+  if(!filename || !planes) {
+    warn_vidc("Failed to allocate memory for capture\n");
+    free(filename);
+    if(planes)
+      capture.Planes = planes;
+    return false;
+  }
+  capture.Planes = planes;
+
+  /* First file gets the plain name, the rest are named after the frame they
+     start on */
+  if(!capture.VideoFrames)
+    sprintf(filename,"%s.y4m",capture.Prefix);
+  else
+    sprintf(filename,"%s-%08u.y4m",capture.Prefix,(unsigned int) f->Frame);
+
+  capture.Video = fopen(filename,"wb");
+  if(!capture.Video) {
+    warn_vidc("Failed to open capture file %s\n",filename);
+    free(filename);
+    return false;
+  }
+  /* Low-res modes have tall pixels */
+  fprintf(capture.Video,"YUV4MPEG2 W%d H%d F%u:%u Ip A%s C444\n",f->Width,f->Height,(unsigned int) f->RateNum,(unsigned int) f->RateDen,(f->Width >= f->Height*2 ? "1:2" : "1:1"));
+  warn_vidc("Capturing %dx%d video to %s\n",f->Width,f->Height,filename);
+  free(filename);
+
+  capture.VideoWidth = f->Width;
+  capture.VideoHeight = f->Height;
+  capture.VideoFrame = f->Frame;
+  return true;
+}
+
+static void Capture_WriteFrame(const struct Capture_Frame *f)
+{
+  static const uint_least16_t ExtraPal[16] = {
+    0x000, 0x008, 0x040, 0x048, 0x080, 0x088, 0x0c0, 0x0c8,
+    0x800, 0x808, 0x840, 0x848, 0x880, 0x888, 0x8c0, 0x8c8
+  };
+  const int log2bpp = (f->CR>>2) & 3;
+  const ARMword mask = (1<<(1<<log2bpp))-1;
+  const size_t pixels = f->Width*f->Height;
+  uint32_t Palette[256];
+  uint8_t *y,*u,*v;
+  size_t i;
+
+  if(capture.VideoFailed)
+    return;
+  if((f->Width != capture.VideoWidth) || (f->Height != capture.VideoHeight) || !capture.Video) {
+    Capture_CloseVideo();
+    if(!Capture_OpenVideo(f)) {
+      capture.VideoFailed = true;
+      return;
+    }
+  }
+
+  /* Fill any gap left by dropped frames with the last frame */
+  while((int32_t) (f->Frame - capture.VideoFrame) > 0) {
+    fputs("FRAME\n",capture.Video);
+    fwrite(capture.Planes,3,pixels,capture.Video);
+    capture.VideoFrame++;
+    capture.RepeatedFrames++;
+  }
+
+  if(log2bpp == 3) {
+    for(i=0;i<256;i++) {
+      Palette[i] = Capture_VIDCToYUV((f->Palette[i & 15] & 0x1737) | ExtraPal[i>>4]);
+    }
+  } else {
+    for(i=0;i<16;i++) {
+      Palette[i] = Capture_VIDCToYUV(f->Palette[i]);
+    }
+  }
+
+  y = capture.Planes;
+  u = y+pixels;
+  v = u+pixels;
+  if(!f->DMAEn) {
+    uint32_t yuv = Capture_VIDCToYUV(f->BorderCol);
+    memset(y,yuv & 0xff,pixels);
+    memset(u,(yuv>>8) & 0xff,pixels);
+    memset(v,yuv>>16,pixels);
+  } else {
+    for(i=0;i<pixels;i++) {
+      size_t bit = i<<log2bpp;
+      uint32_t yuv = Palette[(f->Data[bit>>5]>>(bit & 31)) & mask];
+      y[i] = yuv;
+      u[i] = yuv>>8;
+      v[i] = yuv>>16;
+    }
+  }
+
+  fputs("FRAME\n",capture.Video);
+  fwrite(capture.Planes,3,pixels,capture.Video);
+  capture.VideoFrame = f->Frame+1;
+  capture.VideoFrames++;
+}
+
+static void Capture_CloseSound(void)
+{
+  uint8_t len[4];
+  if(!capture.Sound)
+    return;
+  /* Fill in the RIFF and data chunk lengths */
+  Capture_Put32(len,36+capture.SoundPos*4);
+  fseek(capture.Sound,4,SEEK_SET);
+  fwrite(len,1,4,capture.Sound);
+  Capture_Put32(len,capture.SoundPos*4);
+  fseek(capture.Sound,40,SEEK_SET);
+  fwrite(len,1,4,capture.Sound);
+  if(ferror(capture.Sound) | fclose(capture.Sound)) {
+    warn_vidc("Failed to write capture sound\n");
+  }
+  capture.Sound = NULL;
+}
+
+static bool Capture_OpenSound(uint32_t rate)
+{
+  uint8_t header[44];
+  char *filename = malloc(strlen(capture.Prefix)+16);
+  if(!filename) {
+    warn_vidc("Failed to allocate memory for capture\n");
+    return false;
+  }
+  sprintf(filename,"%s.wav",capture.Prefix);
+  capture.Sound = fopen(filename,"wb");
+  if(!capture.Sound) {
+    warn_vidc("Failed to open capture file %s\n",filename);
+    free(filename);
+    return false;
+  }
+  warn_vidc("Capturing %uHz sound to %s\n",(unsigned int) rate,filename);
+  free(filename);
+
+  /* 16 bit stereo PCM; the lengths get filled in on close */
+  memcpy(header,"RIFF\0\0\0\0WAVEfmt ",16);
+  Capture_Put32(header+16,16);
+  Capture_Put32(header+20,1 | (2<<16)); /* PCM, 2 channels */
+  Capture_Put32(header+24,rate);
+  Capture_Put32(header+28,rate*4);
+  Capture_Put32(header+32,4 | (16<<16)); /* 4 byte blocks, 16 bits per sample */
+  memcpy(header+36,"data\0\0\0\0",8);
+  fwrite(header,1,44,capture.Sound);
+
+  capture.SoundRate = rate;
+  return true;
+}
+
+static void Capture_WriteChunk(const struct Capture_Chunk *c)
+{
+  uint8_t out[CAPTURE_CHUNKSIZE*4];
+  int swap = (eSound_StereoSense == Stereo_RightLeft);
+  int32_t i;
+
+  if(!capture.Sound) {
+    if(capture.SoundFailed || !Capture_OpenSound(c->Rate)) {
+      capture.SoundFailed = true;
+      return;
+    }
+  }
+
+  /* If we're more than a tenth of a second behind (samples were dropped, the
+     host stopped asking for sound, or this is the start of the recording) then
+     catch up with silence */
+  if((int32_t) (c->Time - capture.SoundPos) > (int32_t) (capture.SoundRate/10)) {
+    uint32_t gap = c->Time - capture.SoundPos;
+    memset(out,0,sizeof(out));
+    capture.SilencePairs += gap;
+    capture.SoundPos += gap;
+    while(gap) {
+      uint32_t n = MIN(gap,CAPTURE_CHUNKSIZE);
+      fwrite(out,4,n,capture.Sound);
+      gap -= n;
+    }
+  }
+
+  /* WAV is little-endian, left channel first */
+  for(i=0;i<c->Count;i++) {
+    uint16_t l = c->Data[i*2+swap];
+    uint16_t r = c->Data[i*2+1-swap];
+    out[i*4] = l;
+    out[i*4+1] = l>>8;
+    out[i*4+2] = r;
+    out[i*4+3] = r>>8;
+  }
+  fwrite(out,4,c->Count,capture.Sound);
+  capture.SoundPos += c->Count;
+}
+
+/* Write out whatever's queued, returning false if there was nothing */
+static bool Capture_Drain(void)
+{
+  bool busy = false;
+  uint32_t tail;
+
+  tail = capture.ChunkTail;
+  while(tail != Capture_Load(capture.ChunkHead)) {
+    Capture_WriteChunk(&capture.Chunks[tail & (CAPTURE_CHUNKS-1)]);
+    Capture_Store(capture.ChunkTail,++tail);
+    busy = true;
+  }
+
+  tail = capture.FrameTail;
+  if(tail != Capture_Load(capture.FrameHead)) {
+    /* One frame at a time, so the sound queue doesn't fill up behind a burst
+       of frames */
+    Capture_WriteFrame(&capture.Frames[tail & (CAPTURE_FRAMES-1)]);
+    Capture_Store(capture.FrameTail,tail+1);
+    busy = true;
+  }
+
+  return busy;
+}
+
+#ifdef RENDER_THREAD
+static bool Capture_Pending(void)
+{
+  return (Capture_Load(capture.ChunkHead) != capture.ChunkTail) || (Capture_Load(capture.FrameHead) != capture.FrameTail);
+}
+
+static void *Capture_WriterThread(void *arg)
+{
+  bool quit = false;
+  while(!quit) {
+    if(Capture_Drain())
+      continue;
+    pthread_mutex_lock(&capture.Mutex);
+    Capture_Store(capture.Sleeping,1);
+    while(!Capture_Pending() && !capture.Quit) {
+      pthread_cond_wait(&capture.Wake,&capture.Mutex);
+    }
+    Capture_Store(capture.Sleeping,0);
+    quit = capture.Quit && !Capture_Pending();
+    pthread_mutex_unlock(&capture.Mutex);
+  }
+  return NULL;
+}
+#endif
+
+/* Called once something has been queued */
+static void Capture_Queued(void)
+{
+#ifdef RENDER_THREAD
+  if(capture.Running) {
+    /* The writer sets Sleeping before its final check of the queues, so if
+       it's clear then the writer is guaranteed to see the new entry */
+    if(Capture_Load(capture.Sleeping)) {
+      pthread_mutex_lock(&capture.Mutex);
+      pthread_cond_signal(&capture.Wake);
+      pthread_mutex_unlock(&capture.Mutex);
+    }
+    return;
+  }
+#endif
+  Capture_Drain();
+}
+
+/*
+
+  Emulator side
+
+*/
+
+void Capture_Frame(ARMul_State *state,uint32_t ratenum,uint32_t rateden)
+{
+  struct Capture_Frame *f;
+  uint32_t frame, head, words, copied;
+  uint32_t Vptr, Vstart, Vend, RAMWords;
+  int Width, Height;
+
+  if(!capture.Active)
+    return;
+
+  frame = capture.Frame++;
+  if(!ratenum || !rateden)
+    ratenum = rateden = 1;
+#ifdef SOUND_SUPPORT
+  /* Step by the exact frame length, carrying the remainder over, so the
+     expected position doesn't drift away from the sound that's produced */
+  {
+    uint64_t step = ((uint64_t) Sound_HostRate)*rateden + capture.SoundFrac;
+    capture.SoundTime += step/ratenum;
+    capture.SoundFrac = step%ratenum;
+  }
+#endif
+
+  head = capture.FrameHead;
+  if(head - Capture_Load(capture.FrameTail) >= CAPTURE_FRAMES) {
+    dbug_vidc("Capture queue full, dropping frame %u\n",(unsigned int) frame);
+    capture.DroppedFrames++;
+    return;
+  }
+  f = &capture.Frames[head & (CAPTURE_FRAMES-1)];
+
+  Width = (VIDC.Horiz_DisplayEnd-VIDC.Horiz_DisplayStart)*2;
+  Height = VIDC.Vert_DisplayEnd-VIDC.Vert_DisplayStart;
+  f->CR = VIDC.ControlReg;
+  f->DMAEn = (MEMC.ControlReg>>10)&1;
+  if(Height <= 0) {
+    /* Display output has been forced off; show just the border */
+    Height = VIDC.Vert_BorderEnd-VIDC.Vert_BorderStart;
+    f->DMAEn = false;
+  }
+  if((Width < 1) || (Height < 1)) {
+    /* Bad mode; the writer will repeat the last good frame */
+    return;
+  }
+  words = (((Width*Height)<<((f->CR>>2) & 3))+31)>>5;
+  if(words > (512*1024)/4) {
+    /* Bigger than the screen memory can be; crop */
+    Height = (512*1024*8)/(Width<<((f->CR>>2) & 3));
+    words = (512*1024)/4;
+  }
+
+  f->Frame = frame;
+  f->Width = Width;
+  f->Height = Height;
+  {
+    /* Reduce the rate for the Y4M header */
+    uint32_t a = ratenum, b = rateden;
+    while(b) {
+      uint32_t t = a%b;
+      a = b;
+      b = t;
+    }
+    f->RateNum = ratenum/a;
+    f->RateDen = rateden/a;
+  }
+  memcpy(f->Palette,VIDC.Palette,sizeof(f->Palette));
+  f->BorderCol = VIDC.BorderCol;
+
+  if(f->DMAEn) {
+    /* Copy the screen, unwrapping it as we go. All the DMA pointers are
+       16 byte aligned, so this can be done a word at a time */
+    RAMWords = MIN(MEMC.RAMSize,512*1024)/4;
+    Vptr = MEMC.Vinit<<2;
+    Vstart = MEMC.Vstart<<2;
+    Vend = (MEMC.Vend+1)<<2; /* Point to word after end */
+    /* Sanity checks to avoid looping forever */
+    if(Vend <= Vstart)
+      Vend = Vstart+4;
+    if(Vptr >= Vend)
+      Vptr = Vstart;
+    copied = 0;
+    while(copied < words) {
+      uint32_t run = MIN(words-copied,Vend-Vptr);
+      uint32_t valid = (Vptr < RAMWords ? MIN(run,RAMWords-Vptr) : 0);
+      memcpy(f->Data+copied,MEMC.PhysRam+Vptr,valid*4);
+      memset(f->Data+copied+valid,0,(run-valid)*4);
+      copied += run;
+      Vptr += run;
+      if(Vptr >= Vend)
+        Vptr = Vstart;
+    }
+  }
+
+  Capture_Store(capture.FrameHead,head+1);
+  Capture_Queued();
+}
+
+#ifdef SOUND_SUPPORT
+void Capture_Sound(const SoundData *buffer,int32_t numSamples)
+{
+  uint32_t time;
+
+  if(!capture.Active)
+    return;
+
+  /* The batch ends at the current time */
+  time = (uint32_t) (capture.SoundTime>>10)-numSamples;
+  while(numSamples > 0) {
+    struct Capture_Chunk *c;
+    uint32_t head = capture.ChunkHead;
+    int32_t count = MIN(numSamples,CAPTURE_CHUNKSIZE);
+    if(head - Capture_Load(capture.ChunkTail) >= CAPTURE_CHUNKS) {
+      capture.DroppedChunks++;
+      break;
+    }
+    c = &capture.Chunks[head & (CAPTURE_CHUNKS-1)];
+    c->Time = time;
+    c->Rate = Sound_HostRate>>10;
+    c->Count = count;
+    memcpy(c->Data,buffer,count*4);
+    Capture_Store(capture.ChunkHead,head+1);
+    buffer += count*2;
+    numSamples -= count;
+    time += count;
+  }
+  Capture_Queued();
+}
+#endif
+
+void Capture_Init(ARMul_State *state)
+{
+  memset(&capture,0,sizeof(capture));
+  if(!CONFIG.sCapturePrefix)
+    return;
+
+  capture.Prefix = CONFIG.sCapturePrefix;
+  capture.Frames = malloc(sizeof(struct Capture_Frame)*CAPTURE_FRAMES);
+  capture.Chunks = malloc(sizeof(struct Capture_Chunk)*CAPTURE_CHUNKS);
+  if(!capture.Frames || !capture.Chunks) {
+    warn_vidc("Failed to allocate capture queues, not capturing\n");
+    free(capture.Frames);
+    free(capture.Chunks);
+    return;
+  }
+
+#ifdef RENDER_THREAD
+  pthread_mutex_init(&capture.Mutex,NULL);
+  pthread_cond_init(&capture.Wake,NULL);
+  capture.Running = !pthread_create(&capture.Thread,NULL,Capture_WriterThread,NULL);
+  if(!capture.Running) {
+    warn_vidc("Failed to create capture thread, writing on main thread instead\n");
+  }
+#endif
+
+  capture.Active = true;
+}
+
+void Capture_Shutdown(ARMul_State *state)
+{
+  if(!capture.Active)
+    return;
+  capture.Active = false;
+
+#ifdef RENDER_THREAD
+  if(capture.Running) {
+    /* Let the writer empty the queues */
+    pthread_mutex_lock(&capture.Mutex);
+    capture.Quit = true;
+    pthread_cond_signal(&capture.Wake);
+    pthread_mutex_unlock(&capture.Mutex);
+    pthread_join(capture.Thread,NULL);
+  }
+  pthread_cond_destroy(&capture.Wake);
+  pthread_mutex_destroy(&capture.Mutex);
+#endif
+  while(Capture_Drain()) {}
+
+  Capture_CloseVideo();
+  Capture_CloseSound();
+
+  warn_vidc("Capture: %u frames (%u dropped, %u repeated in total), %u sound chunks dropped, %u silent samples\n",
+            (unsigned int) capture.VideoFrames,(unsigned int) capture.DroppedFrames,(unsigned int) capture.RepeatedFrames,
+            (unsigned int) capture.DroppedChunks,(unsigned int) capture.SilencePairs);
+
+  free(capture.Frames);
+  free(capture.Chunks);
+  free(capture.Planes);
+  capture.Frames = NULL;
+  capture.Chunks = NULL;
+  capture.Planes = NULL;
+}
@@ -0,0 +1,61 @@
+/*
+  arch/capture.h
+
+  Part of Arcem released under the GNU GPL, see file COPYING
+  for details.
+
+  Recording of the emulated display and sound output to Y4M video and WAV
+  audio files
+*/
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "../armdefs.h"
+#include "sound.h"
+
+/**
+ * Capture_Init
+ *
+ * Start recording, if a capture filename prefix has been configured. Must be
+ * called after the display and sound devices have been initialised.
+ *
+ * @param state Emulator state
+ */
+void Capture_Init(ARMul_State *state);
+
+/**
+ * Capture_Shutdown
+ *
+ * Write out everything that's still queued and close the files.
+ *
+ * @param state Emulator state
+ */
+void Capture_Shutdown(ARMul_State *state);
+
+/**
+ * Capture_Frame
+ *
+ * Called by the display device at the end of every frame (including skipped
+ * ones). Copies the display area of screen memory into the video queue, or
+ * drops the frame if the queue is full.
+ *
+ * @param state   Emulator state
+ * @param ratenum Frame rate of the current mode, as the exact fraction
+ * @param rateden ratenum/rateden Hz (0/0 if there's no mode yet)
+ */
+void Capture_Frame(ARMul_State *state,uint32_t ratenum,uint32_t rateden);
+
+#ifdef SOUND_SUPPORT
+/**
+ * Capture_Sound
+ *
+ * Called by the sound code with each batch of mixed output. Drops the
+ * samples if the sound queue is full.
+ *
+ * @param buffer     Mixed samples, in host channel order
+ * @param numSamples Number of stereo pairs
+ */
+void Capture_Sound(const SoundData *buffer,int32_t numSamples);
+#endif
+
+#endif
@@ -19,7 +19,11 @@ const DisplayDev *DisplayDev_Current = NULL;
 
 bool DisplayDev_UseUpdateFlags = true;
 bool DisplayDev_AutoUpdateFlags = false;
+bool DisplayDev_UseRowHashes = false;
+bool DisplayDev_Governor = false;
 int DisplayDev_FrameSkip = 0;
+volatile sig_atomic_t DisplayDev_StatsRequested = 0;
+uint32_t DisplayDev_HostBytes = 0;
 
 int DisplayDev_Set(ARMul_State *state,const DisplayDev *dev)
 {
@@ -12,6 +12,8 @@
 #ifndef DISPLAYDEV_H
 #define DISPLAYDEV_H
 
+#include <signal.h>
+
 typedef struct {
   int (*Init)(ARMul_State *state,const struct Vidc_Regs *Vidc); /* Initialise display device, return nonzero on failure */
   void (*Shutdown)(ARMul_State *state); /* Shutdown display device */
@@ -58,8 +60,20 @@ extern bool DisplayDev_AutoUpdateFlags; /* Automatically select whether to use U
 
 extern int DisplayDev_FrameSkip; /* If DisplayDev_UseUpdateFlags is true, this provides a frameskip value used by the standard & palettised drivers. If DisplayDev_UseUpdateFlags is false, it acts as failsafe counter that forces an update when a certain number of frames have passed */
 
+extern bool DisplayDev_UseRowHashes; /* If DisplayDev_UseUpdateFlags is false, this makes the standard driver process every frame, but hash each display row and only redraw the rows whose contents or palette have changed. DisplayDev_FrameSkip is ignored. */
+
+extern bool DisplayDev_Governor; /* Let the standard driver measure how much host time the display is costing, and adjust DisplayDev_FrameSkip, DisplayDev_UseUpdateFlags and the number of rows processed per event to suit. Overrides DisplayDev_AutoUpdateFlags. */
+
+extern volatile sig_atomic_t DisplayDev_StatsRequested; /* Set to make the standard driver log (and reset) its stats at the end of the current frame. Safe to set from a signal handler. */
+
+extern uint32_t DisplayDev_HostBytes; /* Hosts should add the number of bytes they upload to the host display or GPU here, for the standard driver's stats. */
+
 extern int DisplayDev_Set(ARMul_State *state,const DisplayDev *dev); /* Switch to indicated display device, returns nonzero on failure */
 
+/* Display device which keeps the VIDC timing but doesn't display anything, for
+   running headless (see nulldisplaydev.c) */
+extern const DisplayDev NullDD_DisplayDev;
+
 /* Host must provide this function to initialize the default display device */
 extern int DisplayDev_Init(ARMul_State *state);
 
@@ -24,6 +24,7 @@
 #include "ControlPane.h"
 #include "dbugsys.h"
 #include "fdc1772.h"
+#include "overlay.h"
 
 #define DBG(a) dbug_fdc a
 
@@ -41,6 +42,17 @@ typedef struct {
 typedef struct {
     /* To access the disc image.  NULL if disc ejected. */
     FILE *fp;
+    /* The whole image, loaded on insert and written back to fp by
+     * FDC_SyncDrive. */
+    uint8_t *data;
+    uint32_t size;
+    /* Offset of the next byte to transfer. */
+    uint32_t pos;
+    /* Written to since the image was last written back. */
+    bool dirty;
+    /* If set, changes are written back here rather than to fp, which
+     * is then only read. */
+    Overlay *overlay;
     /* Based on whether read/write access to the disc image was
      * obtained. */
     bool write_protected;
@@ -97,11 +109,16 @@ struct FDCStruct{
 #define IS_CMD(data, cmd) \
     (((data) & CMD_ ## cmd ## _MASK) == CMD_ ## cmd)
 
-/* Assuming we get called every 250 cycles by FDCHDC_Poll, these are sensible delay counters for us to use: */
-#define READSPACING MAX(1,(ARMul_EmuRate/(250*31250))) /* 250kbps data rate */
-#define WRITESPACING MAX(1,(ARMul_EmuRate/(250*31250)))
-#define READADDRSTART MAX(50,(ARMul_EmuRate/(250*50))) /* At 300RPM, and 5 sectors per track, that's 1/25th of a second between each sector. But use a delay 1/50th since we'll usually be in the area between two sectors */
-#define SEEKDELAY MAX(1,(ARMul_EmuRate/(250*31250)))
+/* Delays, in emulated cycles, between successive steps of a command: */
+#define READSPACING MAX(250,(ARMul_EmuRate/31250)) /* 250kbps data rate */
+#define WRITESPACING MAX(250,(ARMul_EmuRate/31250))
+#define READADDRSTART MAX(12500,(ARMul_EmuRate/50)) /* At 300RPM, and 5 sectors per track, that's 1/25th of a second between each sector. But use a delay 1/50th since we'll usually be in the area between two sectors */
+#define SEEKDELAY MAX(250,(ARMul_EmuRate/31250))
+/* With CONFIG.bDiscTurbo, the next byte of a sector read or write is due this
+   long after the guest has taken the previous one, instead of READSPACING or
+   WRITESPACING after it was offered. Long enough for the FIQ handler to
+   return before the next DRQ. */
+#define TURBOSPACING 32
 
 #define BIT_BUSY 1
 #define BIT_DRQ (1<<1)
@@ -130,6 +147,10 @@ static const floppy_format avail_format[] = {
     { "DOS 720KB", 512, 9, 1, 80, 2 },
 };
 
+/* Biggest image that will be loaded; comfortably more than any of the
+ * formats above. */
+#define MAX_IMAGE_SIZE (1600*1024)
+
 /* A temporary method of getting the current drive's format. */
 #define CURRENT_FORMAT (FDC.drive[FDC.CurrentDisc].form)
 
@@ -143,8 +164,9 @@ static const floppy_format avail_format[] = {
 static void FDC_DoWriteChar(ARMul_State *state);
 static void FDC_DoReadChar(ARMul_State *state);
 static void FDC_DoReadAddressChar(ARMul_State *state);
+static const char *FDC_InsertImage(unsigned int drive, const char *image,
+                                   const char *overlay);
 
-static void efseek(FILE *fp, int32_t offset, int whence);
 
 /*--------------------------------------------------------------------------*/
 static void GenInterrupt(ARMul_State *state, const char *reason) {
@@ -157,17 +179,43 @@ static void GenInterrupt(ARMul_State *state, const char *reason) {
 
 
 /**
- * FDC_Regular
+ * FDC_CommandActive
  *
- * Called regulaly from the DispKbd poll loop.
+ * Check whether the current command still needs servicing by FDC_Event.
  *
- * @param state State of the emulator
+ * @returns true if the command is in progress
  */
-unsigned int FDC_Regular(ARMul_State *state)
+static bool FDC_CommandActive(void)
 {
-  int ActualTrack;
+  if (IS_CMD(FDC.LastCommand, READ_SECTOR)) {
+    /* Once the final byte has been supplied the command terminates when the
+     * data register is read, so there's nothing left for us to do. */
+    return FDC.BytesToGo != 0;
+  }
 
-  if (--FDC.DelayCount) return 0;
+  return IS_CMD(FDC.LastCommand, RESTORE) ||
+         IS_CMD(FDC.LastCommand, SEEK) ||
+         IS_CMD(FDC.LastCommand, STEP) ||
+         IS_CMD(FDC.LastCommand, STEP_IN) ||
+         IS_CMD(FDC.LastCommand, STEP_OUT) ||
+         IS_CMD(FDC.LastCommand, WRITE_SECTOR) ||
+         IS_CMD(FDC.LastCommand, READ_ADDR);
+}
+
+/**
+ * FDC_Event
+ *
+ * Event queue callback, only present while a command is in progress.
+ * Performs the next step of the command and then reschedules itself
+ * DelayCount cycles into the future, or removes itself if the command has
+ * finished.
+ *
+ * @param state   State of the emulator
+ * @param nowtime Current emulator time
+ */
+static void FDC_Event(ARMul_State *state,CycleCount nowtime)
+{
+  int ActualTrack;
 
     if (IS_CMD(FDC.LastCommand, RESTORE)) {
       FDC.StatusReg|=BIT_MOTORON | BIT_MOTORSPINUP | BIT_TR00;
@@ -213,7 +261,29 @@ unsigned int FDC_Regular(ARMul_State *state)
       FDC.DelayCount=FDC.DelayLatch;
     }
 
-    return 0;
+  if (FDC_CommandActive()) {
+    EventQ_RescheduleHead(state,nowtime+FDC.DelayCount,FDC_Event);
+  } else {
+    EventQ_Remove(state,0);
+  }
+}
+
+/**
+ * FDC_Schedule
+ *
+ * Arrange for FDC_Event to be called DelayCount cycles from now, inserting
+ * the event if the controller was previously idle.
+ *
+ * @param state State of the emulator
+ */
+static void FDC_Schedule(ARMul_State *state)
+{
+  int idx = EventQ_Find(state,FDC_Event);
+  if (idx >= 0) {
+    EventQ_Reschedule(state,ARMul_Time+FDC.DelayCount,FDC_Event,idx);
+  } else {
+    EventQ_Insert(state,ARMul_Time+FDC.DelayCount,FDC_Event);
+  }
 }
 
 /*--------------------------------------------------------------------------*/
@@ -429,6 +499,12 @@ ARMword FDC_Read(ARMul_State *state, ARMword offset) {
       /*DBG(("FDC_Read: Data reg=0x%x (BytesToGo=%d)\n",FDC.Data,FDC.BytesToGo)); */
       ClearDRQ(state);
       ReadDataRegSpecial(state);
+      if (CONFIG.bDiscTurbo && IS_CMD(FDC.LastCommand, READ_SECTOR) &&
+          FDC_CommandActive()) {
+        /* Offer the next byte straight away */
+        FDC.DelayCount=TURBOSPACING;
+        FDC_Schedule(state);
+      }
       return(FDC.Data);
       break;
   }
@@ -531,15 +607,16 @@ static void FDC_DoReadAddressChar(ARMul_State *state) {
 
 /*--------------------------------------------------------------------------*/
 static void FDC_DoReadChar(ARMul_State *state) {
+  floppy_drive *dr = FDC.drive + FDC.CurrentDisc;
   int data;
  
-  if (FDC.drive[FDC.CurrentDisc].fp == NULL) {
+  if (dr->fp == NULL) {
     data=42;
+  } else if (dr->pos < dr->size) {
+    data = dr->data[dr->pos++];
   } else {
-    data = fgetc(FDC.drive[FDC.CurrentDisc].fp);
-    if (data==EOF) {
-      DBG(("FDC_DoReadChar: got EOF\n"));
-    }
+    DBG(("FDC_DoReadChar: got EOF\n"));
+    data = EOF;
   }
   
   FDC.Data=data;
@@ -610,7 +687,7 @@ static void FDC_ReadAddressCommand(ARMul_State *state) {
   }
 
   if (FDC.drive[FDC.CurrentDisc].fp) {
-    efseek(FDC.drive[FDC.CurrentDisc].fp, offset, SEEK_SET);
+    FDC.drive[FDC.CurrentDisc].pos = offset;
 
     FDC.BytesToGo=6; /* 6 bytes of data from a Read address command */
     FDC_DoReadAddressChar(state);
@@ -641,13 +718,14 @@ static void FDC_ReadCommand(ARMul_State *state) {
 
   offset = SECTOR_LOC_TO_BYTE_OFF(FDC.Track, Side, FDC.Sector);
 
-  if (FDC.drive[FDC.CurrentDisc].fp) {
-    efseek(FDC.drive[FDC.CurrentDisc].fp, offset, SEEK_SET);
-  }
+  FDC.drive[FDC.CurrentDisc].pos = offset;
 
   FDC.BytesToGo = CURRENT_FORMAT->bytes_per_sector;
   /* FDC_DoReadChar(state); - let the regular code do this */
   FDC.DelayCount=FDC.DelayLatch=READSPACING;
+  if (CONFIG.bDiscTurbo) {
+    FDC.DelayCount=TURBOSPACING;
+  }
 } /* FDC_ReadCommand */
 
 /*--------------------------------------------------------------------------*/
@@ -703,11 +781,14 @@ static void FDC_WriteCommand(ARMul_State *state) {
   }
 
   offset = SECTOR_LOC_TO_BYTE_OFF(FDC.Track, Side, FDC.Sector);
-  efseek(FDC.drive[FDC.CurrentDisc].fp, offset, SEEK_SET);
+  FDC.drive[FDC.CurrentDisc].pos = offset;
 
   FDC.BytesToGo = CURRENT_FORMAT->bytes_per_sector + 1;
   /*GenDRQ(state); */ /* Please mister host - give me some data! - no that should happen on the regular!*/
   FDC.DelayCount=FDC.DelayLatch=WRITESPACING;
+  if (CONFIG.bDiscTurbo) {
+    FDC.DelayCount=TURBOSPACING;
+  }
 } /* FDC_WriteCommand */
 /*--------------------------------------------------------------------------*/
 static void FDC_RestoreCommand(ARMul_State *state) {
@@ -778,6 +859,10 @@ static void FDC_NewCommand(ARMul_State *state, ARMword data)
     /* warn_fdc("unknown FDC command received: %#x\n", data); */
   }
 
+  if (FDC_CommandActive()) {
+    FDC_Schedule(state);
+  }
+
   return;
 }
 
@@ -815,23 +900,24 @@ ARMword FDC_Write(ARMul_State *state, ARMword offset, ARMword data, bool bNw) {
       FDC.Data=data;
         if (IS_CMD(FDC.LastCommand, WRITE_SECTOR)) {
           if (FDC.BytesToGo) {
-            int err;
-
-            err = fputc(FDC.Data, FDC.drive[FDC.CurrentDisc].fp);
-            
-            if (err!=FDC.Data) {
-              warn_fdc("FDC_Write: fputc failed!! Data=%d err=%d ferror=%d: %s\n",FDC.Data,err,ferror(FDC.drive[FDC.CurrentDisc].fp),strerror(errno));
-              abort();
-            }
+            floppy_drive *dr = FDC.drive + FDC.CurrentDisc;
 
-            if (fflush(FDC.drive[FDC.CurrentDisc].fp)) {
-              warn_fdc("FDC_Write: fflush failed!!\n");
+            if (dr->pos < dr->size) {
+              dr->data[dr->pos++] = FDC.Data;
+              dr->dirty = true;
+            } else {
+              warn_fdc("FDC_Write: write past the end of the image on drive %d\n",FDC.CurrentDisc);
             }
             FDC.BytesToGo--;
           } else {
             warn_fdc("FDC_Write: Data register written for write sector when the whole sector has been received!\n");
           } /* Already full ? */
           ClearDRQ(state);
+          if (CONFIG.bDiscTurbo) {
+            /* Ask for the next byte straight away */
+            FDC.DelayCount=TURBOSPACING;
+            FDC_Schedule(state);
+          }
         }
       break;
   }
@@ -861,6 +947,9 @@ void FDC_Init(ARMul_State *state) {
 
   for (drive = 0; drive < 4; drive++) {
     FDC.drive[drive].fp = NULL;
+    FDC.drive[drive].data = NULL;
+    FDC.drive[drive].dirty = false;
+    FDC.drive[drive].overlay = NULL;
     FDC.drive[drive].form = avail_format;
   }
 
@@ -869,30 +958,127 @@ void FDC_Init(ARMul_State *state) {
     if (!FileName)
         continue;
 
-    FDC_InsertFloppy(drive, FileName);
+    FDC_InsertImage(drive, FileName, CONFIG.aFloppyOverlays[drive]);
 
   }
 
-  FDC.DelayCount=10000;
-  FDC.DelayLatch=10000;
+  FDC.DelayCount=0;
+  FDC.DelayLatch=0;
 } /* FDC_Init */
 
 /**
- * FDC_InsertFloppy
+ * FDC_Shutdown
  *
- * Associate disc image with drive.Drive must be empty
- * on startup or having been previously ejected.
+ * Called on program exit, writes back and closes the disc images
  *
- * @oaram drive Drive number to load image into [0-3]
- * @param image Filename of image to load
+ * @param state Emulator state
+ */
+void FDC_Shutdown(ARMul_State *state) {
+  int drive;
+
+  for (drive = 0; drive < 4; drive++) {
+    if (FDC.drive[drive].fp) {
+      FDC_EjectFloppy(drive);
+    }
+  }
+} /* FDC_Shutdown */
+
+/**
+ * FDC_SyncDrive
+ *
+ * Write the in-memory copy of a disc image back to its file, if it has
+ * been changed. Failures are reported to the user.
+ *
+ * @param drive Drive number [0-3]
+ * @returns true on success
+ */
+static bool FDC_SyncDrive(unsigned int drive)
+{
+  floppy_drive *dr = FDC.drive + drive;
+
+  if (!dr->fp || !dr->dirty) {
+    return true;
+  }
+
+  if (dr->overlay) {
+    /* Only the blocks that differ from the overlay's view of the image go
+     * into it, so that it stays small */
+    uint8_t block[OVERLAY_BLOCKSIZE];
+    uint32_t pos;
+    bool ok = true;
+
+    for (pos = 0; ok && pos < dr->size; pos += OVERLAY_BLOCKSIZE) {
+      uint32_t len = MIN(OVERLAY_BLOCKSIZE, dr->size - pos);
+      if (Overlay_Read(dr->overlay, pos, block, len) != len ||
+          (memcmp(block, dr->data + pos, len) &&
+           Overlay_Write(dr->overlay, pos, dr->data + pos, len) != len))
+      {
+        ok = false;
+      }
+    }
+    if (!ok || !Overlay_Flush(dr->overlay, true)) {
+      ControlPane_Warning("Couldn't write back the overlay for floppy drive %d\n",
+                          drive);
+      return false;
+    }
+
+    dr->dirty = false;
+    return true;
+  }
+
+  if (fseek(dr->fp, 0, SEEK_SET) ||
+      fwrite(dr->data, 1, dr->size, dr->fp) != dr->size ||
+      fflush(dr->fp))
+  {
+    ControlPane_Warning("Couldn't write back the disc image in floppy drive %d: %s\n",
+                        drive, strerror(errno));
+    return false;
+  }
+
+  dr->dirty = false;
+  return true;
+}
+
+/**
+ * FDC_Sync
+ *
+ * Write back any changed floppy disc images.
+ *
+ * @returns true if all the images were written back successfully
+ */
+bool FDC_Sync(void)
+{
+  bool ok = true;
+  unsigned int drive;
+
+  for (drive = 0; drive < 4; drive++) {
+    if (!FDC_SyncDrive(drive)) {
+      ok = false;
+    }
+  }
+
+  return ok;
+}
+
+/**
+ * FDC_InsertImage
+ *
+ * Associate disc image with drive, optionally through a copy-on-write
+ * overlay. Drive must be empty.
+ *
+ * @param drive   Drive number to load image into [0-3]
+ * @param image   Filename of image to load
+ * @param overlay Filename of the overlay to write changes to, which is
+ *                created if need be, or NULL to write to the image
  * @returns NULL on success or string of error message
  */
-const char *
-FDC_InsertFloppy(unsigned int drive, const char *image)
+static const char *
+FDC_InsertImage(unsigned int drive, const char *image, const char *overlay)
 {
   floppy_drive *dr;
   FILE *fp;
   long len;
+  Overlay *ov = NULL;
   const floppy_format *ff;
 
   assert(drive < sizeof FDC.drive / sizeof FDC.drive[0]);
@@ -908,7 +1094,15 @@ FDC_InsertFloppy(unsigned int drive, const char *image)
 
   assert(dr->fp == NULL);
 
-  if ((fp = fopen(image, "rb+")) != NULL) {
+  if (overlay) {
+    /* The image is only ever read, so that it can be shared */
+    if ((fp = fopen(image, "rb")) == NULL) {
+      warn_fdc("couldn't open disc image %s on drive %d\n",
+            image, drive);
+      return "couldn't open disc image";
+    }
+    dr->write_protected = false;
+  } else if ((fp = fopen(image, "rb+")) != NULL) {
     dr->write_protected = false;
   } else if ((fp = fopen(image, "rb")) != NULL) {
     dr->write_protected = true;
@@ -926,6 +1120,44 @@ FDC_InsertFloppy(unsigned int drive, const char *image)
     return "couldn't get length of disc image";
   }
 
+  if (len > MAX_IMAGE_SIZE) {
+    warn_fdc("disc image %s on drive %d is too big (%ld bytes)\n",
+            image, drive, len);
+    fclose(fp);
+    return "disc image too big";
+  }
+
+  if (overlay) {
+    const char *err;
+    ov = Overlay_Open(fp, overlay, true, &err);
+    if (!ov) {
+      warn_fdc("couldn't open overlay %s on drive %d: %s\n",
+            overlay, drive, err);
+      fclose(fp);
+      return "couldn't open overlay";
+    }
+  }
+
+  dr->data = malloc(len ? len : 1);
+  if (!dr->data ||
+      (ov ? Overlay_Read(ov, 0, dr->data, len) :
+            fread(dr->data, 1, len, fp)) != (size_t) len)
+  {
+    warn_fdc("couldn't read disc image %s on drive %d\n",
+            image, drive);
+    free(dr->data);
+    dr->data = NULL;
+    if (ov) {
+      Overlay_Close(ov);
+    }
+    fclose(fp);
+    return "couldn't read disc image";
+  }
+  dr->size = len;
+  dr->pos = 0;
+  dr->dirty = false;
+  dr->overlay = ov;
+
   dr->fp = fp;
   dr->form = avail_format;
   for (ff = avail_format; ff < avail_format +
@@ -945,6 +1177,22 @@ FDC_InsertFloppy(unsigned int drive, const char *image)
   return NULL;
 }
 
+/**
+ * FDC_InsertFloppy
+ *
+ * Associate disc image with drive.Drive must be empty
+ * on startup or having been previously ejected.
+ *
+ * @oaram drive Drive number to load image into [0-3]
+ * @param image Filename of image to load
+ * @returns NULL on success or string of error message
+ */
+const char *
+FDC_InsertFloppy(unsigned int drive, const char *image)
+{
+  return FDC_InsertImage(drive, image, NULL);
+}
+
 /**
  * FDC_EjectFloppy
  *
@@ -973,12 +1221,23 @@ FDC_EjectFloppy(unsigned int drive)
 
   assert(dr->fp);
 
+  /* Any failure has been reported; the changes are lost either way */
+  FDC_SyncDrive(drive);
+
+  if (dr->overlay) {
+    Overlay_Close(dr->overlay);
+    dr->overlay = NULL;
+  }
+
   if (fclose(dr->fp)) {
     warn_fdc("error closing floppy drive %d: %s\n",
             drive, strerror(errno));
   }
 
   dr->fp = NULL;
+  free(dr->data);
+  dr->data = NULL;
+  dr->dirty = false;
   /* The code assumes that the format of an, even empty, drive is
    * always known.  Rather than fix all that code, just pretend an
    * empty drive has a known format for the moment. */
@@ -1007,18 +1266,6 @@ FDC_IsFloppyInserted(unsigned int drive)
     return (dr->fp != NULL);
 }
 
-/* ------------------------------------------------------------------ */
-
-static void efseek(FILE *fp, int32_t offset, int whence)
-{
-  if (fseek(fp, offset, whence)) {
-    ControlPane_Error(1,"efseek(%p, %ld, %d) failed.\n", fp, (long int) offset,
-            whence);
-  }
-
-  return;
-}
-
 /**
  * FDC_SetLEDsChangeFunc
  *
@@ -14,6 +14,16 @@
  */
 void FDC_Init(ARMul_State *state);
 
+/**
+ * FDC_Shutdown
+ *
+ * Called on program exit, writes back any changed disc images and
+ * ejects them
+ *
+ * @param state Emulator state
+ */
+void FDC_Shutdown(ARMul_State *state);
+
 /**
  * FDC_Read
  *
@@ -62,7 +72,9 @@ void FDC_LatchBChange(ARMul_State *state);
  * FDC_InsertFloppy
  *
  * Associate disc image with drive.Drive must be empty
- * on startup or having been previously ejected.
+ * on startup or having been previously ejected. Overlays only apply to
+ * the images named in the config file; images inserted with this are
+ * written to directly.
  *
  * @param drive Drive number to load image into [0-3]
  * @param image Filename of image to load
@@ -92,13 +104,15 @@ const char *FDC_EjectFloppy(unsigned int drive);
 bool FDC_IsFloppyInserted(unsigned int drive);
 
 /**
- * FDC_Regular
+ * FDC_Sync
  *
- * Called regulaly from the DispKbd poll loop.
+ * Disc images are held in memory while inserted. Write back any that
+ * have been changed, reporting failures through ControlPane_Warning.
+ * Also happens on eject and on exit.
  *
- * @param state State of the emulator
+ * @returns true if everything was written back
  */
-unsigned FDC_Regular(ARMul_State *state);
+bool FDC_Sync(void);
 
 /**
  * FDC_SetLEDsChangeFunc
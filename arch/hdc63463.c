@@ -29,6 +29,24 @@
 #include "hdc63463.h"
 #include "ArcemConfig.h"
 #include "ControlPane.h"
+#include "overlay.h"
+
+/* Hosts where image files can be memory mapped */
+#if (defined(SYSTEM_X) || defined(SYSTEM_SDL) || defined(SYSTEM_macosx)) && !defined(_WIN32)
+#define HDC_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef HDC_THREAD
+#include <pthread.h>
+#endif
+
+#if defined(_WIN32)
+#include <io.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
 
 struct HDCReadDataStr {
   uint8_t US,PHA,LCAH,LCAL,LHA,LSA,SCNTH,SCNTL;
@@ -56,6 +74,19 @@ union HDCCommandDataStr {
 
 struct HDCStruct {
   FILE *HardFile[4];
+#ifdef HDC_MMAP
+  uint8_t *Map[4]; /* Mapping of the image, if CONFIG.bST506Mmap */
+  size_t MapSize[4];
+  bool MapDirty[4]; /* Written to since the last msync */
+#endif
+  Overlay *Overlays[4]; /* Copy-on-write overlay, if configured */
+  bool OverlayDirty[4]; /* Written to since the last Overlay_Flush */
+  /* Equivalent of the file pointer for images that aren't accessed through
+     HardFile's own one: mapped, overlaid and write-back cached images */
+  uint32_t ImagePos[4];
+#ifdef HDC_THREAD
+  bool WriteBack[4]; /* Writes go through the write-back cache */
+#endif
   int_least16_t LastCommand; /* -1=idle, 0xfff=command execution complete, other=command busy */
   uint8_t StatusReg;
   uint32_t Track[4];
@@ -116,9 +147,24 @@ struct HDCStruct HDC;
 
 #define PCVAL state->Reg[15]
 
-/* Increasing this didn't help! */
+/* Length of one DelayCount tick, in emulated cycles. Increasing this didn't help! */
 #define REGULARTIME 250
 
+/* With CONFIG.bDiscTurbo, the next step of a data command happens this many
+   cycles after the guest has emptied or filled a buffer, instead of after
+   DelayCount ticks */
+#define TURBOTIME 16
+
+/* Number of 256 byte blocks that the write-back cache can hold before writes
+   have to wait for the flush thread to catch up, and the most that the
+   thread writes in one go */
+#define WRITEBACKBLOCKS 4096
+#define WRITEBACKBATCH 64
+
+/* How long written pages of mapped images, or the bitmaps of overlays, may
+   stay dirty before being flushed, in emulated cycles (about a second) */
+#define SYNCTIME (ARMul_EmuRate)
+
 /*
 #define DEBUG_DMAWRITE
 #define DEBUG_INTS
@@ -173,35 +219,46 @@ static void Dump256Block(uint8_t *Data) {
 #endif
 
 /*---------------------------------------------------------------------------*/
-unsigned int HDC_Regular(ARMul_State *state) {
+/* Cycles until the next step of the current command                         */
+static CycleCount HDC_Delay(ARMul_State *state) {
+  if (CONFIG.bDiscTurbo)
+    return TURBOTIME;
+  return HDC.DelayCount*REGULARTIME;
+} /* HDC_Delay */
 
-  if (--HDC.DelayCount) {
-    return(0);
-  }
+/*---------------------------------------------------------------------------*/
+/* Event queue callback, only present while a data command is waiting for   */
+/* its next step. Steps which need the host to fill/empty a buffer first    */
+/* leave DelayCount at 0, and the event is reinserted via HDC_Schedule once  */
+/* the host has done so.                                                     */
+static void HDC_Event(ARMul_State *state,CycleCount nowtime) {
+  HDC.DelayCount=0;
 
   switch (HDC.LastCommand) {
     case 0x40: /* Read data */
       if (HDC.DBufPtrs[HDC.CommandData.ReadData.NextDestBuffer ^1]>255) {
         ReadData_DoNextBufferFull(state);
-        dbug_hdc("HDC_Regular: Read data buffer full case\n");
+        dbug_hdc("HDC_Event: Read data buffer full case\n");
       } else {
-        HDC.DelayCount=HDC.DelayLatch;
-        dbug_hdc("HDC_Regular: Read data buffer not full case\n");
+        dbug_hdc("HDC_Event: Read data buffer not full case\n");
       }
       break;
 
 
     case 0x48: /* Check data */
-      CheckData_DoNextBufferFull(state);
+      /* The guest isn't involved until the end, so in turbo mode the whole
+         command can be done now */
+      do {
+        CheckData_DoNextBufferFull(state);
+      } while (CONFIG.bDiscTurbo && (HDC.StatusReg & BIT_BUSY));
       break;
 
     case 0x87: /* Write data */
       if (HDC.DBufPtrs[HDC.CommandData.WriteData.CurrentSourceBuffer]>255) {
         WriteData_DoNextBufferFull(state);
-        dbug_hdc("HDC_Regular: Write data buffer full case\n");
+        dbug_hdc("HDC_Event: Write data buffer full case\n");
       } else {
-        HDC.DelayCount=HDC.DelayLatch;
-        dbug_hdc("HDC_Regular: Write data buffer not full case\n");
+        dbug_hdc("HDC_Event: Write data buffer not full case\n");
       }
       break;
 
@@ -209,10 +266,9 @@ unsigned int HDC_Regular(ARMul_State *state) {
       /* Pinching writedata control for this */
       if (HDC.DBufPtrs[HDC.CommandData.WriteData.CurrentSourceBuffer]>255) {
         CompareData_DoNextBufferFull(state);
-        dbug_hdc("HDC_Regular: Compare data buffer full case\n");
+        dbug_hdc("HDC_Event: Compare data buffer full case\n");
       } else {
-        HDC.DelayCount=HDC.DelayLatch;
-        dbug_hdc("HDC_Regular: Compare data buffer not full case\n");
+        dbug_hdc("HDC_Event: Compare data buffer not full case\n");
 
         /* I think in the case of no data we are supposed to no hit - but I'm not sure - Hmm */
         HDC.DelayLatch=1024;
@@ -233,20 +289,35 @@ unsigned int HDC_Regular(ARMul_State *state) {
     case 0xa3: /* Write format */
       if (HDC.DBufPtrs[HDC.CommandData.WriteFormat.CurrentSourceBuffer]>255) {
         WriteFormat_DoNextBufferFull(state);
-        dbug_hdc("HDC_Regulat: Write format buffer full case\n");
+        dbug_hdc("HDC_Event: Write format buffer full case\n");
       } else {
-        HDC.DelayCount=HDC.DelayLatch;
-        dbug_hdc("HDC_Regular: Write format buffer not full case\n");
+        dbug_hdc("HDC_Event: Write format buffer not full case\n");
       }
       break;
 
     default:
-      HDC.DelayCount=HDC.DelayLatch;
       break;
   } /* Command switch */
 
-  return(0);
-} /* HDC_Regular */
+  if ((HDC.StatusReg & BIT_BUSY) && (HDC.DelayCount>0)) {
+    EventQ_RescheduleHead(state,nowtime+HDC_Delay(state),HDC_Event);
+  } else {
+    EventQ_Remove(state,0);
+  }
+} /* HDC_Event */
+
+/*---------------------------------------------------------------------------*/
+/* Arrange for HDC_Event to be called DelayCount ticks from now              */
+static void HDC_Schedule(ARMul_State *state) {
+  CycleCount when=ARMul_Time+HDC_Delay(state);
+  int idx=EventQ_Find(state,HDC_Event);
+
+  if (idx>=0) {
+    EventQ_Reschedule(state,when,HDC_Event,idx);
+  } else {
+    EventQ_Insert(state,when,HDC_Event);
+  }
+} /* HDC_Schedule */
 
 /*---------------------------------------------------------------------------*/
 static void UpdateInterrupt(ARMul_State *state) {
@@ -312,6 +383,7 @@ static void HDC_DMAWrite(ARMul_State *state, int offset, int data) {
       HDC.DREQ=false;
       UpdateInterrupt(state);
       HDC.DelayLatch=HDC.DelayCount=5;
+      HDC_Schedule(state);
     } /* End of the buffer */
   } /* buffer not full at first */
 } /* HDC_DMAWrite */
@@ -350,6 +422,7 @@ static ARMword HDC_DMARead(ARMul_State *state, int offset) {
       HDC.DREQ=false;
       UpdateInterrupt(state);
       HDC.DelayLatch=HDC.DelayCount=5;
+      HDC_Schedule(state);
     }
     return(tmpres);
   } /* Within buffer */
@@ -433,6 +506,424 @@ static void Cause_Error(ARMul_State *state, int errcode) {
 
 /* Sets the pointer in the appropriate data file - returns 1 if it succeeded */
 
+/*---------------------------------------------------------------------------*/
+/* Ask the OS to put what's been written to an image file on disc           */
+static bool HDC_SyncFile(FILE *f) {
+#if defined(_WIN32)
+  return !_commit(_fileno(f));
+#elif defined(__unix__) || defined(__APPLE__)
+  return !fsync(fileno(f));
+#else
+  (void) f;
+  return true;
+#endif
+} /* HDC_SyncFile */
+
+/*---------------------------------------------------------------------------*/
+/* Start writing back any dirty mapped images and overlays. If 'wait' is    */
+/* set, don't return until it's all on disc, including what's been written  */
+/* to plain image files. Returns false if anything failed. Any write-back   */
+/* cache must already have been drained.                                    */
+static bool HDC_SyncImages(bool wait) {
+  bool ok = true;
+  int drive;
+
+  for (drive = 0; drive < 4; drive++) {
+    if (wait && HDC.HardFile[drive] && !HDC.Overlays[drive]
+#ifdef HDC_MMAP
+        && !HDC.Map[drive]
+#endif
+       ) {
+      if (!HDC_SyncFile(HDC.HardFile[drive])) {
+        warn_hdc("HDC: Couldn't write back image for drive %d: %s\n", drive, strerror(errno));
+        ok = false;
+      }
+    }
+#ifdef HDC_MMAP
+    if (HDC.Map[drive] && HDC.MapDirty[drive]) {
+      if (msync(HDC.Map[drive], HDC.MapSize[drive], wait ? MS_SYNC : MS_ASYNC)) {
+        warn_hdc("HDC: Couldn't write back image for drive %d: %s\n", drive, strerror(errno));
+        ok = false;
+      }
+      HDC.MapDirty[drive] = false;
+    }
+#endif
+    if (HDC.Overlays[drive] && HDC.OverlayDirty[drive]) {
+      if (!Overlay_Flush(HDC.Overlays[drive], wait)) {
+        warn_hdc("HDC: Couldn't write back overlay for drive %d\n", drive);
+        ok = false;
+      }
+      HDC.OverlayDirty[drive] = false;
+    }
+  }
+  return ok;
+} /* HDC_SyncImages */
+
+/*---------------------------------------------------------------------------*/
+/* Event queue callback, inserted SYNCTIME after a mapped image or overlay  */
+/* first gets dirty                                                          */
+static void HDC_SyncEvent(ARMul_State *state,CycleCount nowtime) {
+  HDC_SyncImages(false);
+  EventQ_Remove(state,0);
+} /* HDC_SyncEvent */
+
+/*---------------------------------------------------------------------------*/
+/* Make sure dirty data gets written back within SYNCTIME                    */
+static void HDC_ScheduleSync(ARMul_State *state) {
+  if (EventQ_Find(state, HDC_SyncEvent) < 0) {
+    EventQ_Insert(state, ARMul_Time + SYNCTIME, HDC_SyncEvent);
+  }
+} /* HDC_ScheduleSync */
+
+#ifdef HDC_MMAP
+/*---------------------------------------------------------------------------*/
+/* Map a drive's image, if it's big enough to hold every sector of the      */
+/* configured shape. Otherwise it stays as a stdio file.                    */
+static void HDC_MapImage(ARMul_State *state, int drive) {
+  const struct HDCshape *disc = CONFIG.aST506DiskShapes + drive;
+  uint64_t needed = ((uint64_t) disc->NCyls) * disc->NHeads * disc->NSectors * disc->RecordLength;
+  int fd = fileno(HDC.HardFile[drive]);
+  struct stat st;
+  void *map;
+
+  if (fstat(fd, &st)) {
+    warn_hdc("HDC: Couldn't stat image for drive %d: %s\n", drive, strerror(errno));
+    return;
+  }
+  if ((st.st_size <= 0) || ((uint64_t) st.st_size < needed) ||
+      ((uint64_t) st.st_size > SIZE_MAX)) {
+    warn_hdc("HDC: Image for drive %d doesn't match its shape, not mapping it\n", drive);
+    return;
+  }
+
+  map = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    warn_hdc("HDC: Couldn't map image for drive %d: %s\n", drive, strerror(errno));
+    return;
+  }
+  HDC.Map[drive] = map;
+  HDC.MapSize[drive] = (size_t) st.st_size;
+  HDC.ImagePos[drive] = 0;
+  HDC.MapDirty[drive] = false;
+} /* HDC_MapImage */
+#endif
+
+#ifdef HDC_THREAD
+/*---------------------------------------------------------------------------*/
+/* The write-back cache, used for plain image files when CONFIG.bST506WriteBack
+   is set, so that the emulator doesn't stall on slow storage.
+
+   Written blocks are queued in a ring, oldest first, and written out in that
+   order by a flush thread. If the ring is full, writers wait for the thread.
+   A hash of the queued blocks lets reads be patched up with anything that
+   hasn't reached the file yet; the newest copy of a block is always first on
+   its chain. Blocks from Tail to Tail+Writing are being written by the thread
+   and mustn't be changed, so a rewrite of one of those gets a new entry.
+
+   Lock protects the ring. FileLock protects the FILEs, whose file pointers
+   are shared with the thread; it's taken before Lock when both are needed. */
+#define WRITEBACKHASH 4096 /* Power of two */
+#define WRITEBACKNONE -1
+
+static struct {
+  bool Running;
+  bool Quit;
+  bool Failed; /* A write has failed since the last HDC_Sync */
+  pthread_t Thread;
+  pthread_mutex_t Lock;
+  pthread_mutex_t FileLock;
+  pthread_cond_t Work; /* Blocks have been queued, or Quit has been set */
+  pthread_cond_t Space; /* Blocks have been written */
+  uint32_t Head, Tail, Writing;
+  uint32_t Pos[WRITEBACKBLOCKS];
+  uint8_t Drive[WRITEBACKBLOCKS];
+  int_least16_t Next[WRITEBACKBLOCKS]; /* Hash chains */
+  int_least16_t Hash[WRITEBACKHASH];
+  uint8_t (*Data)[256];
+} WB;
+
+static unsigned int HDC_WriteBackHash(unsigned int drive, uint32_t pos) {
+  return ((pos >> 8) ^ (drive << 10)) & (WRITEBACKHASH-1);
+} /* HDC_WriteBackHash */
+
+/*---------------------------------------------------------------------------*/
+/* Find the newest queued copy of a block, or WRITEBACKNONE. Lock must be   */
+/* held.                                                                     */
+static int HDC_WriteBackFind(unsigned int drive, uint32_t pos) {
+  int idx = WB.Hash[HDC_WriteBackHash(drive, pos)];
+
+  while ((idx != WRITEBACKNONE) && ((WB.Pos[idx] != pos) || (WB.Drive[idx] != drive)))
+    idx = WB.Next[idx];
+
+  return idx;
+} /* HDC_WriteBackFind */
+
+/*---------------------------------------------------------------------------*/
+/* Flush thread; writes out the oldest blocks, merging runs of consecutive   */
+/* blocks into one write                                                     */
+static void *HDC_WriteBackThread(void *arg) {
+  pthread_mutex_lock(&WB.Lock);
+  for (;;) {
+    uint32_t tail, count;
+    unsigned int drive;
+    FILE *f;
+    bool ok;
+
+    while ((WB.Head == WB.Tail) && !WB.Quit)
+      pthread_cond_wait(&WB.Work, &WB.Lock);
+    if (WB.Head == WB.Tail)
+      break;
+
+    tail = WB.Tail % WRITEBACKBLOCKS;
+    drive = WB.Drive[tail];
+    count = 1;
+    while ((count < WRITEBACKBATCH) && (count < WB.Head - WB.Tail) &&
+           (tail + count < WRITEBACKBLOCKS) &&
+           (WB.Drive[tail + count] == drive) &&
+           (WB.Pos[tail + count] == WB.Pos[tail] + count * 256))
+      count++;
+    WB.Writing = count;
+    pthread_mutex_unlock(&WB.Lock);
+
+    pthread_mutex_lock(&WB.FileLock);
+    f = HDC.HardFile[drive];
+    ok = !fseek(f, (long) WB.Pos[tail], SEEK_SET) &&
+         (fwrite(WB.Data[tail], 256, count, f) == count) &&
+         !fflush(f);
+    pthread_mutex_unlock(&WB.FileLock);
+
+    if (!ok) {
+      warn_hdc("HDC: Couldn't write back image for drive %d: %s\n", drive, strerror(errno));
+    }
+
+    pthread_mutex_lock(&WB.Lock);
+    if (!ok)
+      WB.Failed = true;
+    while (count--) {
+      unsigned int idx = WB.Tail % WRITEBACKBLOCKS;
+      int_least16_t *link = &WB.Hash[HDC_WriteBackHash(WB.Drive[idx], WB.Pos[idx])];
+
+      while (*link != (int_least16_t) idx)
+        link = &WB.Next[*link];
+      *link = WB.Next[idx];
+      WB.Tail++;
+    }
+    WB.Writing = 0;
+    pthread_cond_broadcast(&WB.Space);
+  }
+  pthread_mutex_unlock(&WB.Lock);
+  return NULL;
+} /* HDC_WriteBackThread */
+
+/*---------------------------------------------------------------------------*/
+/* Wait until everything queued has been written to the files. Lock must be  */
+/* held.                                                                     */
+static void HDC_WriteBackDrain(void) {
+  while (WB.Head != WB.Tail)
+    pthread_cond_wait(&WB.Space, &WB.Lock);
+} /* HDC_WriteBackDrain */
+
+/*---------------------------------------------------------------------------*/
+/* Read from a cached image, including any blocks that are still queued      */
+static size_t HDC_WriteBackRead(unsigned int drive, uint8_t *buf, size_t len) {
+  uint32_t pos = HDC.ImagePos[drive];
+  uint32_t block;
+  FILE *f = HDC.HardFile[drive];
+
+  pthread_mutex_lock(&WB.FileLock);
+  if (fseek(f, (long) pos, SEEK_SET))
+    len = 0;
+  else
+    len = fread(buf, 1, len, f);
+
+  /* FileLock is still held, so nothing can reach the file between the read
+     and patching in the queued blocks */
+  pthread_mutex_lock(&WB.Lock);
+  for (block = pos & ~255u; block < pos + len; block += 256) {
+    int idx = HDC_WriteBackFind(drive, block);
+    if (idx != WRITEBACKNONE) {
+      uint32_t start = MAX(block, pos);
+      uint32_t end = MIN(block + 256, pos + (uint32_t) len);
+      memcpy(buf + (start - pos), WB.Data[idx] + (start - block), end - start);
+    }
+  }
+  pthread_mutex_unlock(&WB.Lock);
+  pthread_mutex_unlock(&WB.FileLock);
+
+  HDC.ImagePos[drive] = pos + len;
+  return len;
+} /* HDC_WriteBackRead */
+
+/*---------------------------------------------------------------------------*/
+/* Queue a write to a cached image. Anything that isn't whole 256 byte       */
+/* blocks is written directly, once the queue is empty.                      */
+static void HDC_WriteBackWrite(unsigned int drive, const uint8_t *buf, size_t len) {
+  uint32_t pos = HDC.ImagePos[drive];
+
+  pthread_mutex_lock(&WB.Lock);
+  if ((pos & 255) || (len & 255)) {
+    FILE *f = HDC.HardFile[drive];
+
+    HDC_WriteBackDrain();
+    pthread_mutex_unlock(&WB.Lock);
+    pthread_mutex_lock(&WB.FileLock);
+    if (fseek(f, (long) pos, SEEK_SET) || (fwrite(buf, 1, len, f) != len) || fflush(f)) {
+      warn_hdc("HDC: Couldn't write to image for drive %d: %s\n", drive, strerror(errno));
+    }
+    pthread_mutex_unlock(&WB.FileLock);
+    HDC.ImagePos[drive] = pos + len;
+    return;
+  }
+
+  HDC.ImagePos[drive] = pos + len;
+  for (; len; len -= 256, pos += 256, buf += 256) {
+    int idx = HDC_WriteBackFind(drive, pos);
+
+    if ((idx == WRITEBACKNONE) ||
+        ((uint32_t) (idx - WB.Tail) % WRITEBACKBLOCKS < WB.Writing)) {
+      unsigned int hash = HDC_WriteBackHash(drive, pos);
+
+      while (WB.Head - WB.Tail == WRITEBACKBLOCKS)
+        pthread_cond_wait(&WB.Space, &WB.Lock);
+
+      idx = WB.Head % WRITEBACKBLOCKS;
+      WB.Pos[idx] = pos;
+      WB.Drive[idx] = drive;
+      WB.Next[idx] = WB.Hash[hash];
+      WB.Hash[hash] = idx;
+      WB.Head++;
+      pthread_cond_signal(&WB.Work);
+    }
+    memcpy(WB.Data[idx], buf, 256);
+  }
+  pthread_mutex_unlock(&WB.Lock);
+} /* HDC_WriteBackWrite */
+
+/*---------------------------------------------------------------------------*/
+/* Start the flush thread. Returns false if the cache can't be used.         */
+static bool HDC_WriteBackStart(void) {
+  int i;
+
+  WB.Data = malloc(WRITEBACKBLOCKS * sizeof(*WB.Data));
+  if (!WB.Data)
+    return false;
+  for (i = 0; i < WRITEBACKHASH; i++)
+    WB.Hash[i] = WRITEBACKNONE;
+  WB.Head = WB.Tail = WB.Writing = 0;
+  WB.Quit = WB.Failed = false;
+
+  pthread_mutex_init(&WB.Lock, NULL);
+  pthread_mutex_init(&WB.FileLock, NULL);
+  pthread_cond_init(&WB.Work, NULL);
+  pthread_cond_init(&WB.Space, NULL);
+  WB.Running = !pthread_create(&WB.Thread, NULL, HDC_WriteBackThread, NULL);
+  if (!WB.Running) {
+    pthread_cond_destroy(&WB.Space);
+    pthread_cond_destroy(&WB.Work);
+    pthread_mutex_destroy(&WB.FileLock);
+    pthread_mutex_destroy(&WB.Lock);
+    free(WB.Data);
+    WB.Data = NULL;
+  }
+  return WB.Running;
+} /* HDC_WriteBackStart */
+
+/*---------------------------------------------------------------------------*/
+/* Write out everything that's queued and stop the flush thread              */
+static void HDC_WriteBackStop(void) {
+  if (!WB.Running)
+    return;
+
+  pthread_mutex_lock(&WB.Lock);
+  WB.Quit = true;
+  pthread_cond_signal(&WB.Work);
+  pthread_mutex_unlock(&WB.Lock);
+  pthread_join(WB.Thread, NULL);
+  WB.Running = false;
+
+  pthread_cond_destroy(&WB.Space);
+  pthread_cond_destroy(&WB.Work);
+  pthread_mutex_destroy(&WB.FileLock);
+  pthread_mutex_destroy(&WB.Lock);
+  free(WB.Data);
+  WB.Data = NULL;
+} /* HDC_WriteBackStop */
+#endif
+
+/*---------------------------------------------------------------------------*/
+/* Read from a drive's image at the position set by SetFilePtr, and advance */
+/* past it. Returns the number of bytes read, like fread.                   */
+static size_t HDC_ImageRead(unsigned int drive, uint8_t *buf, size_t len) {
+  if (HDC.Overlays[drive]) {
+    len = Overlay_Read(HDC.Overlays[drive], HDC.ImagePos[drive], buf, len);
+    HDC.ImagePos[drive] += len;
+    return len;
+  }
+#ifdef HDC_MMAP
+  if (HDC.Map[drive]) {
+    size_t pos = HDC.ImagePos[drive];
+
+    if (pos > HDC.MapSize[drive])
+      pos = HDC.MapSize[drive];
+    if (len > HDC.MapSize[drive] - pos)
+      len = HDC.MapSize[drive] - pos;
+    memcpy(buf, HDC.Map[drive] + pos, len);
+    HDC.ImagePos[drive] = pos + len;
+    return len;
+  }
+#endif
+#ifdef HDC_THREAD
+  if (HDC.WriteBack[drive])
+    return HDC_WriteBackRead(drive, buf, len);
+#endif
+  return fread(buf, 1, len, HDC.HardFile[drive]);
+} /* HDC_ImageRead */
+
+/*---------------------------------------------------------------------------*/
+/* Write to a drive's image at the position set by SetFilePtr, and advance  */
+/* past it                                                                   */
+static void HDC_ImageWrite(ARMul_State *state, unsigned int drive, const uint8_t *buf, size_t len) {
+  if (HDC.Overlays[drive]) {
+    size_t done = Overlay_Write(HDC.Overlays[drive], HDC.ImagePos[drive], buf, len);
+    if (done != len) {
+      warn_hdc("HDC: Couldn't write to overlay for drive %d\n", drive);
+    }
+    HDC.ImagePos[drive] += done;
+
+    if (!HDC.OverlayDirty[drive]) {
+      HDC.OverlayDirty[drive] = true;
+      HDC_ScheduleSync(state);
+    }
+    return;
+  }
+#ifdef HDC_MMAP
+  if (HDC.Map[drive]) {
+    size_t pos = HDC.ImagePos[drive];
+
+    if (pos > HDC.MapSize[drive])
+      pos = HDC.MapSize[drive];
+    if (len > HDC.MapSize[drive] - pos)
+      len = HDC.MapSize[drive] - pos;
+    memcpy(HDC.Map[drive] + pos, buf, len);
+    HDC.ImagePos[drive] = pos + len;
+
+    if (!HDC.MapDirty[drive]) {
+      HDC.MapDirty[drive] = true;
+      HDC_ScheduleSync(state);
+    }
+    return;
+  }
+#endif
+#ifdef HDC_THREAD
+  if (HDC.WriteBack[drive]) {
+    HDC_WriteBackWrite(drive, buf, len);
+    return;
+  }
+#endif
+  fwrite(buf, 1, len, HDC.HardFile[drive]);
+  fflush(HDC.HardFile[drive]);
+} /* HDC_ImageWrite */
+
 /* FIXME: should have just one definition of this. */
 #define DIM(a) ((sizeof (a)) / sizeof (a)[0])
 
@@ -484,6 +975,19 @@ static int SetFilePtr(ARMul_State *state, unsigned int drive, uint32_t head,
         return 0;
     }
 
+    if (HDC.Overlays[drive]) {
+        HDC.ImagePos[drive] = ptr;
+    } else
+#ifdef HDC_MMAP
+    if (HDC.Map[drive]) {
+        HDC.ImagePos[drive] = ptr;
+    } else
+#endif
+#ifdef HDC_THREAD
+    if (HDC.WriteBack[drive]) {
+        HDC.ImagePos[drive] = ptr;
+    } else
+#endif
     if (fseek(HDC.HardFile[drive], ptr, SEEK_SET)) {
         dbug("SetFilePtr: file seek failed: %s\n", strerror(errno));
         Cause_Error(state, ERR_NRY);
@@ -799,8 +1303,8 @@ static void ReadData_DoNextBufferFull(ARMul_State *state) {
     HDC.DREQ=true;
     UpdateInterrupt(state);
 
-    fread(HDC.DBufs[HDC.CommandData.ReadData.NextDestBuffer],
-          1,256,HDC.HardFile[HDC.CommandData.ReadData.US]);
+    HDC_ImageRead(HDC.CommandData.ReadData.US,
+                  HDC.DBufs[HDC.CommandData.ReadData.NextDestBuffer],256);
 
     dbug_hdc("HDC:ReadData_DoNextBufferFull - just got\n");
 #ifdef DEBUG_DATA
@@ -883,6 +1387,7 @@ static void ReadDataCommand(ARMul_State *state) {
 
   HDC.DelayCount=1;
   HDC.DelayLatch=5;
+  HDC_Schedule(state);
   HDC.DBufPtrs[0]=HDC.DBufPtrs[1]=256; /* So that the fill routine presumes the previous buffer has finished reading */
   HDC.StatusReg|=BIT_BUSY;
 } /* ReadDataCommand */
@@ -945,6 +1450,7 @@ static void WriteDataCommand(ARMul_State *state) {
 
   HDC.DelayCount=1;
   HDC.DelayLatch=5;
+  HDC_Schedule(state);
   HDC.DBufPtrs[0]=HDC.DBufPtrs[1]=0; /* So that the fill routine presumes the previous buffer has finished reading */
   HDC.StatusReg|=BIT_BUSY;
   HDC.DREQ=true; /* Request some data */
@@ -966,9 +1472,8 @@ static void WriteData_DoNextBufferFull(ARMul_State *state) {
 #endif
 
   /* Throw the data out to the disc */
-  fwrite(HDC.DBufs[HDC.CommandData.WriteData.CurrentSourceBuffer],1,256,
-         HDC.HardFile[HDC.CommandData.WriteData.US]);
-  fflush(HDC.HardFile[HDC.CommandData.WriteData.US]);
+  HDC_ImageWrite(state,HDC.CommandData.WriteData.US,
+                 HDC.DBufs[HDC.CommandData.WriteData.CurrentSourceBuffer],256);
 
   HDC.CommandData.WriteData.CurrentSourceBuffer^=1;
   HDC.CommandData.WriteData.BuffersLeft--;
@@ -1051,6 +1556,7 @@ static void CompareDataCommand(ARMul_State *state) {
 
   HDC.DelayCount=1;
   HDC.DelayLatch=5;
+  HDC_Schedule(state);
   HDC.DBufPtrs[0]=HDC.DBufPtrs[1]=0; /* So that the fill routine presumes the previous buffer has finished reading */
   HDC.StatusReg|=BIT_BUSY;
   HDC.DREQ=true; /* Request some data */
@@ -1071,7 +1577,7 @@ static void CompareData_DoNextBufferFull(ARMul_State *state) {
 #endif
 
   /* Throw the data out to the disc */
-  fread(tmpbuf,1,256,HDC.HardFile[HDC.CommandData.WriteData.US]);
+  HDC_ImageRead(HDC.CommandData.WriteData.US,tmpbuf,256);
 
   if (memcmp(tmpbuf,HDC.DBufs[HDC.CommandData.WriteData.CurrentSourceBuffer],256)!=0) {
     /* Oops - data didn't compare */
@@ -1138,7 +1644,7 @@ static void CheckData_DoNextBufferFull(ARMul_State *state) {
     size_t retval;
 
     /* Fill here up! */
-    if (retval=fread(tmpbuff,1,256,HDC.HardFile[HDC.CommandData.ReadData.US]),retval!=256)
+    if (retval=HDC_ImageRead(HDC.CommandData.ReadData.US,tmpbuff,256),retval!=256)
     {
       warn_hdc("HDC: CheckData_DoNextBufferFull - returning data err - retval=0x%x\n",retval);
       /* End of command */
@@ -1225,6 +1731,7 @@ static void CheckDataCommand(ARMul_State *state) {
 
   HDC.DelayCount=1;
   HDC.DelayLatch=5;
+  HDC_Schedule(state);
   HDC.StatusReg|=BIT_BUSY;
 } /* CheckDataCommand */
 
@@ -1284,6 +1791,7 @@ static void WriteFormatCommand(ARMul_State *state) {
 
   HDC.DelayCount=1;
   HDC.DelayLatch=5;
+  HDC_Schedule(state);
   HDC.DBufPtrs[0]=HDC.DBufPtrs[1]=0; /* Nothing received from the host yet */
   HDC.StatusReg|=BIT_BUSY;
   HDC.DREQ=true; /* Request some data */
@@ -1313,9 +1821,8 @@ static void WriteFormat_DoNextBufferFull(ARMul_State *state) {
     physical and logical cylinders to mismatch - if we are then we are in trouble! */
 
     /* Write the block to the hard disc image file */
-    fwrite(fillbuffer, 1, CONFIG.aST506DiskShapes[HDC.CommandData.WriteFormat.US].RecordLength,
-           HDC.HardFile[HDC.CommandData.WriteFormat.US]);
-    fflush(HDC.HardFile[HDC.CommandData.WriteFormat.US]);
+    HDC_ImageWrite(state, HDC.CommandData.WriteFormat.US, fillbuffer,
+                   CONFIG.aST506DiskShapes[HDC.CommandData.WriteFormat.US].RecordLength);
 
     ptr+=4; /* 4 bytes of values taken out of the buffer */
   } /* Sector loop */
@@ -1499,6 +2006,7 @@ void HDC_Write(ARMul_State *state, int offset, int data) {
             HDC.DREQ=false;
             UpdateInterrupt(state);
             HDC.DelayLatch=HDC.DelayCount=5;
+            HDC_Schedule(state);
           } /* End of the buffer */
         } /* buffer not full at first */
       } /* write data */
@@ -1579,6 +2087,7 @@ ARMword HDC_Read(ARMul_State *state, int offset) {
           HDC.DREQ=false;
           UpdateInterrupt(state);
           HDC.DelayLatch=HDC.DelayCount=5;
+          HDC_Schedule(state);
         }
         return(tmpres);
       } /* Within buffer */
@@ -1616,7 +2125,21 @@ void HDC_Init(ARMul_State *state) {
     if (!FileName)
       continue;
 
-    {
+    if (CONFIG.aST506Overlays[currentdrive]) {
+      /* The image is only ever read, so that it can be shared */
+      const char *err;
+
+      HDC.HardFile[currentdrive] = fopen(FileName, "rb");
+      if (HDC.HardFile[currentdrive]) {
+        HDC.Overlays[currentdrive] = Overlay_Open(HDC.HardFile[currentdrive],
+            CONFIG.aST506Overlays[currentdrive], true, &err);
+        if (!HDC.Overlays[currentdrive]) {
+          warn_hdc("HDC: Couldn't open overlay for drive %d: %s\n", currentdrive, err);
+          fclose(HDC.HardFile[currentdrive]);
+          HDC.HardFile[currentdrive] = NULL;
+        }
+      }
+    } else {
       FILE *isThere = fopen(FileName, "rb");
 
       if (isThere) {
@@ -1629,9 +2152,91 @@ void HDC_Init(ARMul_State *state) {
 
     if (!HDC.HardFile[currentdrive]) {
       warn_hdc("HDC: Couldn't open image for drive %d\n", currentdrive);
+      continue;
+    }
+
+    if (CONFIG.bST506Mmap && HDC.Overlays[currentdrive]) {
+      warn_hdc("HDC: Not mapping image for drive %d as it has an overlay\n", currentdrive);
+    } else if (CONFIG.bST506Mmap) {
+#ifdef HDC_MMAP
+      HDC_MapImage(state, currentdrive);
+#else
+      warn_hdc("HDC: Memory mapped images aren't supported on this platform\n");
+#endif
     }
   } /* Image opening */
 
+  if (CONFIG.bST506WriteBack) {
+#ifdef HDC_THREAD
+    /* Only plain image files need it */
+    bool wanted = false;
+
+    for (currentdrive = 0; currentdrive < 4; currentdrive++) {
+      HDC.WriteBack[currentdrive] = HDC.HardFile[currentdrive] &&
+#ifdef HDC_MMAP
+                                    !HDC.Map[currentdrive] &&
+#endif
+                                    !HDC.Overlays[currentdrive];
+      wanted = wanted || HDC.WriteBack[currentdrive];
+    }
+    if (wanted && !HDC_WriteBackStart()) {
+      warn_hdc("HDC: Couldn't start the write-back thread, writing images directly\n");
+      memset(HDC.WriteBack, 0, sizeof(HDC.WriteBack));
+    }
+#else
+    warn_hdc("HDC: Write-back caching isn't supported on this build\n");
+#endif
+  }
+
   HDC.DREQ=false;
 } /* HDC_Init */
 
+/*---------------------------------------------------------------------------*/
+bool HDC_Sync(void) {
+  bool ok = true;
+
+#ifdef HDC_THREAD
+  if (WB.Running) {
+    pthread_mutex_lock(&WB.Lock);
+    HDC_WriteBackDrain();
+    ok = !WB.Failed;
+    WB.Failed = false;
+    pthread_mutex_unlock(&WB.Lock);
+  }
+#endif
+
+  return HDC_SyncImages(true) && ok;
+} /* HDC_Sync */
+
+/*---------------------------------------------------------------------------*/
+void HDC_Shutdown(ARMul_State *state) {
+  int currentdrive;
+
+#ifdef HDC_THREAD
+  HDC_WriteBackStop();
+#endif
+
+  int idx = EventQ_Find(state, HDC_SyncEvent);
+  if (idx >= 0)
+    EventQ_Remove(state, idx);
+
+  HDC_SyncImages(true);
+
+  for (currentdrive = 0; currentdrive < 4; currentdrive++) {
+#ifdef HDC_MMAP
+    if (HDC.Map[currentdrive]) {
+      munmap(HDC.Map[currentdrive], HDC.MapSize[currentdrive]);
+      HDC.Map[currentdrive] = NULL;
+    }
+#endif
+    if (HDC.Overlays[currentdrive]) {
+      Overlay_Close(HDC.Overlays[currentdrive]);
+      HDC.Overlays[currentdrive] = NULL;
+    }
+    if (HDC.HardFile[currentdrive]) {
+      fclose(HDC.HardFile[currentdrive]);
+      HDC.HardFile[currentdrive] = NULL;
+    }
+  }
+} /* HDC_Shutdown */
+
@@ -21,6 +21,11 @@ ARMword HDC_Read(ARMul_State *state, int offset);
 
 void HDC_Init(ARMul_State *state);
 
-unsigned int HDC_Regular(ARMul_State *state);
+/* Write back and close the disc images */
+void HDC_Shutdown(ARMul_State *state);
+
+/* Wait for everything written so far to reach the disc image files; returns
+   false if any of it couldn't be written */
+bool HDC_Sync(void);
 
 #endif
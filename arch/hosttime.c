@@ -0,0 +1,91 @@
+/*
+  arch/hosttime.c
+
+  Implementations of the abstracted interface to the host's wall clock and
+  sleep functions
+
+  Part of Arcem released under the GNU GPL, see file COPYING
+  for details.
+*/
+
+#include <time.h>
+
+#include "hosttime.h"
+
+#if defined(_WIN32)
+
+#include <windows.h>
+#include <mmsystem.h>
+
+uint64_t HostTime_Now(void)
+{
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER now;
+  if (!freq.QuadPart) {
+    QueryPerformanceFrequency(&freq);
+  }
+  QueryPerformanceCounter(&now);
+  return (uint64_t) ((now.QuadPart / freq.QuadPart) * 1000000 +
+                     ((now.QuadPart % freq.QuadPart) * 1000000) / freq.QuadPart);
+}
+
+/* Sleep() only has the resolution of the system timer, which defaults to
+   ~15.6ms - far too coarse for the speed governor. Ask for 1ms resolution,
+   sleep for all but the last millisecond or so, and spin for the rest.
+   Windows drops the resolution request when the process exits. */
+bool HostTime_Sleep(uint32_t us)
+{
+  static bool period_set = false;
+  uint64_t due = HostTime_Now() + us;
+  if (!period_set) {
+    timeBeginPeriod(1);
+    period_set = true;
+  }
+  if (us > 1500) {
+    Sleep((us - 1500) / 1000);
+  }
+  while (HostTime_Now() < due) {
+    Sleep(0);
+  }
+  return true;
+}
+
+#elif defined(CLOCK_MONOTONIC)
+
+#include <errno.h>
+
+uint64_t HostTime_Now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+bool HostTime_Sleep(uint32_t us)
+{
+  struct timespec ts;
+  ts.tv_sec = us / 1000000;
+  ts.tv_nsec = (us % 1000000) * 1000;
+  while (nanosleep(&ts, &ts) && errno == EINTR) {
+    /* Keep sleeping for the remaining time */
+  }
+  return true;
+}
+
+#else
+
+/* On the remaining hosts (RISC OS, Amiga) clock() measures wall time, and
+   the emulator isn't in a position to sleep */
+
+uint64_t HostTime_Now(void)
+{
+  return (((uint64_t) clock()) * 1000000) / CLOCKS_PER_SEC;
+}
+
+bool HostTime_Sleep(uint32_t us)
+{
+  (void) us;
+  return false;
+}
+
+#endif
@@ -0,0 +1,34 @@
+/*
+  arch/hosttime.h
+
+  Abstracted interface to the host's wall clock and sleep functions
+
+  Part of Arcem released under the GNU GPL, see file COPYING
+  for details.
+*/
+#ifndef HOSTTIME_H
+#define HOSTTIME_H
+
+#include "../c99.h"
+
+/**
+ * HostTime_Now
+ *
+ * Read a monotonic wall clock. Unlike clock(), this keeps ticking while
+ * the process is sleeping or descheduled.
+ *
+ * @returns Current time in microseconds, relative to an arbitrary base
+ */
+uint64_t HostTime_Now(void);
+
+/**
+ * HostTime_Sleep
+ *
+ * Sleep for approximately the given time.
+ *
+ * @param us Number of microseconds to sleep for
+ * @returns false if the host doesn't support sleeping
+ */
+bool HostTime_Sleep(uint32_t us);
+
+#endif
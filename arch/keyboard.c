@@ -38,6 +38,17 @@ static const char *const key_names[] = {
 /* Archimedes UK keyboard id. */
 #define PROTO_KBID_UK 0x81
 
+/* Host input is checked for at a fixed real-time rate, so that input
+ * latency doesn't depend on emulation speed.  640Hz matches the old fixed
+ * interval of 12500 cycles at 8MHz.  The check is just a readiness test;
+ * the host's event queue is only drained when it has something in it. */
+#define KBD_POLL_RATE 640
+#define KBD_POLL_INTERVAL MAX(1,ARMul_EmuRate/KBD_POLL_RATE)
+
+/* Time taken for a byte to cross the 31250 baud serial link (10 bits
+ * including start and stop bits). */
+#define KBD_BYTE_TIME MAX(1,ARMul_EmuRate/3125)
+
 /* ------------------------------------------------------------------ */
 
 void keyboard_key_changed(struct arch_keyboard *kb, arch_key_id kid,
@@ -355,20 +366,55 @@ void Kbd_CodeFromHost(ARMul_State *state, uint8_t FromHost)
   return;
 }
 
-void Keyboard_Poll(ARMul_State *state,CycleCount nowtime)
+/* True if there's something waiting to be sent to the host. */
+
+static bool Kbd_HaveDataToSend(ARMul_State *state)
+{
+  if (KBD.HostCommand) {
+    return true;
+  }
+  if (KBD.KeyScanEnable && KBD.BuffReadPos != KBD.BuffWritePos) {
+    return true;
+  }
+  return KBD.MouseTransEnable && (KBD.MouseXCount | KBD.MouseYCount);
+}
+
+/* Event which fires once the keyboard has received a byte written to
+ * the serial tx register on the IOC.  Only present in the event queue
+ * while a byte is in flight. */
+
+static void Keyboard_Serial(ARMul_State *state,CycleCount nowtime)
 {
   int KbdSerialVal;
-  EventQ_RescheduleHead(state,nowtime+12500,Keyboard_Poll); /* TODO - Should probably be realtime */
-  /* Call host-specific routine */
-  Kbd_PollHostKbd(state);
-  /* Keyboard check */
+  UNUSED_VAR(nowtime);
+  EventQ_Remove(state,0);
   KbdSerialVal = IOC_ReadKbdTx(state);
   if (KbdSerialVal != -1) {
     Kbd_CodeFromHost(state, (uint8_t) KbdSerialVal);
-  } else {
+  }
+}
+
+void Kbd_TxDataWritten(ARMul_State *state)
+{
+  if (EventQ_Find(state,Keyboard_Serial) < 0) {
+    EventQ_Insert(state,ARMul_Time+KBD_BYTE_TIME,Keyboard_Serial);
+  }
+}
+
+void Keyboard_Poll(ARMul_State *state,CycleCount nowtime)
+{
+  EventQ_RescheduleHead(state,nowtime+KBD_POLL_INTERVAL,Keyboard_Poll);
+  /* Call host-specific routine, if it has anything to deliver */
+  if (Kbd_HostInputPending(state)) {
+    Kbd_PollHostKbd(state);
+  }
+  /* The state machine is only woken if there's input waiting and the
+   * host isn't in the middle of talking to us; exchanges in progress are
+   * driven by Keyboard_Serial. */
+  if (EventQ_Find(state,Keyboard_Serial) < 0) {
     if (KBD.TimerIntHasHappened > 2) {
       KBD.TimerIntHasHappened = 0;
-      if (KBD.KbdState == KbdState_Idle) {
+      if (KBD.KbdState == KbdState_Idle && Kbd_HaveDataToSend(state)) {
         Kbd_StartToHost(state);
       }
     }
@@ -395,6 +441,6 @@ void Kbd_Init(ARMul_State *state)
   KBD.Leds                = 0;
   KBD.leds_changed        = NULL;
 
-  EventQ_Insert(state,ARMul_Time+12500,Keyboard_Poll);
+  EventQ_Insert(state,ARMul_Time+KBD_POLL_INTERVAL,Keyboard_Poll);
 }
 
@@ -199,11 +199,19 @@ void Kbd_Init(ARMul_State *state);
 void Kbd_StartToHost(ARMul_State *state);
 void Kbd_CodeFromHost(ARMul_State *state, uint8_t FromHost);
 
+/* Called by the IOC when a byte is written to the serial tx register */
+void Kbd_TxDataWritten(ARMul_State *state);
+
 /* Internal function; just exposed so the profiling code can mess with it */
 void Keyboard_Poll(ARMul_State *state,CycleCount nowtime);
 
 /* Frontend must implement this */
 int Kbd_PollHostKbd(ARMul_State *state);
 
+/* Frontend must implement this too. Returns true if Kbd_PollHostKbd has
+ * anything to do, so that the host's event queue is only drained when
+ * there is input waiting. Frontends that can't tell should return true. */
+bool Kbd_HostInputPending(ARMul_State *state);
+
 #endif
 
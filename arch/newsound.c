@@ -20,16 +20,29 @@
   should run correctly.
 */
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "../armdefs.h"
 #include "arch/armarc.h"
+#include "arch/ArcemConfig.h"
 #include "arch/ControlPane.h"
 #include "arch/dbugsys.h"
 #include "arch/sound.h"
+#include "arch/capture.h"
 #include "displaydev.h"
 
+#ifdef SOUND_SUPPORT
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define SOUND_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#define SOUND_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
 #define MAX_BATCH_SIZE 1024
 
 int Sound_BatchSize = 1; /* How many 16*2 sample batches to try to do at once */
@@ -39,17 +52,67 @@ CycleDiff Sound_FudgeRate = 0;
 
 #ifdef SOUND_SUPPORT
 uint32_t Sound_HostRate; /* Rate of host sound system, in 1/1024 Hz */
+int32_t Sound_HostFill = -1;
+int32_t Sound_HostCapacity = 0;
+uint32_t Sound_HostUnderruns = 0;
+uint32_t Sound_HostOverruns = 0;
 
 
 static SoundData soundTable[256];
 static ARMword channelAmount[8][2];
+static SoundData soundPanTable[8][256][2]; /* soundTable scaled by channelAmount */
 
-static SoundData soundBuffer[16*2*MAX_BATCH_SIZE];
+/* The vector mixer reads whole blocks of 8 stereo pairs, so may look up to 8
+   pairs past the end of the buffered data. Those samples are given zero
+   weight, but must be readable. */
+#define SOUND_PADDING (8*2)
+
+/* soundBuffer is a ring of SOUND_RING stereo pairs, followed by a copy of the
+   first SOUND_MIRROR pairs, so that the mixer can always read the samples for
+   one destination sample as a single block, even across the end of the ring.
+   SOUND_RING must be a power of two. */
+#define SOUND_RING (16*MAX_BATCH_SIZE)
+#define SOUND_MIRROR 256
+
+static SoundData soundBuffer[(SOUND_RING+SOUND_MIRROR)*2];
+static uint32_t soundBufferStart=0; /* Ring offset of 1st buffered pair */
 static uint32_t soundBufferAmt=0; /* Number of stereo pairs buffered */
 #define TIMESHIFT 9 /* Bigger values make the mixing more accurate. But 9 is the biggest value possible to avoid overflows in the 32bit accumulators. */
 static uint32_t soundTime=0; /* Offset into 1st sample pair of buffer */
 static uint32_t soundTimeStep; /* How many source samples per dest sample, fixed point with TIMESHIFT fraction bits */
 static uint32_t soundScale; /* Output scale factor, 16.16 fixed point */
+static uint32_t soundWindow=10; /* Source pairs the mixer needs from the current position */
+
+/*
+
+  Latency controller
+
+  For hosts which report how much sound they have queued (Sound_HostFill and
+  Sound_HostCapacity), the sound DMA interval is adjusted to hold the queue at
+  the target latency. Sound_DMAEvent stretches the interval by soundAdjust
+  (in 1/65536ths), which comes from a PI controller acting on the fill error
+  as a fraction of the target:
+
+  - The proportional term reacts to the current error.
+  - The integral term, accumulated over host time (measured in the samples
+    produced), takes out any steady difference between the emulated and host
+    sample clocks.
+
+  Both terms and their sum are limited to SOUND_ADJUST_MAX, so the controller
+  can't wind up while the emulator is unable to keep up, or the host is
+  refusing data.
+
+*/
+
+#define SOUND_LATENCY_DEFAULT 100 /* Target latency if not configured, ms */
+#define SOUND_ADJUST_MAX (65536/20) /* Max adjustment, +/-5% */
+#define SOUND_KP_SHIFT 5 /* Proportional gain: 1/32 */
+#define SOUND_KI_SHIFT 6 /* Integral gain: 1/64 per second */
+
+static uint32_t soundLatency = SOUND_LATENCY_DEFAULT; /* Target latency, ms */
+static int32_t soundTarget = 0; /* Target fill, stereo pairs */
+static int32_t soundAdjust = 0; /* DMA interval adjustment, 1/65536ths */
+static int32_t soundIntegral = 0; /* Integral term, 1/65536ths */
 #endif
 
 void Sound_UpdateDMARate(ARMul_State *state)
@@ -193,6 +256,16 @@ void Sound_StereoUpdated(ARMul_State *state)
       default: channelAmount[i][0] = channelAmount[i][1] = 0;
     }
   }
+
+  /* Rebuild the panned lookup tables used by Sound_Log2Lin */
+  for (i = 0; i < 8; i++) {
+    int j;
+    for (j = 0; j < 256; j++) {
+      SoundData val = soundTable[j];
+      soundPanTable[i][j][0] = (channelAmount[i][0] * val)>>16;
+      soundPanTable[i][j][1] = (channelAmount[i][1] * val)>>16;
+    }
+  }
 }
 
 void Sound_SoundFreqUpdated(ARMul_State *state)
@@ -202,52 +275,44 @@ void Sound_SoundFreqUpdated(ARMul_State *state)
 
 static void Sound_Log2Lin(const uint8_t *in,SoundData *out,int32_t avail)
 {
-  /* Convert the source log data to linear. Note that no mixing is done here. */
+  /* Convert the source log data to linear. Note that no mixing is done here.
+     The stereo panning multiplies are folded into soundPanTable, so each
+     channel byte is a single lookup of a stereo pair. */
+#ifdef HOST_BIGENDIAN
+  /* Byte accesses must be endian swapped.
+     This makes sure the stereo positions are correct, and that the samples
+     come through in the right order for the mixing algorithm to work. */
+  const int swap = 3;
+#else
+  const int swap = 0;
+#endif
   avail *= 2;
   while(avail--)
   {
-#ifdef HOST_BIGENDIAN
-    /* Byte accesses must be endian swapped.
-       This makes sure the stereo positions are correct, and that the samples
-       come through in the right order for the mixing algorithm to work. */
-    SoundData val0 = soundTable[in[3]];
-    SoundData val1 = soundTable[in[2]];
-    SoundData val2 = soundTable[in[1]];
-    SoundData val3 = soundTable[in[0]];
-    *out++ = (channelAmount[0][0] * val0)>>16;
-    *out++ = (channelAmount[0][1] * val0)>>16;
-    *out++ = (channelAmount[1][0] * val1)>>16;
-    *out++ = (channelAmount[1][1] * val1)>>16;
-    *out++ = (channelAmount[2][0] * val2)>>16;
-    *out++ = (channelAmount[2][1] * val2)>>16;
-    *out++ = (channelAmount[3][0] * val3)>>16;
-    *out++ = (channelAmount[3][1] * val3)>>16;
-    val0 = soundTable[in[7]];
-    val1 = soundTable[in[6]];
-    val2 = soundTable[in[5]];
-    val3 = soundTable[in[4]];
-    *out++ = (channelAmount[4][0] * val0)>>16;
-    *out++ = (channelAmount[4][1] * val0)>>16;
-    *out++ = (channelAmount[5][0] * val1)>>16;
-    *out++ = (channelAmount[5][1] * val1)>>16;
-    *out++ = (channelAmount[6][0] * val2)>>16;
-    *out++ = (channelAmount[6][1] * val2)>>16;
-    *out++ = (channelAmount[7][0] * val3)>>16;
-    *out++ = (channelAmount[7][1] * val3)>>16;
-    in += 8;
-#else
     int i;
     for(i=0;i<8;i++)
     {
-      SoundData val = soundTable[*in++];
-      *out++ = (channelAmount[i][0] * val)>>16;
-      *out++ = (channelAmount[i][1] * val)>>16;
+      memcpy(out,soundPanTable[i][in[i^swap]],sizeof(SoundData)*2);
+      out += 2;
     }
-#endif
+    in += 8;
   }
 }
 
-static int32_t Sound_Mix(SoundData *out,int32_t destavail)
+/**
+ * Sound_MixFunc
+ *
+ * Mixer kernel. Generates destination samples until either the source data
+ * or the destination space runs out, and returns the remaining destination
+ * space. The source pointer, source count and time offset are updated in
+ * place; the source count is biased as described in Sound_Mix.
+ */
+typedef int32_t (*Sound_MixFunc)(SoundData *out,int32_t destavail,
+                                 const SoundData **inp,int32_t *srcavailp,
+                                 uint32_t *timep,int32_t timestep,
+                                 uint32_t scale);
+
+static int32_t Sound_MixScalar(SoundData *out,int32_t destavail,const SoundData **inp,int32_t *srcavailp,uint32_t *timep,int32_t timestep,uint32_t scale)
 {
   /* This mixing function performs two roles:
   
@@ -304,16 +369,9 @@ static int32_t Sound_Mix(SoundData *out,int32_t destavail)
      ticks (shifted by TIMESHIFT). 
   */
      
-  const SoundData *in = soundBuffer;
-  int32_t srcavail = soundBufferAmt;
-  uint32_t time = soundTime;
-  const int32_t timestep = soundTimeStep;
-  const uint32_t scale = soundScale;
-
-  /* We can only generate a destination sample if all the required source
-     samples are present. Bias the source sample count by a suitable amount
-     so we don't have to worry about this in the main loop. */
-  srcavail -= 10+(timestep>>TIMESHIFT);
+  const SoundData *in = *inp;
+  int32_t srcavail = *srcavailp;
+  uint32_t time = *timep;
 
   if(timestep > 8<<TIMESHIFT)
   {
@@ -414,9 +472,637 @@ static int32_t Sound_Mix(SoundData *out,int32_t destavail)
     }
   }
 
+  *inp = in;
+  *srcavailp = srcavail;
+  *timep = time;
+
+  /* Return remaining output space */
+  return destavail;
+}
+
+#if defined(SOUND_SSE2) || defined(SOUND_NEON)
+
+/*
+
+  Vectorised mixer
+
+  Rather than walking along the sampling window, the vector mixer works out
+  the contribution of each source sample directly. Source sample k covers
+  source ticks (k-7) to (k+1) (shifted by TIMESHIFT; see the diagram above),
+  so for a window running from 'time' to 'end' its weight is the overlap:
+
+    max(0, min((k+1)<<TIMESHIFT, end) - max((k-7)<<TIMESHIFT, time))
+
+  For each destination sample the first 8 source samples are weighted, any
+  samples that lie entirely within the window are summed unweighted (only
+  happens for big downmix factors), and then the 8 samples starting at the
+  first one cropped by the end of the window are weighted. Samples that lie
+  entirely within the window have a weight of exactly 8<<TIMESHIFT, so it
+  makes no difference to the result which of the two sums they end up in,
+  and the output is identical to Sound_MixScalar.
+
+  The weights never exceed 8<<TIMESHIFT, so fit in 16 bits, allowing the use
+  of 16x16->32 multiply-accumulates: pmaddwd on SSE2, smlal on NEON.
+
+*/
+
+#define SOUND_TICKS(n) ((n)*(1<<TIMESHIFT))
+
+/* Clamp a window edge (relative to the first sample of a block of 8) to a
+   range that fits in 16 bits, without changing any of the block's weights */
+static inline int32_t Sound_WindowEdge(int32_t x)
+{
+  if(x < SOUND_TICKS(-8))
+    return SOUND_TICKS(-8);
+  if(x > SOUND_TICKS(16))
+    return SOUND_TICKS(16);
+  return x;
+}
+
+#ifdef SOUND_SSE2
+
+/* L0 R0 L1 R1 -> L0 L1 R0 R1, so pmaddwd sums adjacent samples of the same
+   channel */
+static inline __m128i Sound_LoadSSE2(const SoundData *in)
+{
+  __m128i x = _mm_loadu_si128((const __m128i *) in);
+  return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x,_MM_SHUFFLE(3,1,2,0)),_MM_SHUFFLE(3,1,2,0));
+}
+
+/* Weighted sum of 8 stereo pairs. Returns left and right partial sums in
+   alternate lanes. */
+static inline __m128i Sound_WindowSSE2(const SoundData *in,int32_t start,int32_t end)
+{
+  /* Sample start times, in the lane order produced by Sound_LoadSSE2 */
+  const __m128i lo0 = _mm_setr_epi16(SOUND_TICKS(-7),SOUND_TICKS(-6),SOUND_TICKS(-7),SOUND_TICKS(-6),SOUND_TICKS(-5),SOUND_TICKS(-4),SOUND_TICKS(-5),SOUND_TICKS(-4));
+  const __m128i lo1 = _mm_setr_epi16(SOUND_TICKS(-3),SOUND_TICKS(-2),SOUND_TICKS(-3),SOUND_TICKS(-2),SOUND_TICKS(-1),SOUND_TICKS(0),SOUND_TICKS(-1),SOUND_TICKS(0));
+  const __m128i len = _mm_set1_epi16(SOUND_TICKS(8));
+  const __m128i zero = _mm_setzero_si128();
+  __m128i s = _mm_set1_epi16((short) start);
+  __m128i e = _mm_set1_epi16((short) end);
+  __m128i w0 = _mm_max_epi16(_mm_sub_epi16(_mm_min_epi16(_mm_add_epi16(lo0,len),e),_mm_max_epi16(lo0,s)),zero);
+  __m128i w1 = _mm_max_epi16(_mm_sub_epi16(_mm_min_epi16(_mm_add_epi16(lo1,len),e),_mm_max_epi16(lo1,s)),zero);
+  return _mm_add_epi32(_mm_madd_epi16(Sound_LoadSSE2(in),w0),_mm_madd_epi16(Sound_LoadSSE2(in+8),w1));
+}
+
+static int32_t Sound_MixSSE2(SoundData *out,int32_t destavail,const SoundData **inp,int32_t *srcavailp,uint32_t *timep,int32_t timestep,uint32_t scale)
+{
+  const __m128i one = _mm_set1_epi16(1);
+  const SoundData *in = *inp;
+  int32_t srcavail = *srcavailp;
+  uint32_t time = *timep;
+
+  while((srcavail > 0) && (destavail > 0))
+  {
+    int32_t end = time+timestep;
+    int32_t first = end>>TIMESHIFT; /* First sample cropped by the end */
+    int32_t lacc,racc,lacc2,racc2,amt,k;
+    __m128i acc,acc2;
+    if(first < 8)
+      first = 8;
+    acc = _mm_add_epi32(Sound_WindowSSE2(in,time,Sound_WindowEdge(end)),
+                        Sound_WindowSSE2(in+first*2,Sound_WindowEdge(time-SOUND_TICKS(first)),Sound_WindowEdge(end-SOUND_TICKS(first))));
+    /* Unweighted middle */
+    acc2 = _mm_setzero_si128();
+    for(k=8;k+4<=first;k+=4)
+      acc2 = _mm_add_epi32(acc2,_mm_madd_epi16(Sound_LoadSSE2(in+k*2),one));
+    acc = _mm_add_epi32(acc,_mm_shuffle_epi32(acc,_MM_SHUFFLE(1,0,3,2)));
+    acc2 = _mm_add_epi32(acc2,_mm_shuffle_epi32(acc2,_MM_SHUFFLE(1,0,3,2)));
+    lacc = _mm_cvtsi128_si32(acc);
+    racc = _mm_cvtsi128_si32(_mm_shuffle_epi32(acc,_MM_SHUFFLE(1,1,1,1)));
+    lacc2 = _mm_cvtsi128_si32(acc2);
+    racc2 = _mm_cvtsi128_si32(_mm_shuffle_epi32(acc2,_MM_SHUFFLE(1,1,1,1)));
+    for(;k<first;k++)
+    {
+      lacc2 += in[k*2];
+      racc2 += in[k*2+1];
+    }
+    lacc2 += lacc>>(3+TIMESHIFT);
+    racc2 += racc>>(3+TIMESHIFT);
+    *out++ = (lacc2*scale)>>16;
+    *out++ = (racc2*scale)>>16;
+    destavail--;
+    time += timestep;
+    amt = time>>TIMESHIFT;
+    time &= (1<<TIMESHIFT)-1;
+    in += amt*2;
+    srcavail -= amt;
+  }
+
+  *inp = in;
+  *srcavailp = srcavail;
+  *timep = time;
+  return destavail;
+}
+
+#define Sound_MixVector Sound_MixSSE2
+
+#endif /* SOUND_SSE2 */
+
+#ifdef SOUND_NEON
+
+/* Weighted sum of 8 stereo pairs, accumulated into separate left and right
+   vectors */
+static inline void Sound_WindowNEON(const SoundData *in,int32_t start,int32_t end,int32x4_t *lacc,int32x4_t *racc)
+{
+  static const int16_t lo[8] = {SOUND_TICKS(-7),SOUND_TICKS(-6),SOUND_TICKS(-5),SOUND_TICKS(-4),SOUND_TICKS(-3),SOUND_TICKS(-2),SOUND_TICKS(-1),SOUND_TICKS(0)};
+  int16x8_t lov = vld1q_s16(lo);
+  int16x8_t hiv = vaddq_s16(lov,vdupq_n_s16(SOUND_TICKS(8)));
+  int16x8_t w = vmaxq_s16(vsubq_s16(vminq_s16(hiv,vdupq_n_s16((int16_t) end)),vmaxq_s16(lov,vdupq_n_s16((int16_t) start))),vdupq_n_s16(0));
+  int16x8x2_t x = vld2q_s16(in);
+  *lacc = vmlal_high_s16(vmlal_s16(*lacc,vget_low_s16(x.val[0]),vget_low_s16(w)),x.val[0],w);
+  *racc = vmlal_high_s16(vmlal_s16(*racc,vget_low_s16(x.val[1]),vget_low_s16(w)),x.val[1],w);
+}
+
+static int32_t Sound_MixNEON(SoundData *out,int32_t destavail,const SoundData **inp,int32_t *srcavailp,uint32_t *timep,int32_t timestep,uint32_t scale)
+{
+  const SoundData *in = *inp;
+  int32_t srcavail = *srcavailp;
+  uint32_t time = *timep;
+
+  while((srcavail > 0) && (destavail > 0))
+  {
+    int32_t end = time+timestep;
+    int32_t first = end>>TIMESHIFT; /* First sample cropped by the end */
+    int32_t lacc,racc,lacc2,racc2,amt,k;
+    int32x4_t lv = vdupq_n_s32(0), rv = vdupq_n_s32(0);
+    int32x4_t lv2 = vdupq_n_s32(0), rv2 = vdupq_n_s32(0);
+    if(first < 8)
+      first = 8;
+    Sound_WindowNEON(in,time,Sound_WindowEdge(end),&lv,&rv);
+    Sound_WindowNEON(in+first*2,Sound_WindowEdge(time-SOUND_TICKS(first)),Sound_WindowEdge(end-SOUND_TICKS(first)),&lv,&rv);
+    /* Unweighted middle */
+    for(k=8;k+8<=first;k+=8)
+    {
+      int16x8x2_t x = vld2q_s16(in+k*2);
+      lv2 = vpadalq_s16(lv2,x.val[0]);
+      rv2 = vpadalq_s16(rv2,x.val[1]);
+    }
+    lacc = vaddvq_s32(lv);
+    racc = vaddvq_s32(rv);
+    lacc2 = vaddvq_s32(lv2);
+    racc2 = vaddvq_s32(rv2);
+    for(;k<first;k++)
+    {
+      lacc2 += in[k*2];
+      racc2 += in[k*2+1];
+    }
+    lacc2 += lacc>>(3+TIMESHIFT);
+    racc2 += racc>>(3+TIMESHIFT);
+    *out++ = (lacc2*scale)>>16;
+    *out++ = (racc2*scale)>>16;
+    destavail--;
+    time += timestep;
+    amt = time>>TIMESHIFT;
+    time &= (1<<TIMESHIFT)-1;
+    in += amt*2;
+    srcavail -= amt;
+  }
+
+  *inp = in;
+  *srcavailp = srcavail;
+  *timep = time;
+  return destavail;
+}
+
+#define Sound_MixVector Sound_MixNEON
+
+#endif /* SOUND_NEON */
+
+#define SOUND_TESTPAIRS 1024
+
+/* Compare a mixer kernel against a reference for one downmix factor, using
+   random data */
+static bool Sound_MixCompare(Sound_MixFunc func,Sound_MixFunc ref,int32_t timestep,int32_t window)
+{
+  static SoundData in[SOUND_TESTPAIRS*2+SOUND_PADDING];
+  static SoundData out[2][SOUND_TESTPAIRS*2];
+  uint32_t scale = (uint32_t) ((((uint64_t) 1)<<(16+TIMESHIFT))/timestep);
+  uint32_t seed = 0x12345678;
+  const SoundData *end[2];
+  int32_t srcavail[2], destavail[2];
+  uint32_t time[2];
+  int i;
+
+  for(i=0;i<SOUND_TESTPAIRS*2+SOUND_PADDING;i++)
+    in[i] = (SoundData) ((seed = seed*1664525+1013904223)>>16);
+
+  for(i=0;i<2;i++)
+  {
+    end[i] = in;
+    srcavail[i] = SOUND_TESTPAIRS-window;
+    time[i] = (timestep*7) & ((1<<TIMESHIFT)-1);
+    memset(out[i],0xaa,sizeof(out[i]));
+    destavail[i] = (i ? ref : func)(out[i],SOUND_TESTPAIRS,&end[i],&srcavail[i],&time[i],timestep,scale);
+  }
+  if((end[0] != end[1]) || (srcavail[0] != srcavail[1]) || (time[0] != time[1])
+     || (destavail[0] != destavail[1]) || memcmp(out[0],out[1],sizeof(out[0])))
+  {
+    warn_vidc("Sound: Mixer self test failed for timestep %08x\n",timestep);
+    return false;
+  }
+  return true;
+}
+
+/* Compare the vector mixer against the scalar code for a range of downmix
+   factors and start times */
+static bool Sound_MixCheck(Sound_MixFunc func,Sound_MixFunc ref)
+{
+  int32_t timestep;
+  for(timestep=1;timestep<SOUND_TICKS(100);timestep+=1+(timestep>>4))
+  {
+    if(!Sound_MixCompare(func,ref,timestep,10+(timestep>>TIMESHIFT)))
+      return false;
+  }
+  return true;
+}
+
+static Sound_MixFunc soundMixKernel = Sound_MixScalar;
+
+#else
+
+#define soundMixKernel Sound_MixScalar
+
+#endif
+
+/*
+
+  Windowed-sinc resampler
+
+  An optional higher quality alternative to the area-sum mixer. The output is
+  the source stream, with each source sample held for 8 sample periods as
+  above, passed through a Kaiser-windowed sinc low-pass filter, cutting off
+  just below the lower of the two Nyquist frequencies, and sampled at the
+  host rate.
+
+  The filter is polyphase: there's one set of coefficients for each of the
+  1<<TIMESHIFT possible values of soundTime, so it fits in with the same
+  time/timestep bookkeeping as the area-sum mixer. Each set covers the source
+  samples from the current one onwards (the output is simply delayed by half
+  the filter length), and is normalised to a DC gain of exactly 1<<SINC_SHIFT.
+  Tables depend only on soundTimeStep, and the last few are cached, so
+  switching back and forth between sample rates is cheap.
+
+  The filter gets longer as the downsampling factor increases. If it would
+  need more than SINC_MAXTAPS taps the number of zero crossings is reduced,
+  down to SINC_MINZEROS, after which the area-sum mixer is used instead.
+
+*/
+
+#define SINC_SHIFT 14 /* Coefficient fraction bits */
+#define SINC_ZEROS 8 /* Zero crossings of the sinc on each side */
+#define SINC_MINZEROS 2
+#define SINC_MAXTAPS 192 /* Must fit in SOUND_MIRROR, and be a multiple of 8 */
+#define SINC_CUTOFF 0.9 /* Cutoff, as a fraction of the Nyquist frequency */
+#define SINC_BETA 7.0 /* Kaiser window shape */
+#define SINC_CACHE 4
+
+typedef struct {
+  uint32_t TimeStep; /* soundTimeStep the table is for, 0 if unused */
+  uint32_t Taps; /* Coefficients per phase; a multiple of 8 */
+  uint32_t LastUsed;
+  int16_t *Coefs; /* Taps coefficients for each of the 1<<TIMESHIFT phases */
+} Sound_SincTable;
+
+static Sound_SincTable soundSincCache[SINC_CACHE];
+static const Sound_SincTable *soundSinc = NULL; /* Table in use, or NULL for the area-sum mixer */
+static bool soundUseSinc = false;
+
+/* Modified Bessel function of the first kind, order 0 */
+static double Sound_BesselI0(double x)
+{
+  double sum = 1, term = 1;
+  int k;
+  for(k=1;k<50;k++)
+  {
+    term *= (x*x)/(4.0*k*k);
+    sum += term;
+    if(term < sum*1e-12)
+      break;
+  }
+  return sum;
+}
+
+/* Impulse response of the low-pass filter, 'x' source samples from its
+   centre. Has unit area. 'norm' is 1/I0(SINC_BETA), which scales the window
+   to 1 at the centre. */
+static double Sound_SincFilter(double x,double cutoff,double halfwidth,double norm)
+{
+  double r = x/halfwidth, y;
+  if((r <= -1) || (r >= 1))
+    return 0;
+  y = cutoff*x*3.14159265358979323846;
+  y = (fabs(y) < 1e-9 ? 1 : sin(y)/y);
+  return cutoff*y*Sound_BesselI0(SINC_BETA*sqrt(1-r*r))*norm;
+}
+
+static bool Sound_SincBuild(Sound_SincTable *table,uint32_t timestep)
+{
+  double ratio = ((double) timestep)/(1<<TIMESHIFT); /* Source samples per host sample */
+  double cutoff = SINC_CUTOFF*(ratio > 1 ? 1/ratio : 1);
+  double halfwidth = 0;
+  const double norm = 1/Sound_BesselI0(SINC_BETA);
+  uint32_t taps = 0;
+  int zeros, phase;
+  int16_t *coefs;
+
+  /* Source sample k covers source times k-7 to k+1, and output sample n is
+     centred on time+timestep/2, plus a delay of halfwidth+1 so that no
+     earlier samples are needed. So the taps must reach
+     2*halfwidth+8+(time+timestep/2) past the current sample */
+  for(zeros=SINC_ZEROS;zeros>=SINC_MINZEROS;zeros--)
+  {
+    halfwidth = zeros/cutoff;
+    taps = ((uint32_t) ceil(2*halfwidth+10+ratio/2)+7) & ~7;
+    if(taps <= SINC_MAXTAPS)
+      break;
+  }
+  if(taps > SINC_MAXTAPS)
+    return false;
+  coefs = (int16_t *) malloc(sizeof(int16_t)*taps<<TIMESHIFT);
+  if(!coefs)
+    return false;
+
+  for(phase=0;phase<(1<<TIMESHIFT);phase++)
+  {
+    double centre = (phase+timestep/2.0)/(1<<TIMESHIFT)+halfwidth+1;
+    double c[SINC_MAXTAPS], sum = 0;
+    int16_t *out = coefs+phase*taps;
+    int32_t total = 0, big = 0;
+    uint32_t k;
+    for(k=0;k<taps;k++)
+    {
+      /* Average of the filter over the 8 sample periods the sample is held
+         for */
+      int j;
+      c[k] = 0;
+      for(j=0;j<8;j++)
+        c[k] += Sound_SincFilter(centre-(k-6.5+j),cutoff,halfwidth,norm);
+      sum += c[k];
+    }
+    for(k=0;k<taps;k++)
+    {
+      out[k] = (int16_t) floor(c[k]*(1<<SINC_SHIFT)/sum+0.5);
+      total += out[k];
+      if(out[k] > out[big])
+        big = k;
+    }
+    /* Put any rounding error in the biggest tap, for exact unity DC gain */
+    out[big] += (1<<SINC_SHIFT)-total;
+  }
+
+  table->TimeStep = timestep;
+  table->Taps = taps;
+  table->Coefs = coefs;
+  return true;
+}
+
+/* Find or build the table for a timestep. Returns NULL if the sinc resampler
+   can't be used. */
+static const Sound_SincTable *Sound_SincGet(uint32_t timestep)
+{
+  static uint32_t clock = 0;
+  Sound_SincTable *table = &soundSincCache[0];
+  int i;
+  clock++;
+  for(i=0;i<SINC_CACHE;i++)
+  {
+    if(soundSincCache[i].TimeStep == timestep)
+    {
+      soundSincCache[i].LastUsed = clock;
+      return &soundSincCache[i];
+    }
+    if(soundSincCache[i].LastUsed < table->LastUsed)
+      table = &soundSincCache[i];
+  }
+  /* Replace the least recently used table */
+  free(table->Coefs);
+  memset(table,0,sizeof(*table));
+  if(!Sound_SincBuild(table,timestep))
+  {
+    warn_vidc("Sound: Can't build sinc resampler for timestep %08x, using fast resampler\n",timestep);
+    return NULL;
+  }
+  table->LastUsed = clock;
+  warn_vidc("Sound: Sinc resampler with %u taps\n",(unsigned int) table->Taps);
+  return table;
+}
+
+/* Building a table takes a few ms, or a few tens of ms for big downsampling
+   ratios, and happens on the emulator thread when the sample rate changes.
+   So build the one for RISC OS's default 48us sample period up front; other
+   rates are still built on first use. */
+static void Sound_SincPrebuild(void)
+{
+  uint64_t a = ((uint64_t) DisplayDev_GetVIDCClockIn())*1024;
+  uint64_t b = ((uint64_t) Sound_HostRate)*24*48;
+  uint32_t timestep;
+  if(!b)
+    return;
+  timestep = (uint32_t)((a<<TIMESHIFT)/b);
+  if(timestep < (SOUND_MIRROR-11-SOUND_PADDING/2)<<TIMESHIFT)
+    Sound_SincGet(timestep);
+}
+
+static void Sound_SincFree(void)
+{
+  int i;
+  for(i=0;i<SINC_CACHE;i++)
+    free(soundSincCache[i].Coefs);
+  memset(soundSincCache,0,sizeof(soundSincCache));
+  soundSinc = NULL;
+}
+
+static inline SoundData Sound_SincOutput(int32_t acc)
+{
+  acc = (acc+(1<<(SINC_SHIFT-1)))>>SINC_SHIFT;
+  if(acc > 32767)
+    return 32767;
+  if(acc < -32768)
+    return -32768;
+  return (SoundData) acc;
+}
+
+/* The sinc kernels have the same interface as the area-sum ones, but use
+   soundSinc instead of the scale factor */
+static int32_t Sound_MixSincScalar(SoundData *out,int32_t destavail,const SoundData **inp,int32_t *srcavailp,uint32_t *timep,int32_t timestep,uint32_t scale)
+{
+  const int16_t *coefs = soundSinc->Coefs;
+  const int32_t taps = soundSinc->Taps;
+  const SoundData *in = *inp;
+  int32_t srcavail = *srcavailp;
+  uint32_t time = *timep;
+
+  while((srcavail > 0) && (destavail > 0))
+  {
+    const int16_t *c = coefs+time*taps;
+    int32_t lacc=0,racc=0,amt,k;
+    for(k=0;k<taps;k++)
+    {
+      lacc += in[k*2]*c[k];
+      racc += in[k*2+1]*c[k];
+    }
+    *out++ = Sound_SincOutput(lacc);
+    *out++ = Sound_SincOutput(racc);
+    destavail--;
+    time += timestep;
+    amt = time>>TIMESHIFT;
+    time &= (1<<TIMESHIFT)-1;
+    in += amt*2;
+    srcavail -= amt;
+  }
+
+  *inp = in;
+  *srcavailp = srcavail;
+  *timep = time;
+  return destavail;
+}
+
+#ifdef SOUND_SSE2
+static int32_t Sound_MixSincSSE2(SoundData *out,int32_t destavail,const SoundData **inp,int32_t *srcavailp,uint32_t *timep,int32_t timestep,uint32_t scale)
+{
+  const int16_t *coefs = soundSinc->Coefs;
+  const int32_t taps = soundSinc->Taps;
+  const SoundData *in = *inp;
+  int32_t srcavail = *srcavailp;
+  uint32_t time = *timep;
+
+  while((srcavail > 0) && (destavail > 0))
+  {
+    const int16_t *c = coefs+time*taps;
+    __m128i acc = _mm_setzero_si128();
+    int32_t amt,k;
+    for(k=0;k<taps;k+=8)
+    {
+      /* c0 c1 c2 c3 -> c0 c1 c0 c1 c2 c3 c2 c3, to match Sound_LoadSSE2 */
+      __m128i cv = _mm_loadu_si128((const __m128i *) (c+k));
+      acc = _mm_add_epi32(acc,_mm_madd_epi16(Sound_LoadSSE2(in+k*2),_mm_unpacklo_epi32(cv,cv)));
+      acc = _mm_add_epi32(acc,_mm_madd_epi16(Sound_LoadSSE2(in+k*2+8),_mm_unpackhi_epi32(cv,cv)));
+    }
+    acc = _mm_add_epi32(acc,_mm_shuffle_epi32(acc,_MM_SHUFFLE(1,0,3,2)));
+    *out++ = Sound_SincOutput(_mm_cvtsi128_si32(acc));
+    *out++ = Sound_SincOutput(_mm_cvtsi128_si32(_mm_shuffle_epi32(acc,_MM_SHUFFLE(1,1,1,1))));
+    destavail--;
+    time += timestep;
+    amt = time>>TIMESHIFT;
+    time &= (1<<TIMESHIFT)-1;
+    in += amt*2;
+    srcavail -= amt;
+  }
+
+  *inp = in;
+  *srcavailp = srcavail;
+  *timep = time;
+  return destavail;
+}
+
+#define Sound_MixSincVector Sound_MixSincSSE2
+#endif /* SOUND_SSE2 */
+
+#ifdef SOUND_NEON
+static int32_t Sound_MixSincNEON(SoundData *out,int32_t destavail,const SoundData **inp,int32_t *srcavailp,uint32_t *timep,int32_t timestep,uint32_t scale)
+{
+  const int16_t *coefs = soundSinc->Coefs;
+  const int32_t taps = soundSinc->Taps;
+  const SoundData *in = *inp;
+  int32_t srcavail = *srcavailp;
+  uint32_t time = *timep;
+
+  while((srcavail > 0) && (destavail > 0))
+  {
+    const int16_t *c = coefs+time*taps;
+    int32x4_t lv = vdupq_n_s32(0), rv = vdupq_n_s32(0);
+    int32_t amt,k;
+    for(k=0;k<taps;k+=8)
+    {
+      int16x8_t cv = vld1q_s16(c+k);
+      int16x8x2_t x = vld2q_s16(in+k*2);
+      lv = vmlal_high_s16(vmlal_s16(lv,vget_low_s16(x.val[0]),vget_low_s16(cv)),x.val[0],cv);
+      rv = vmlal_high_s16(vmlal_s16(rv,vget_low_s16(x.val[1]),vget_low_s16(cv)),x.val[1],cv);
+    }
+    *out++ = Sound_SincOutput(vaddvq_s32(lv));
+    *out++ = Sound_SincOutput(vaddvq_s32(rv));
+    destavail--;
+    time += timestep;
+    amt = time>>TIMESHIFT;
+    time &= (1<<TIMESHIFT)-1;
+    in += amt*2;
+    srcavail -= amt;
+  }
+
+  *inp = in;
+  *srcavailp = srcavail;
+  *timep = time;
+  return destavail;
+}
+
+#define Sound_MixSincVector Sound_MixSincNEON
+#endif /* SOUND_NEON */
+
+#if defined(SOUND_SSE2) || defined(SOUND_NEON)
+/* Compare the vector sinc kernel against the scalar one for a few sample
+   rate ratios */
+static bool Sound_SincCheck(Sound_MixFunc func,Sound_MixFunc ref)
+{
+  static const uint32_t timesteps[] = {0xf1,0x79b,0x1770};
+  const Sound_SincTable *old = soundSinc;
+  bool ok = true;
+  int i;
+  for(i=0;ok && (i<(int) (sizeof(timesteps)/sizeof(timesteps[0])));i++)
+  {
+    Sound_SincTable table;
+    memset(&table,0,sizeof(table));
+    if(!Sound_SincBuild(&table,timesteps[i]))
+      continue;
+    soundSinc = &table;
+    ok = Sound_MixCompare(func,ref,timesteps[i],table.Taps);
+    free(table.Coefs);
+  }
+  soundSinc = old;
+  return ok;
+}
+
+static Sound_MixFunc soundSincKernel = Sound_MixSincScalar;
+#else
+#define soundSincKernel Sound_MixSincScalar
+#endif
+
+static int32_t Sound_Mix(SoundData *out,int32_t destavail)
+{
+  const SoundData *in = soundBuffer+(soundBufferStart<<1);
+  int32_t srcavail = soundBufferAmt;
+  uint32_t time = soundTime;
+  const int32_t timestep = soundTimeStep;
+  Sound_MixFunc kernel = (soundSinc ? soundSincKernel : soundMixKernel);
+
+  /* We can only generate a destination sample if all the required source
+     samples are present. Bias the source sample count by a suitable amount
+     so we don't have to worry about this in the main loop. */
+  srcavail -= soundWindow;
+
+  while((srcavail > 0) && (destavail > 0))
+  {
+    /* Only let the kernel start destination samples before the end of the
+       ring; their source samples will be in the mirror */
+    int32_t ringavail = SOUND_RING-((in-soundBuffer)>>1);
+    int32_t rest = 0;
+    int32_t remain;
+    if(srcavail > ringavail)
+    {
+      rest = srcavail-ringavail;
+      srcavail = ringavail;
+    }
+    remain = kernel(out,destavail,&in,&srcavail,&time,timestep,soundScale);
+    out += (destavail-remain)<<1;
+    destavail = remain;
+    srcavail += rest;
+    if(in >= soundBuffer+(SOUND_RING<<1))
+      in -= SOUND_RING<<1;
+  }
+
   /* Update globals */
-  srcavail += 10+(timestep>>TIMESHIFT);
-  memmove(soundBuffer,in,srcavail*sizeof(SoundData)*2); /* TODO - Improve this. Should only memmove() once we're near the end of the buffer. */
+  srcavail += soundWindow;
+  soundBufferStart = (uint32_t) ((in-soundBuffer)>>1);
   soundBufferAmt = srcavail;
   soundTime = time;
 
@@ -424,11 +1110,55 @@ static int32_t Sound_Mix(SoundData *out,int32_t destavail)
   return destavail;
 }
 
+static int32_t Sound_Clamp(int64_t x,int32_t limit)
+{
+  if(x > limit)
+    return limit;
+  if(x < -limit)
+    return -limit;
+  return (int32_t) x;
+}
+
+/* Update the latency controller after 'produced' stereo pairs have been given
+   to the host */
+static void Sound_UpdateRate(int32_t produced)
+{
+  int64_t target;
+  int32_t err;
+  if((Sound_HostFill < 0) || (Sound_HostCapacity <= 0) || !Sound_HostRate)
+    return;
+  /* Keep the target sensible for the host's queue */
+  target = (((int64_t) Sound_HostRate)*soundLatency)/(1000<<10);
+  if(target > (Sound_HostCapacity*3)/4)
+    target = (Sound_HostCapacity*3)/4;
+  if(target < Sound_BatchSize*2)
+    target = Sound_BatchSize*2;
+  soundTarget = (int32_t) target;
+  /* Error as a fraction of the target, 16.16 fixed point */
+  err = Sound_Clamp((((int64_t) (Sound_HostFill-soundTarget))<<16)/soundTarget,4<<16);
+  /* Integrate over the host time that the samples represent */
+  soundIntegral = Sound_Clamp(soundIntegral+((((int64_t) err)*produced*1024/Sound_HostRate)>>SOUND_KI_SHIFT),SOUND_ADJUST_MAX);
+  soundAdjust = Sound_Clamp((err>>SOUND_KP_SHIFT)+soundIntegral,SOUND_ADJUST_MAX);
+}
+
+void Sound_LogStats(void)
+{
+  if(Sound_HostFill < 0)
+  {
+    warn_vidc("Sound: host doesn't report its queue, no latency control\n");
+    return;
+  }
+  warn_vidc("Sound: %d pairs queued of %d, target %d (%ums), rate adjust %+.2f%% (integral %+.2f%%), %u underruns, %u overruns\n",
+            (int) Sound_HostFill,(int) Sound_HostCapacity,(int) soundTarget,(unsigned int) soundLatency,
+            soundAdjust*(100.0/65536),soundIntegral*(100.0/65536),
+            (unsigned int) Sound_HostUnderruns,(unsigned int) Sound_HostOverruns);
+}
+
 static void Sound_DoMix(void)
 {
   int32_t destavail;
   SoundData *out;
-  if(soundBufferAmt <= 10+(soundTimeStep>>TIMESHIFT))
+  if(soundBufferAmt <= soundWindow)
     return;
   /* Get host buffer params */
   out = Sound_GetHostBuffer(&destavail);
@@ -436,8 +1166,10 @@ static void Sound_DoMix(void)
   {
     /* Mix into host buffer */
     int32_t remain = Sound_Mix(out,destavail);
+    Capture_Sound(out,destavail-remain);
     /* Tell the host */
     Sound_HostBuffered(out,destavail-remain);
+    Sound_UpdateRate(destavail-remain);
   }
 }
 
@@ -463,14 +1195,44 @@ static void Sound_Process(ARMul_State *state,int32_t avail)
     b = ((uint64_t) Sound_HostRate)*24*(VIDC.SoundFreq+2);
     soundTimeStep = (uint32_t)((a<<TIMESHIFT)/b);
     soundScale = (uint32_t)((b<<16)/a);
+    /* The source samples for one destination sample must fit in the mirror.
+       Only very low host rates could get anywhere near the limit. The scale
+       has to match the clamped step, or the output would be too quiet */
+    if(soundTimeStep >= (SOUND_MIRROR-11-SOUND_PADDING/2)<<TIMESHIFT)
+    {
+      soundTimeStep = ((SOUND_MIRROR-11-SOUND_PADDING/2)<<TIMESHIFT)-1;
+      soundScale = (uint32_t) ((((uint64_t) 1)<<(16+TIMESHIFT))/soundTimeStep);
+      warn_vidc("Host sample rate %dHz is too low, sound will play slower than it should\n",Sound_HostRate>>10);
+    }
+    soundSinc = (soundUseSinc ? Sound_SincGet(soundTimeStep) : NULL);
+    soundWindow = (soundSinc ? soundSinc->Taps : 10+(soundTimeStep>>TIMESHIFT));
     warn_vidc("New sample period %d (VIDC %dMHz) host %dHz -> timestep %08x scale %08x\n",VIDC.SoundFreq+2,clockin/1000000,Sound_HostRate>>10,soundTimeStep,soundScale);
     soundTime = 0;
   }
   if(avail)
   {
-    /* Log -> lin conversion */
-    Sound_Log2Lin(((uint8_t *) MEMC.PhysRam) + MEMC.Sptr,soundBuffer+(soundBufferAmt<<1),avail);
-    soundBufferAmt += avail<<4;
+    /* Log -> lin conversion, into the ring. Data is only ever added in whole
+       DMA fetches (16 pairs), so a fetch never straddles the end of the ring */
+    const uint8_t *in = ((uint8_t *) MEMC.PhysRam) + MEMC.Sptr;
+    while(avail)
+    {
+      uint32_t pos = (soundBufferStart+soundBufferAmt) & (SOUND_RING-1);
+      int32_t count = (SOUND_RING-pos)>>4;
+      if(count > avail)
+        count = avail;
+      Sound_Log2Lin(in,soundBuffer+(pos<<1),count);
+      if(pos < SOUND_MIRROR)
+      {
+        /* Update the mirror */
+        uint32_t end = pos+(count<<4);
+        if(end > SOUND_MIRROR)
+          end = SOUND_MIRROR;
+        memcpy(soundBuffer+((SOUND_RING+pos)<<1),soundBuffer+(pos<<1),(end-pos)*sizeof(SoundData)*2);
+      }
+      soundBufferAmt += count<<4;
+      in += count<<4;
+      avail -= count;
+    }
   }
   /* Process this new data */
   Sound_DoMix();
@@ -525,7 +1287,7 @@ static void Sound_DMAEvent(ARMul_State *state,CycleCount nowtime)
     if(avail > srcbatchsize)
       avail = srcbatchsize;
 #ifdef SOUND_SUPPORT
-    bufspace = (16*MAX_BATCH_SIZE-soundBufferAmt)>>4;
+    bufspace = (SOUND_RING-soundBufferAmt)>>4;
     if(avail > bufspace)
       avail = bufspace;
 #endif 
@@ -536,7 +1298,11 @@ static void Sound_DMAEvent(ARMul_State *state,CycleCount nowtime)
 #endif
   /* Work out when to reschedule the event
      TODO - This is wrong; there's no guarantee the host accepted all the data we wanted to give him */
-  next = Sound_DMARate*(avail?avail:srcbatchsize)+Sound_FudgeRate;
+  next = Sound_DMARate*(avail?avail:srcbatchsize);
+#ifdef SOUND_SUPPORT
+  next += (CycleDiff) ((((int64_t) next)*soundAdjust)>>16);
+#endif
+  next += Sound_FudgeRate;
   /* Clamp to a safe minimum value */
   if(next < 100)
     next = 100;
@@ -548,10 +1314,24 @@ static void Sound_DMAEvent(ARMul_State *state,CycleCount nowtime)
 int Sound_Init(ARMul_State *state)
 {
 #ifdef SOUND_SUPPORT
+  int ret;
   SoundInitTable();
+#if defined(SOUND_SSE2) || defined(SOUND_NEON)
+  soundMixKernel = (Sound_MixCheck(Sound_MixVector,Sound_MixScalar) ? Sound_MixVector : Sound_MixScalar);
+#endif
+  soundUseSinc = (CONFIG.eResampler == Resampler_Sinc);
+#if defined(SOUND_SSE2) || defined(SOUND_NEON)
+  if(soundUseSinc)
+    soundSincKernel = (Sound_SincCheck(Sound_MixSincVector,Sound_MixSincScalar) ? Sound_MixSincVector : Sound_MixSincScalar);
+#endif
+  if(CONFIG.uSoundLatency)
+    soundLatency = CONFIG.uSoundLatency;
   Sound_UpdateDMARate(state);
   EventQ_Insert(state,ARMul_Time+Sound_DMARate,Sound_DMAEvent);
-  return Sound_InitHost(state);
+  ret = Sound_InitHost(state);
+  if(!ret && soundUseSinc)
+    Sound_SincPrebuild();
+  return ret;
 #else
   Sound_UpdateDMARate(state);
   EventQ_Insert(state,ARMul_Time+Sound_DMARate,Sound_DMAEvent);
@@ -566,6 +1346,8 @@ void Sound_Shutdown(ARMul_State *state)
     EventQ_Remove(state,idx);
 
 #ifdef SOUND_SUPPORT
+  Sound_LogStats();
   Sound_ShutdownHost(state);
+  Sound_SincFree();
 #endif
 }
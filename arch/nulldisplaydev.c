@@ -0,0 +1,639 @@
+/*
+   arch/nulldisplaydev.c
+
+   Part of Arcem, covered under the GNU GPL, see file COPYING for details
+
+   This is the "null display driver", for running the emulator without any
+   display attached. It keeps the frame timing of the standard display driver
+   (so VSync interrupts and ARMul_EmuRate behave the same) but never converts
+   any pixels, which makes it very cheap to run.
+
+   For visual checks (e.g. in automated tests) it can optionally write a
+   snapshot of the display area to a PPM file every N frames, and/or whenever
+   the process receives SIGUSR1. Screen memory is copied at the start of the
+   frame, and the conversion and file writing are done on a separate thread
+   where RENDER_THREAD is enabled. If the previous snapshot hasn't been written
+   yet then the new one is skipped, so the emulator never waits for the disc.
+
+   Snapshots only show the display area; the border and mouse pointer are not
+   drawn.
+*/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef RENDER_THREAD
+#include <pthread.h>
+#endif
+
+#include "../armdefs.h"
+#include "armarc.h"
+#include "archio.h"
+#include "dbugsys.h"
+#include "displaydev.h"
+#include "ArcemConfig.h"
+#include "ControlPane.h"
+#include "sound.h"
+#include "capture.h"
+
+/* State captured for a snapshot */
+struct NullDD_Snapshot {
+  uint32_t Frame; /* Frame number, used to name the file */
+  int Width,Height; /* Size of display area, in pixels */
+  uint_fast16_t CR; /* VIDC.ControlReg */
+  bool DMAEn; /* Whether video DMA was enabled */
+  uint32_t Vptr,Vstart,Vend; /* DMA pointers, in bits */
+  uint_least16_t Palette[16];
+  uint_least16_t BorderCol;
+  uint32_t RAMWords; /* Number of words in RAM */
+  ARMword RAM[(512*1024)/4]; /* Copy of the video DMA-able RAM */
+};
+
+struct NullDD_DisplayInfo {
+  /* Raw VIDC registers - must come first! */
+  struct Vidc_Regs Vidc;
+
+  struct {
+    bool ModeChanged; /* Set if any registers change which may require a mode change */
+    bool FLYBK; /* Flyback signal (i.e. whether we've triggered VSync IRQ this frame) */
+    int LastWidth,LastHeight,LastHz; /* Last mode that was reported */
+    uint32_t RateNum,RateDen; /* Exact frame rate of the current mode, RateNum/RateDen Hz */
+    uint32_t LineRate; /* Line rate, measured in EmuRate clock cycles */
+    CycleCount NextTime; /* Time the current event was scheduled for */
+    uint32_t Frame; /* Frame counter */
+    uint32_t SnapshotCountdown; /* Frames until next periodic snapshot */
+  } Control;
+
+  struct NullDD_Snapshot Snapshot;
+
+#ifdef RENDER_THREAD
+  struct {
+    bool Running; /* Whether the writer thread was started */
+    bool Quit; /* Set to make the writer thread exit */
+    bool Busy; /* Set while Snapshot is waiting to be (or being) written */
+    pthread_t Thread;
+    pthread_mutex_t Mutex; /* Protects Quit & Busy */
+    pthread_cond_t Wake; /* Signalled when Busy or Quit gets set */
+  } Writer;
+#endif
+
+  const char *Prefix; /* Snapshot filename prefix */
+};
+
+#define DISPLAYINFO (*((struct NullDD_DisplayInfo *) state->Display))
+#define DC (DISPLAYINFO.Control)
+#define WRITER (DISPLAYINFO.Writer)
+
+#define VideoRelUpdateAndForce(flag, writeto, from) \
+{\
+  if ((writeto) != (from)) { \
+    (writeto) = (from);\
+    flag = true;\
+  };\
+};
+
+#ifdef SIGUSR1
+static volatile sig_atomic_t NullDD_SnapshotRequested = 0;
+
+/* Whatever SIGUSR1 did before Init, restored by Shutdown */
+static void (*NullDD_PrevSnapshotSignal)(int) = SIG_DFL;
+
+static void NullDD_SnapshotSignal(int sig)
+{
+  NullDD_SnapshotRequested = 1;
+}
+#endif
+
+/*
+
+  Snapshot writing
+
+*/
+
+static uint32_t NullDD_VIDCToRGB(uint_fast16_t col)
+{
+  return ((col & 0xf)*0x11) | (((col>>4) & 0xf)*0x1100) | (((col>>8) & 0xf)*0x110000);
+}
+
+static void NullDD_WriteSnapshot(const struct NullDD_Snapshot *snap,const char *prefix)
+{
+  static const uint_least16_t ExtraPal[16] = {
+    0x000, 0x008, 0x040, 0x048, 0x080, 0x088, 0x0c0, 0x0c8,
+    0x800, 0x808, 0x840, 0x848, 0x880, 0x888, 0x8c0, 0x8c8
+  };
+  const int log2bpp = (snap->CR>>2) & 3;
+  const ARMword mask = (1<<(1<<log2bpp))-1;
+  uint32_t Palette[256];
+  uint32_t Vptr = snap->Vptr;
+  uint32_t Vstart = snap->Vstart;
+  uint32_t Vend = snap->Vend;
+  uint8_t *line;
+  char *filename;
+  FILE *f;
+  int x,y,i;
+
+  filename = malloc(strlen(prefix)+16);
+  line = malloc(snap->Width*3);
+  if(!filename || !line) {
+    warn_vidc("Failed to allocate memory for snapshot\n");
+    free(filename);
+    free(line);
+    return;
+  }
+  sprintf(filename,"%s%08u.ppm",prefix,(unsigned int) snap->Frame);
+
+  /* Build the palette */
+  if(log2bpp == 3) {
+    for(i=0;i<256;i++) {
+      Palette[i] = NullDD_VIDCToRGB((snap->Palette[i & 15] & 0x1737) | ExtraPal[i>>4]);
+    }
+  } else {
+    for(i=0;i<16;i++) {
+      Palette[i] = NullDD_VIDCToRGB(snap->Palette[i]);
+    }
+  }
+
+  /* Sanity checks to avoid looping forever */
+  if(Vend == Vstart)
+    Vend = Vstart+128;
+  if(Vptr >= Vend)
+    Vptr = Vstart;
+
+  f = fopen(filename,"wb");
+  if(!f) {
+    warn_vidc("Failed to open snapshot file %s\n",filename);
+    free(filename);
+    free(line);
+    return;
+  }
+  fprintf(f,"P6\n%d %d\n255\n",snap->Width,snap->Height);
+  for(y=0;y<snap->Height;y++) {
+    uint8_t *out = line;
+    for(x=0;x<snap->Width;x++) {
+      uint32_t rgb;
+      if(!snap->DMAEn) {
+        rgb = NullDD_VIDCToRGB(snap->BorderCol);
+      } else {
+        ARMword word = ((Vptr>>5) < snap->RAMWords ? snap->RAM[Vptr>>5] : 0);
+        rgb = Palette[(word>>(Vptr & 31)) & mask];
+        Vptr += 1<<log2bpp;
+        if(Vptr >= Vend)
+          Vptr = Vstart;
+      }
+      *out++ = rgb;
+      *out++ = rgb>>8;
+      *out++ = rgb>>16;
+    }
+    fwrite(line,3,snap->Width,f);
+  }
+  if(ferror(f) | fclose(f)) {
+    warn_vidc("Failed to write snapshot file %s\n",filename);
+  } else {
+    dbug_vidc("Wrote snapshot %s\n",filename);
+  }
+  free(filename);
+  free(line);
+}
+
+#ifdef RENDER_THREAD
+static void *NullDD_WriterThread(void *arg)
+{
+  ARMul_State *state = (ARMul_State *) arg;
+  pthread_mutex_lock(&WRITER.Mutex);
+  for(;;) {
+    while(!WRITER.Busy && !WRITER.Quit) {
+      pthread_cond_wait(&WRITER.Wake,&WRITER.Mutex);
+    }
+    if(!WRITER.Busy) {
+      break;
+    }
+    pthread_mutex_unlock(&WRITER.Mutex);
+    NullDD_WriteSnapshot(&DISPLAYINFO.Snapshot,DISPLAYINFO.Prefix);
+    pthread_mutex_lock(&WRITER.Mutex);
+    WRITER.Busy = false;
+  }
+  pthread_mutex_unlock(&WRITER.Mutex);
+  return NULL;
+}
+#endif
+
+/* Capture the current frame and get it written out */
+static void NullDD_TakeSnapshot(ARMul_State *state)
+{
+  struct NullDD_Snapshot *snap = &DISPLAYINFO.Snapshot;
+  size_t RAMSize = MIN(MEMC.RAMSize,512*1024);
+  int Width = (VIDC.Horiz_DisplayEnd-VIDC.Horiz_DisplayStart)*2;
+  int Height = VIDC.Vert_DisplayEnd-VIDC.Vert_DisplayStart;
+  bool DMAEn = (MEMC.ControlReg>>10)&1;
+
+  if(Height <= 0) {
+    /* Display output has been forced off; show just the border */
+    Height = VIDC.Vert_BorderEnd-VIDC.Vert_BorderStart;
+    DMAEn = false;
+  }
+  if((Width < 1) || (Height < 1)) {
+    dbug_vidc("Skipping snapshot of bad mode\n");
+    return;
+  }
+
+#ifdef RENDER_THREAD
+  if(WRITER.Running) {
+    bool busy;
+    pthread_mutex_lock(&WRITER.Mutex);
+    busy = WRITER.Busy;
+    pthread_mutex_unlock(&WRITER.Mutex);
+    if(busy) {
+      dbug_vidc("Previous snapshot still being written, skipping frame %u\n",(unsigned int) DC.Frame);
+      return;
+    }
+  }
+#endif
+
+  snap->Frame = DC.Frame;
+  snap->Width = Width;
+  snap->Height = Height;
+  snap->CR = VIDC.ControlReg;
+  snap->DMAEn = DMAEn;
+  snap->Vptr = MEMC.Vinit<<7;
+  snap->Vstart = MEMC.Vstart<<7;
+  snap->Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  memcpy(snap->Palette,VIDC.Palette,sizeof(snap->Palette));
+  snap->BorderCol = VIDC.BorderCol;
+  snap->RAMWords = RAMSize/4;
+  memcpy(snap->RAM,MEMC.PhysRam,RAMSize);
+
+#ifdef RENDER_THREAD
+  if(WRITER.Running) {
+    pthread_mutex_lock(&WRITER.Mutex);
+    WRITER.Busy = true;
+    pthread_cond_signal(&WRITER.Wake);
+    pthread_mutex_unlock(&WRITER.Mutex);
+    return;
+  }
+#endif
+  NullDD_WriteSnapshot(snap,DISPLAYINFO.Prefix);
+}
+
+/*
+
+  Frame timing
+
+  Each frame consists of two events; FrameStart at the end of the vsync pulse
+  and VSyncEvent at the end of the display area, matching the timing the
+  standard display driver uses when it's skipping a frame.
+
+*/
+
+static void NullDD_FrameStart(ARMul_State *state,CycleCount nowtime);
+static void NullDD_VSyncEvent(ARMul_State *state,CycleCount nowtime);
+
+static void NullDD_UpdateLineRate(ARMul_State *state)
+{
+  /* Assuming a multiplier of 2, these are the required clock dividers
+     (selected via bottom two bits of VIDC.ControlReg): */
+  static const uint_fast8_t ClockDividers[4] = {
+  /* Source rates:     24.0MHz     25.0MHz      36.0MHz */
+    6, /* 1/3      ->   8.0MHz      8.3MHz      12.0MHz */
+    4, /* 1/2      ->  12.0MHz     12.5MHz      18.0MHz */
+    3, /* 2/3      ->  16.0MHz     16.6MHz      24.0MHz */
+    2, /* 1/1      ->  24.0MHz     25.0MHz      36.0MHz */
+  };
+
+  const uint32_t ClockIn = 2*DisplayDev_GetVIDCClockIn();
+  const uint_fast8_t ClockDivider = ClockDividers[VIDC.ControlReg&3];
+
+  DC.LineRate = (uint32_t) ((((uint64_t) ARMul_EmuRate)*(VIDC.Horiz_Cycle*2+2))*ClockDivider/ClockIn);
+  if(DC.LineRate < 100)
+    DC.LineRate = 100; /* Clamp to safe minimum value */
+
+  if(DC.ModeChanged)
+  {
+    int Width = (VIDC.Horiz_DisplayEnd-VIDC.Horiz_DisplayStart)*2;
+    int Height = (VIDC.Vert_DisplayEnd-VIDC.Vert_DisplayStart);
+    int FrameRate;
+    DC.RateNum = ClockIn;
+    DC.RateDen = (VIDC.Horiz_Cycle*2+2)*(VIDC.Vert_Cycle+1)*ClockDivider;
+    FrameRate = DC.RateNum/DC.RateDen;
+    if((Width != DC.LastWidth) || (Height != DC.LastHeight) || (FrameRate != DC.LastHz))
+    {
+      warn_vidc("New mode: %dx%d, %dHz (CR %x ClockIn %dMhz)\n",Width,Height,FrameRate,VIDC.ControlReg,(int)(ClockIn/2000000));
+      DC.LastWidth = Width;
+      DC.LastHeight = Height;
+      DC.LastHz = FrameRate;
+    }
+    DC.ModeChanged = false;
+  }
+}
+
+/* Schedule 'func' to run after 'rows' scanlines. The time is relative to when
+   the current event was due, to avoid any slip/skew. */
+static void NullDD_Schedule(ARMul_State *state,EventQ_Func func,int rows,int idx)
+{
+  if(rows < 1)
+    rows = 1;
+  DC.NextTime += rows*DC.LineRate;
+  EventQ_Reschedule(state,DC.NextTime,func,idx);
+}
+
+static void NullDD_FrameStart(ARMul_State *state,CycleCount nowtime)
+{
+  /* Work out which scanline VSync is due on */
+  int vsync = MAX(VIDC.Vert_DisplayStart,VIDC.Vert_DisplayEnd);
+  bool snapshot = false;
+
+  NullDD_UpdateLineRate(state);
+  DC.FLYBK = false;
+  DC.Frame++;
+
+  Capture_Frame(state,DC.RateNum,DC.RateDen);
+
+  if(DC.SnapshotCountdown && !--DC.SnapshotCountdown)
+  {
+    DC.SnapshotCountdown = CONFIG.uSnapshotInterval;
+    snapshot = true;
+  }
+#ifdef SIGUSR1
+  if(NullDD_SnapshotRequested)
+  {
+    NullDD_SnapshotRequested = 0;
+    snapshot = true;
+  }
+#endif
+  if(snapshot)
+    NullDD_TakeSnapshot(state);
+
+  NullDD_Schedule(state,NullDD_VSyncEvent,vsync+1-(VIDC.Vert_SyncWidth+1),EventQ_Find2(state,NullDD_FrameStart));
+}
+
+static void NullDD_VSyncEvent(ARMul_State *state,CycleCount nowtime)
+{
+  int vsync = MAX(VIDC.Vert_DisplayStart,VIDC.Vert_DisplayEnd);
+  CycleCount oldrate = ARMul_EmuRate;
+
+  /* Trigger VSync. This can manipulate the event queue, so find ourselves
+     again afterwards */
+  DC.FLYBK = true;
+  DisplayDev_VSync(state);
+
+  /* If EmuRate has just changed, recalculate the line rate now to try and keep things in sync */
+  if(oldrate != ARMul_EmuRate)
+    NullDD_UpdateLineRate(state);
+
+  /* Run to the end of the frame, then the end of the next vsync pulse */
+  NullDD_Schedule(state,NullDD_FrameStart,(VIDC.Vert_Cycle+1)-(vsync+1)+(VIDC.Vert_SyncWidth+1),EventQ_Find2(state,NullDD_VSyncEvent));
+}
+
+/*
+
+  VIDC/IOEB write handler
+
+*/
+
+static void NullDD_VIDCPutVal(ARMul_State *state,ARMword address, ARMword data,bool bNw) {
+  uint32_t addr, val;
+
+  addr=(data>>24) & 255;
+  val=data & 0xffffff;
+
+  if (!(addr & 0xc0)) {
+    VIDC.Palette[(addr>>2) & 15] = (val & 0x1fff);
+    return;
+  };
+
+  addr&=~3;
+  switch (addr) {
+    case 0x40: /* Border col */
+      dbug_vidc("VIDC border colour write val=0x%x\n",val);
+      VIDC.BorderCol = val & 0x1fff;
+      break;
+
+    case 0x44: /* Cursor palette log col 1 */
+    case 0x48: /* Cursor palette log col 2 */
+    case 0x4c: /* Cursor palette log col 3 */
+      addr = (addr-0x44)>>2;
+      dbug_vidc("VIDC cursor log col %d write val=0x%x\n",addr+1,val);
+      VIDC.CursorPalette[addr] = val & 0x1fff;
+      break;
+
+    case 0x60: /* Stereo image reg 7 */
+    case 0x64: /* Stereo image reg 0 */
+    case 0x68: /* Stereo image reg 1 */
+    case 0x6c: /* Stereo image reg 2 */
+    case 0x70: /* Stereo image reg 3 */
+    case 0x74: /* Stereo image reg 4 */
+    case 0x78: /* Stereo image reg 5 */
+    case 0x7c: /* Stereo image reg 6 */
+      dbug_vidc("VIDC stereo image reg write val=0x%x\n",val);
+      val &= 7;
+      addr = ((addr-0x64)>>2)&0x7;
+      if(VIDC.StereoImageReg[addr] != val)
+      {
+        VIDC.StereoImageReg[addr] = val;
+#ifdef SOUND_SUPPORT
+        Sound_StereoUpdated(state);
+#endif
+      }
+      break;
+
+    case 0x80:
+      dbug_vidc("VIDC Horiz cycle register val=%d\n",val>>14);
+      VideoRelUpdateAndForce(DC.ModeChanged,VIDC.Horiz_Cycle,(val>>14) & 0x3ff);
+      break;
+
+    case 0x84:
+      dbug_vidc("VIDC Horiz sync width register val=%d\n",val>>14);
+      VIDC.Horiz_SyncWidth = (val>>14) & 0x3ff;
+      break;
+
+    case 0x88:
+      dbug_vidc("VIDC Horiz border start register val=%d\n",val>>14);
+      VIDC.Horiz_BorderStart = (val>>14) & 0x3ff;
+      break;
+
+    case 0x8c:
+      dbug_vidc("VIDC Horiz display start register val=%d\n",val>>14);
+      VideoRelUpdateAndForce(DC.ModeChanged,VIDC.Horiz_DisplayStart,(val>>14) & 0x3ff);
+      break;
+
+    case 0x90:
+      dbug_vidc("VIDC Horiz display end register val=%d\n",val>>14);
+      VideoRelUpdateAndForce(DC.ModeChanged,VIDC.Horiz_DisplayEnd,(val>>14) & 0x3ff);
+      break;
+
+    case 0x94:
+      dbug_vidc("VIDC horizontal border end register val=%d\n",val>>14);
+      VIDC.Horiz_BorderEnd = (val>>14) & 0x3ff;
+      break;
+
+    case 0x98:
+      dbug_vidc("VIDC horiz cursor start register val=%d\n",val>>13);
+      VIDC.Horiz_CursorStart=(val>>13) & 0x7ff;
+      break;
+
+    case 0x9c:
+      dbug_vidc("VIDC horiz interlace register val=%d\n",val>>14);
+      VIDC.Horiz_Interlace = (val>>14) & 0x3ff;
+      break;
+
+    case 0xa0:
+      dbug_vidc("VIDC Vert cycle register val=%d\n",val>>14);
+      VideoRelUpdateAndForce(DC.ModeChanged,VIDC.Vert_Cycle,(val>>14) & 0x3ff);
+      break;
+
+    case 0xa4:
+      dbug_vidc("VIDC Vert sync width register val=%d\n",val>>14);
+      VIDC.Vert_SyncWidth = (val>>14) & 0x3ff;
+      break;
+
+    case 0xa8:
+      dbug_vidc("VIDC Vert border start register val=%d\n",val>>14);
+      VIDC.Vert_BorderStart = (val>>14) & 0x3ff;
+      break;
+
+    case 0xac:
+      dbug_vidc("VIDC Vert disp start register val=%d\n",val>>14);
+      VideoRelUpdateAndForce(DC.ModeChanged,VIDC.Vert_DisplayStart,((val>>14) & 0x3ff));
+      break;
+
+    case 0xb0:
+      dbug_vidc("VIDC Vert disp end register val=%d\n",val>>14);
+      VideoRelUpdateAndForce(DC.ModeChanged,VIDC.Vert_DisplayEnd,(val>>14) & 0x3ff);
+      break;
+
+    case 0xb4:
+      dbug_vidc("VIDC Vert Border end register val=%d\n",val>>14);
+      VIDC.Vert_BorderEnd = (val>>14) & 0x3ff;
+      break;
+
+    case 0xb8:
+      dbug_vidc("VIDC Vert cursor start register val=%d\n",val>>14);
+      VIDC.Vert_CursorStart=(val>>14) & 0x3ff;
+      break;
+
+    case 0xbc:
+      dbug_vidc("VIDC Vert cursor end register val=%d\n",val>>14);
+      VIDC.Vert_CursorEnd=(val>>14) & 0x3ff;
+      break;
+
+    case 0xc0:
+      dbug_vidc("VIDC Sound freq register val=%d\n",val);
+      val &= 0xff;
+      if(VIDC.SoundFreq != val)
+      {
+        VIDC.SoundFreq=val;
+#ifdef SOUND_SUPPORT
+        Sound_SoundFreqUpdated(state);
+#endif
+      }
+      break;
+
+    case 0xe0:
+      dbug_vidc("VIDC Control register val=0x%x\n",val);
+      VideoRelUpdateAndForce(DC.ModeChanged,VIDC.ControlReg,val & 0xffff);
+      break;
+
+    default:
+      warn_vidc("Write to unknown VIDC register reg=0x%x val=0x%x\n",addr,val);
+      break;
+
+  }; /* Register switch */
+} /* PutValVIDC */
+
+static void NullDD_IOEBCRWrite(ARMul_State *state,ARMword data) {
+  DC.ModeChanged = true;
+}
+
+static void NullDD_DAGWrite(ARMul_State *state,int reg,ARMword val)
+{
+  /* Nothing to do; the DMA pointers are only read when taking a snapshot */
+}
+
+/*
+
+  DisplayDev wrapper
+
+*/
+
+static int NullDD_Init(ARMul_State *state,const struct Vidc_Regs *Vidc)
+{
+  state->Display = calloc(1,sizeof(struct NullDD_DisplayInfo));
+  if(!state->Display) {
+    warn_vidc("Failed to allocate DisplayInfo\n");
+    return -1;
+  }
+
+  VIDC = *Vidc;
+
+  DISPLAYINFO.Prefix = (CONFIG.sSnapshotPrefix ? CONFIG.sSnapshotPrefix : "snapshot");
+
+  DC.ModeChanged = true;
+  DC.LastWidth = DC.LastHeight = DC.LastHz = -1;
+  DC.RateNum = DC.RateDen = 0;
+  DC.FLYBK = false;
+  DC.LineRate = 10000;
+  DC.Frame = 0;
+  DC.SnapshotCountdown = CONFIG.uSnapshotInterval;
+
+#ifdef RENDER_THREAD
+  pthread_mutex_init(&WRITER.Mutex,NULL);
+  pthread_cond_init(&WRITER.Wake,NULL);
+  WRITER.Running = !pthread_create(&WRITER.Thread,NULL,NullDD_WriterThread,state);
+  if(!WRITER.Running) {
+    warn_vidc("Failed to create snapshot thread, writing snapshots on main thread instead\n");
+  }
+#endif
+
+#ifdef SIGUSR1
+  NullDD_SnapshotRequested = 0;
+  NullDD_PrevSnapshotSignal = signal(SIGUSR1,NullDD_SnapshotSignal);
+  if(NullDD_PrevSnapshotSignal == SIG_ERR)
+    NullDD_PrevSnapshotSignal = SIG_DFL;
+#endif
+
+  /* Schedule first update event */
+  DC.NextTime = ARMul_Time+100;
+  EventQ_Insert(state,DC.NextTime,NullDD_FrameStart);
+
+  return 0;
+}
+
+static void NullDD_Shutdown(ARMul_State *state)
+{
+  int idx = EventQ_Find(state,NullDD_FrameStart);
+  if(idx == -1)
+    idx = EventQ_Find(state,NullDD_VSyncEvent);
+  if(idx >= 0)
+    EventQ_Remove(state,idx);
+  else
+  {
+    ControlPane_Error(EXIT_FAILURE,"Couldn't find NullDD event func!\n");
+  }
+#ifdef SIGUSR1
+  signal(SIGUSR1,NullDD_PrevSnapshotSignal);
+#endif
+#ifdef RENDER_THREAD
+  if(WRITER.Running)
+  {
+    /* Let any pending snapshot finish */
+    pthread_mutex_lock(&WRITER.Mutex);
+    WRITER.Quit = true;
+    pthread_cond_signal(&WRITER.Wake);
+    pthread_mutex_unlock(&WRITER.Mutex);
+    pthread_join(WRITER.Thread,NULL);
+  }
+  pthread_cond_destroy(&WRITER.Wake);
+  pthread_mutex_destroy(&WRITER.Mutex);
+#endif
+  free(state->Display);
+  state->Display = NULL;
+}
+
+const DisplayDev NullDD_DisplayDev = {
+  NullDD_Init,
+  NullDD_Shutdown,
+  NullDD_VIDCPutVal,
+  NullDD_DAGWrite,
+  NullDD_IOEBCRWrite,
+};
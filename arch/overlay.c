@@ -0,0 +1,391 @@
+/*
+  arch/overlay.c
+
+  Part of Arcem released under the GNU GPL, see file COPYING
+  for details.
+
+  Copy-on-write overlays for disc images. The overlay is a sparse file that
+  holds only the blocks that have been written, plus a bitmap saying which
+  those are; everything else is read from the base image, which is never
+  written to. This lets any number of emulator instances share one base.
+
+  The file layout (all values little-endian) is:
+
+    0   "ArcEmOvl"
+    8   Version (1)
+    12  Block size in bytes
+    16  Size of the base image in bytes (64 bits)
+    24  Checksum of the start of the base image
+    28  Number of blocks
+    32  Offset of the block data
+    36  Reserved, zero
+    64  Bitmap, one bit per block, LSB first
+
+  Block n lives at data offset + n * block size, whether or not it's in use,
+  so on filesystems that support sparse files the overlay only takes up as
+  much space as the blocks that have been written.
+
+  This file doesn't depend on the rest of the emulator, so that the
+  ovlmerge tool can be built from it too.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#include "overlay.h"
+
+#define OVERLAY_VERSION 1
+#define HEADERSIZE 64
+#define DATAALIGN 4096
+
+/* How much of the base image goes into the checksum */
+#define CHECKSIZE (64*1024)
+
+struct Overlay_s {
+  FILE *Base;
+  FILE *File;
+  uint32_t BlockSize;
+  uint32_t BaseSize;
+  uint32_t NumBlocks;
+  uint32_t DataOffset;
+  uint8_t *Bitmap;
+  bool BitmapDirty;
+};
+
+static const char OverlayMagic[8] = {'A','r','c','E','m','O','v','l'};
+
+/*------------------------------------------------------------------------------*/
+static void put32(uint8_t *p,uint32_t val)
+{
+  p[0] = val;
+  p[1] = val>>8;
+  p[2] = val>>16;
+  p[3] = val>>24;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+  return p[0] | (p[1]<<8) | (p[2]<<16) | (((uint32_t) p[3])<<24);
+}
+
+/*------------------------------------------------------------------------------*/
+static bool Overlay_BlockUsed(const Overlay *ov,uint32_t block)
+{
+  return (ov->Bitmap[block>>3] >> (block&7)) & 1;
+}
+
+static void Overlay_SetBlockUsed(Overlay *ov,uint32_t block)
+{
+  ov->Bitmap[block>>3] |= 1<<(block&7);
+  ov->BitmapDirty = true;
+}
+
+/*------------------------------------------------------------------------------*/
+/* FNV-1a over the start of the base image; enough to catch an overlay being
+   used with the wrong base without reading the whole thing */
+static bool Overlay_CheckBase(FILE *base,uint32_t size,uint32_t *check)
+{
+  uint8_t buf[4096];
+  uint32_t hash = 2166136261u;
+  uint32_t left = (size < CHECKSIZE ? size : CHECKSIZE);
+
+  if (fseek(base, 0, SEEK_SET))
+    return false;
+  while (left) {
+    uint32_t len = (left < sizeof(buf) ? left : sizeof(buf));
+    uint32_t i;
+    if (fread(buf, 1, len, base) != len)
+      return false;
+    for (i = 0; i < len; i++)
+      hash = (hash ^ buf[i]) * 16777619u;
+    left -= len;
+  }
+  *check = hash;
+  return true;
+}
+
+/*------------------------------------------------------------------------------*/
+static bool Overlay_Seek(FILE *f,uint32_t pos)
+{
+  return !fseek(f, (long) pos, SEEK_SET);
+}
+
+/*------------------------------------------------------------------------------*/
+/* Ask the OS to put what's been written to a (flushed) file on disc */
+static bool Overlay_SyncFile(FILE *f)
+{
+#if defined(_WIN32)
+  return !_commit(_fileno(f));
+#elif defined(__unix__) || defined(__APPLE__)
+  return !fsync(fileno(f));
+#else
+  (void) f;
+  return true;
+#endif
+}
+
+/*------------------------------------------------------------------------------*/
+Overlay *Overlay_Open(FILE *base,const char *path,bool create,const char **err)
+{
+  uint8_t header[HEADERSIZE];
+  uint32_t check, bitmapsize;
+  long size;
+  Overlay *ov;
+
+  if (fseek(base, 0, SEEK_END) || (size = ftell(base)) < 0) {
+    *err = "couldn't find the size of the base image";
+    return NULL;
+  }
+  if (!Overlay_CheckBase(base, (uint32_t) size, &check)) {
+    *err = "couldn't read the base image";
+    return NULL;
+  }
+
+  ov = calloc(1, sizeof(Overlay));
+  if (!ov) {
+    *err = "out of memory";
+    return NULL;
+  }
+  ov->Base = base;
+  ov->BaseSize = (uint32_t) size;
+
+  ov->File = fopen(path, "rb+");
+  if (ov->File) {
+    if (fread(header, 1, HEADERSIZE, ov->File) != HEADERSIZE ||
+        memcmp(header, OverlayMagic, sizeof(OverlayMagic))) {
+      *err = "not an overlay file";
+      goto fail;
+    }
+    if (get32(header+8) != OVERLAY_VERSION) {
+      *err = "unsupported overlay version";
+      goto fail;
+    }
+    ov->BlockSize = get32(header+12);
+    ov->NumBlocks = get32(header+28);
+    ov->DataOffset = get32(header+32);
+    if (get32(header+16) != ov->BaseSize || get32(header+20) != 0 ||
+        get32(header+24) != check) {
+      *err = "overlay was made for a different base image";
+      goto fail;
+    }
+    bitmapsize = (ov->NumBlocks+7)>>3;
+    if (!ov->BlockSize ||
+        ov->NumBlocks != (ov->BaseSize+ov->BlockSize-1)/ov->BlockSize ||
+        ov->DataOffset < HEADERSIZE+bitmapsize) {
+      *err = "overlay header is corrupt";
+      goto fail;
+    }
+    ov->Bitmap = calloc(1, bitmapsize+1);
+    if (!ov->Bitmap) {
+      *err = "out of memory";
+      goto fail;
+    }
+    if (fread(ov->Bitmap, 1, bitmapsize, ov->File) != bitmapsize) {
+      *err = "overlay bitmap is truncated";
+      goto fail;
+    }
+    return ov;
+  }
+
+  if (!create) {
+    *err = "couldn't open overlay file";
+    goto fail;
+  }
+  ov->File = fopen(path, "wb+");
+  if (!ov->File) {
+    *err = "couldn't create overlay file";
+    goto fail;
+  }
+  ov->BlockSize = OVERLAY_BLOCKSIZE;
+  ov->NumBlocks = (ov->BaseSize+OVERLAY_BLOCKSIZE-1)/OVERLAY_BLOCKSIZE;
+  bitmapsize = (ov->NumBlocks+7)>>3;
+  ov->DataOffset = (HEADERSIZE+bitmapsize+DATAALIGN-1) & ~(DATAALIGN-1);
+  ov->Bitmap = calloc(1, bitmapsize+1);
+  if (!ov->Bitmap) {
+    *err = "out of memory";
+    goto fail;
+  }
+
+  memset(header, 0, sizeof(header));
+  memcpy(header, OverlayMagic, sizeof(OverlayMagic));
+  put32(header+8, OVERLAY_VERSION);
+  put32(header+12, ov->BlockSize);
+  put32(header+16, ov->BaseSize);
+  put32(header+24, check);
+  put32(header+28, ov->NumBlocks);
+  put32(header+32, ov->DataOffset);
+  if (fwrite(header, 1, HEADERSIZE, ov->File) != HEADERSIZE ||
+      fwrite(ov->Bitmap, 1, bitmapsize, ov->File) != bitmapsize ||
+      fflush(ov->File)) {
+    *err = "couldn't write overlay header";
+    goto fail;
+  }
+  return ov;
+
+fail:
+  if (ov->File)
+    fclose(ov->File);
+  free(ov->Bitmap);
+  free(ov);
+  return NULL;
+} /* Overlay_Open */
+
+/*------------------------------------------------------------------------------*/
+size_t Overlay_Read(Overlay *ov,uint32_t offset,uint8_t *buf,size_t len)
+{
+  size_t done = 0;
+
+  if (offset >= ov->BaseSize)
+    return 0;
+  if (len > ov->BaseSize-offset)
+    len = ov->BaseSize-offset;
+
+  while (done < len) {
+    uint32_t block = offset/ov->BlockSize;
+    bool used = Overlay_BlockUsed(ov, block);
+    uint32_t next = block+1;
+    size_t run = ov->BlockSize-(offset%ov->BlockSize);
+    FILE *f;
+    uint32_t pos;
+
+    /* Read as many blocks from the same place as possible in one go */
+    while (done+run < len && Overlay_BlockUsed(ov, next) == used) {
+      run += ov->BlockSize;
+      next++;
+    }
+    if (run > len-done)
+      run = len-done;
+
+    if (used) {
+      f = ov->File;
+      pos = ov->DataOffset+block*ov->BlockSize+(offset%ov->BlockSize);
+    } else {
+      f = ov->Base;
+      pos = offset;
+    }
+    if (!Overlay_Seek(f, pos) || fread(buf+done, 1, run, f) != run)
+      break;
+    done += run;
+    offset += run;
+  }
+  return done;
+} /* Overlay_Read */
+
+/*------------------------------------------------------------------------------*/
+size_t Overlay_Write(Overlay *ov,uint32_t offset,const uint8_t *buf,size_t len)
+{
+  uint8_t *tmp = NULL;
+  size_t done = 0;
+
+  if (offset >= ov->BaseSize)
+    return 0;
+  if (len > ov->BaseSize-offset)
+    len = ov->BaseSize-offset;
+
+  while (done < len) {
+    uint32_t block = offset/ov->BlockSize;
+    uint32_t within = offset%ov->BlockSize;
+    size_t chunk = ov->BlockSize-within;
+    if (chunk > len-done)
+      chunk = len-done;
+
+    if (!Overlay_BlockUsed(ov, block) && chunk != ov->BlockSize) {
+      /* Partial write to a block that's still in the base: copy it up first */
+      uint32_t start = block*ov->BlockSize;
+      size_t blocklen = ov->BlockSize;
+      if (blocklen > ov->BaseSize-start)
+        blocklen = ov->BaseSize-start;
+      if (!tmp && !(tmp = malloc(ov->BlockSize)))
+        break;
+      if (Overlay_Read(ov, start, tmp, blocklen) != blocklen)
+        break;
+      memcpy(tmp+within, buf+done, chunk);
+      if (!Overlay_Seek(ov->File, ov->DataOffset+start) ||
+          fwrite(tmp, 1, blocklen, ov->File) != blocklen)
+        break;
+    } else {
+      if (!Overlay_Seek(ov->File, ov->DataOffset+offset) ||
+          fwrite(buf+done, 1, chunk, ov->File) != chunk)
+        break;
+    }
+    /* Only mark the block once its data is in place */
+    Overlay_SetBlockUsed(ov, block);
+    done += chunk;
+    offset += chunk;
+  }
+  free(tmp);
+  return done;
+} /* Overlay_Write */
+
+/*------------------------------------------------------------------------------*/
+bool Overlay_Flush(Overlay *ov,bool durable)
+{
+  if (ov->BitmapDirty) {
+    uint32_t bitmapsize = (ov->NumBlocks+7)>>3;
+    /* Make sure the block data is out before the bitmap that refers to it */
+    if (fflush(ov->File) || (durable && !Overlay_SyncFile(ov->File)) ||
+        !Overlay_Seek(ov->File, HEADERSIZE) ||
+        fwrite(ov->Bitmap, 1, bitmapsize, ov->File) != bitmapsize)
+      return false;
+    ov->BitmapDirty = false;
+  }
+  if (fflush(ov->File))
+    return false;
+  return !durable || Overlay_SyncFile(ov->File);
+} /* Overlay_Flush */
+
+/*------------------------------------------------------------------------------*/
+bool Overlay_Close(Overlay *ov)
+{
+  bool ok = Overlay_Flush(ov, true);
+  if (fclose(ov->File))
+    ok = false;
+  free(ov->Bitmap);
+  free(ov);
+  return ok;
+} /* Overlay_Close */
+
+/*------------------------------------------------------------------------------*/
+int32_t Overlay_Merge(Overlay *ov,FILE *dest,const char **err)
+{
+  uint8_t *tmp = malloc(ov->BlockSize);
+  int32_t count = 0;
+  uint32_t block;
+
+  if (!tmp) {
+    *err = "out of memory";
+    return -1;
+  }
+  for (block = 0; block < ov->NumBlocks; block++) {
+    uint32_t start = block*ov->BlockSize;
+    size_t len = ov->BlockSize;
+    if (!Overlay_BlockUsed(ov, block))
+      continue;
+    if (len > ov->BaseSize-start)
+      len = ov->BaseSize-start;
+    if (!Overlay_Seek(ov->File, ov->DataOffset+start) ||
+        fread(tmp, 1, len, ov->File) != len) {
+      *err = "couldn't read from overlay";
+      count = -1;
+      break;
+    }
+    if (!Overlay_Seek(dest, start) || fwrite(tmp, 1, len, dest) != len) {
+      *err = "couldn't write to image";
+      count = -1;
+      break;
+    }
+    count++;
+  }
+  free(tmp);
+  if (count >= 0 && (fflush(dest) || !Overlay_SyncFile(dest))) {
+    *err = "couldn't write to image";
+    count = -1;
+  }
+  return count;
+} /* Overlay_Merge */
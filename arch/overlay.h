@@ -0,0 +1,106 @@
+/*
+  arch/overlay.h
+
+  Part of Arcem released under the GNU GPL, see file COPYING
+  for details.
+
+  Copy-on-write overlays for disc images, so that many emulator instances
+  can share one read-only base image
+*/
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <stdio.h>
+
+#include "../c99.h"
+
+/* Size of the blocks that new overlays track; a divisor of every floppy
+   sector and ST506 record size */
+#define OVERLAY_BLOCKSIZE 256
+
+typedef struct Overlay_s Overlay;
+
+/**
+ * Overlay_Open
+ *
+ * Open the overlay for a base image, optionally creating it if it doesn't
+ * exist. An existing overlay is checked against the base image's size and
+ * contents, so that it can't be applied to the wrong image.
+ *
+ * @param base   Base image, open for reading. Must stay open until the
+ *               overlay is closed.
+ * @param path   Filename of the overlay
+ * @param create Create a new, empty overlay if there's no file at 'path'
+ * @param err    Set to a description of the problem on failure
+ * @returns The overlay, or NULL on failure
+ */
+Overlay *Overlay_Open(FILE *base, const char *path, bool create, const char **err);
+
+/**
+ * Overlay_Read
+ *
+ * Read from the combined image: blocks that have been written come from the
+ * overlay, the rest from the base image.
+ *
+ * @param ov     Overlay
+ * @param offset Byte offset into the image
+ * @param buf    Destination
+ * @param len    Number of bytes to read
+ * @returns Number of bytes read, which is short at the end of the image or
+ *          on error
+ */
+size_t Overlay_Read(Overlay *ov, uint32_t offset, uint8_t *buf, size_t len);
+
+/**
+ * Overlay_Write
+ *
+ * Write to the combined image. Only the overlay file is changed. Blocks that
+ * are only partly written are first filled in from the combined image.
+ *
+ * @param ov     Overlay
+ * @param offset Byte offset into the image
+ * @param buf    Data to write
+ * @param len    Number of bytes to write
+ * @returns Number of bytes written, which is short at the end of the image or
+ *          on error
+ */
+size_t Overlay_Write(Overlay *ov, uint32_t offset, const uint8_t *buf, size_t len);
+
+/**
+ * Overlay_Flush
+ *
+ * Write out the index of changed blocks and flush the overlay file. Until
+ * this is done, blocks written since the last flush may be lost if the
+ * emulator doesn't exit cleanly.
+ *
+ * @param ov      Overlay
+ * @param durable Also wait for the OS to write the file to disc, so that the
+ *                changes survive the host crashing
+ * @returns true on success
+ */
+bool Overlay_Flush(Overlay *ov, bool durable);
+
+/**
+ * Overlay_Close
+ *
+ * Durably flush and close an overlay. The base image is left open.
+ *
+ * @param ov Overlay
+ * @returns true if the final flush succeeded
+ */
+bool Overlay_Close(Overlay *ov);
+
+/**
+ * Overlay_Merge
+ *
+ * Copy every block held in an overlay into an image.
+ *
+ * @param ov   Overlay
+ * @param dest Image to write to, normally the base image reopened for
+ *             writing
+ * @param err  Set to a description of the problem on failure
+ * @returns Number of blocks copied, or -1 on failure
+ */
+int32_t Overlay_Merge(Overlay *ov, FILE *dest, const char **err);
+
+#endif
@@ -0,0 +1,593 @@
+/*
+  arch/rowconv.c
+
+  Part of Arcem released under the GNU GPL, see file COPYING
+  for details.
+
+  Vectorised conversion of screen memory into host pixels.
+
+  Each converter works in two stages on blocks of 16 source bytes. First the
+  packed 1/2/4bpp pixels are unpacked into one byte per pixel using shuffles,
+  then the bytes are expanded into host colours, writing each one twice for
+  2X scaling. Palettes of 16 entries or fewer are small enough to be held in
+  vector registers; 8bpp palettes use gather loads where the CPU has them, and
+  plain lookups otherwise.
+
+  Any pixels before the first byte boundary, and after the last whole block,
+  are handled by the scalar reference code.
+
+  The vector code addresses screen memory as bytes, so is only used on
+  little-endian hosts.
+
+  RowConv_Hash, at the end, hashes screen memory for drivers which aren't
+  using MEMC.UpdateFlags.
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "rowconv.h"
+#include "dbugsys.h"
+
+#if (defined(__x86_64__) || defined(_M_X64))
+#define ROWCONV_X86
+#elif defined(__aarch64__) && (!defined(__BYTE_ORDER__) || (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__))
+#define ROWCONV_NEON
+#endif
+
+#ifdef ROWCONV_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ROWCONV_AVX2
+#else
+#define ROWCONV_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#ifdef ROWCONV_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(ROWCONV_X86) || defined(ROWCONV_NEON)
+
+/*
+
+  Scalar reference code
+
+*/
+
+#define ROWCONV_SCALAR(TYPE) \
+{ \
+  TYPE *o = (TYPE *) out; \
+  const TYPE *pal = (const TYPE *) Palette; \
+  uint32_t bpp = 1<<log2bpp; \
+  ARMword mask = (1<<bpp)-1; \
+  while(count--) \
+  { \
+    TYPE col = pal[(RAM[Vptr>>5] >> (Vptr & 31)) & mask]; \
+    *o++ = col; \
+    if(scale == 2) \
+      *o++ = col; \
+    Vptr += bpp; \
+  } \
+  return o; \
+}
+
+static void *rowconv_Scalar16(void *out,const ARMword *RAM,uint32_t Vptr,unsigned int count,const void *Palette,int log2bpp,int scale)
+ROWCONV_SCALAR(uint16_t)
+
+static void *rowconv_Scalar32(void *out,const ARMword *RAM,uint32_t Vptr,unsigned int count,const void *Palette,int log2bpp,int scale)
+ROWCONV_SCALAR(uint32_t)
+
+/* Expand one byte per pixel into host colours */
+#define ROWCONV_LOOKUP(TYPE) \
+{ \
+  TYPE *o = (TYPE *) out; \
+  const TYPE *pal = (const TYPE *) Palette; \
+  unsigned int i; \
+  if(scale == 2) \
+  { \
+    for(i=0;i<count;i++) \
+      o[i*2] = o[i*2+1] = pal[idx[i]]; \
+  } \
+  else \
+  { \
+    for(i=0;i<count;i++) \
+      o[i] = pal[idx[i]]; \
+  } \
+}
+
+static inline void rowconv_Lookup16(void *out,const uint8_t *idx,unsigned int count,const void *Palette,int scale)
+ROWCONV_LOOKUP(uint16_t)
+
+static inline void rowconv_Lookup32(void *out,const uint8_t *idx,unsigned int count,const void *Palette,int scale)
+ROWCONV_LOOKUP(uint32_t)
+
+/*
+
+  Common driver
+
+  Converts pixels up to the first byte boundary, then whole blocks of 16
+  source bytes, then the remainder. UNPACK(idx,src,log2bpp) must unpack 16
+  source bytes into idx. LOOKUP(o,idx,count,Palette,log2bpp,scale) must expand
+  count bytes from idx into count*scale host colours at o.
+
+*/
+
+#define ROWCONV_DRIVER(TYPE,SCALAR,UNPACK,LOOKUP) \
+{ \
+  TYPE *o; \
+  uint8_t idx[128]; \
+  const uint8_t *src; \
+  unsigned int block = 128>>log2bpp; /* Pixels per block */ \
+  unsigned int head = ((8-(Vptr & 7)) & 7)>>log2bpp; \
+  if(head > count) \
+    head = count; \
+  o = (TYPE *) SCALAR(out,RAM,Vptr,head,Palette,log2bpp,scale); \
+  Vptr += head<<log2bpp; \
+  count -= head; \
+  src = ((const uint8_t *) RAM)+(Vptr>>3); \
+  while(count >= block) \
+  { \
+    UNPACK(idx,src,log2bpp); \
+    LOOKUP(o,idx,block,Palette,log2bpp,scale); \
+    o += block*scale; \
+    src += 16; \
+    Vptr += 128; \
+    count -= block; \
+  } \
+  return SCALAR(o,RAM,Vptr,count,Palette,log2bpp,scale); \
+}
+
+/*
+
+  x86-64: SSE2 unpacking, with AVX2 lookups if available
+
+*/
+
+#ifdef ROWCONV_X86
+
+static inline void rowconv_UnpackSSE2(uint8_t *idx,const uint8_t *src,int log2bpp)
+{
+  __m128i v[8];
+  int n = 1, w, i;
+  v[0] = _mm_loadu_si128((const __m128i *) src);
+  /* Split each byte into two pixels of half the width, until we reach the
+     source depth. Work backwards so the expansion can be done in place */
+  for(w=4;w>=(1<<log2bpp);w>>=1)
+  {
+    __m128i mask = _mm_set1_epi8((char) ((1<<w)-1));
+    __m128i shift = _mm_cvtsi32_si128(w);
+    for(i=n-1;i>=0;i--)
+    {
+      __m128i lo = _mm_and_si128(v[i],mask);
+      __m128i hi = _mm_and_si128(_mm_srl_epi16(v[i],shift),mask);
+      v[2*i] = _mm_unpacklo_epi8(lo,hi);
+      v[2*i+1] = _mm_unpackhi_epi8(lo,hi);
+    }
+    n <<= 1;
+  }
+  for(i=0;i<n;i++)
+    _mm_storeu_si128((__m128i *) (idx+16*i),v[i]);
+}
+
+#define rowconv_LookupSSE2_16(o,idx,count,Palette,log2bpp,scale) rowconv_Lookup16(o,idx,count,Palette,scale)
+#define rowconv_LookupSSE2_32(o,idx,count,Palette,log2bpp,scale) rowconv_Lookup32(o,idx,count,Palette,scale)
+
+static void *rowconv_SSE2_16(void *out,const ARMword *RAM,uint32_t Vptr,unsigned int count,const void *Palette,int log2bpp,int scale)
+ROWCONV_DRIVER(uint16_t,rowconv_Scalar16,rowconv_UnpackSSE2,rowconv_LookupSSE2_16)
+
+static void *rowconv_SSE2_32(void *out,const ARMword *RAM,uint32_t Vptr,unsigned int count,const void *Palette,int log2bpp,int scale)
+ROWCONV_DRIVER(uint32_t,rowconv_Scalar32,rowconv_UnpackSSE2,rowconv_LookupSSE2_32)
+
+/* Store 16 bit colours for 32 pixel indices, in order */
+static ROWCONV_AVX2 inline void rowconv_StoreAVX2_16(uint16_t *o,__m256i lo,__m256i hi,__m256i x)
+{
+  __m256i l = _mm256_shuffle_epi8(lo,x);
+  __m256i h = _mm256_shuffle_epi8(hi,x);
+  __m256i a = _mm256_unpacklo_epi8(l,h);
+  __m256i b = _mm256_unpackhi_epi8(l,h);
+  /* Unpacks work within 128 bit lanes, so put the halves back in order */
+  _mm256_storeu_si256((__m256i *) o,_mm256_permute2x128_si256(a,b,0x20));
+  _mm256_storeu_si256((__m256i *) (o+16),_mm256_permute2x128_si256(a,b,0x31));
+}
+
+static ROWCONV_AVX2 inline void rowconv_LookupAVX2_16(void *out,const uint8_t *idx,unsigned int count,const void *Palette,int log2bpp,int scale)
+{
+  uint16_t *o = (uint16_t *) out;
+  uint8_t planes[2][16];
+  __m256i lo, hi;
+  unsigned int i;
+  if(log2bpp == 3)
+  {
+    /* No 16 bit gather, and 32 bit gathers could read past the end of the palette */
+    rowconv_Lookup16(out,idx,count,Palette,scale);
+    return;
+  }
+  /* Split the palette into byte planes, and use them as shuffle tables */
+  for(i=0;i<16;i++)
+  {
+    planes[0][i] = ((const uint8_t *) Palette)[i*2];
+    planes[1][i] = ((const uint8_t *) Palette)[i*2+1];
+  }
+  lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) planes[0]));
+  hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) planes[1]));
+  for(i=0;i<count;i+=32)
+  {
+    __m256i x = _mm256_loadu_si256((const __m256i *) (idx+i));
+    if(scale == 2)
+    {
+      /* Duplicating the indices is cheaper than duplicating the colours */
+      __m256i a = _mm256_unpacklo_epi8(x,x);
+      __m256i b = _mm256_unpackhi_epi8(x,x);
+      rowconv_StoreAVX2_16(o+i*2,lo,hi,_mm256_permute2x128_si256(a,b,0x20));
+      rowconv_StoreAVX2_16(o+i*2+32,lo,hi,_mm256_permute2x128_si256(a,b,0x31));
+    }
+    else
+      rowconv_StoreAVX2_16(o+i,lo,hi,x);
+  }
+}
+
+static ROWCONV_AVX2 inline void rowconv_LookupAVX2_32(void *out,const uint8_t *idx,unsigned int count,const void *Palette,int log2bpp,int scale)
+{
+  uint32_t *o = (uint32_t *) out;
+  /* 16 entry palette fits in two registers; permute each and pick by bit 3 */
+  __m256i lo = _mm256_loadu_si256((const __m256i *) Palette);
+  __m256i hi = _mm256_loadu_si256((const __m256i *) (((const uint32_t *) Palette)+8));
+  __m256i seven = _mm256_set1_epi32(7);
+  unsigned int i;
+  for(i=0;i<count;i+=8)
+  {
+    __m256i x = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (idx+i)));
+    __m256i r;
+    if(log2bpp == 3)
+      r = _mm256_i32gather_epi32((const int *) Palette,x,4);
+    else
+      r = _mm256_blendv_epi8(_mm256_permutevar8x32_epi32(lo,x),
+                             _mm256_permutevar8x32_epi32(hi,x),
+                             _mm256_cmpgt_epi32(x,seven));
+    if(scale == 2)
+    {
+      __m256i a = _mm256_unpacklo_epi32(r,r);
+      __m256i b = _mm256_unpackhi_epi32(r,r);
+      _mm256_storeu_si256((__m256i *) (o+i*2),_mm256_permute2x128_si256(a,b,0x20));
+      _mm256_storeu_si256((__m256i *) (o+i*2+8),_mm256_permute2x128_si256(a,b,0x31));
+    }
+    else
+      _mm256_storeu_si256((__m256i *) (o+i),r);
+  }
+}
+
+static ROWCONV_AVX2 void *rowconv_AVX2_16(void *out,const ARMword *RAM,uint32_t Vptr,unsigned int count,const void *Palette,int log2bpp,int scale)
+ROWCONV_DRIVER(uint16_t,rowconv_Scalar16,rowconv_UnpackSSE2,rowconv_LookupAVX2_16)
+
+static ROWCONV_AVX2 void *rowconv_AVX2_32(void *out,const ARMword *RAM,uint32_t Vptr,unsigned int count,const void *Palette,int log2bpp,int scale)
+ROWCONV_DRIVER(uint32_t,rowconv_Scalar32,rowconv_UnpackSSE2,rowconv_LookupAVX2_32)
+
+static bool rowconv_HaveAVX2(void)
+{
+#ifdef _MSC_VER
+  int regs[4];
+  __cpuid(regs,1);
+  /* Need OSXSAVE, and the OS must be saving the YMM registers */
+  if(!(regs[2] & (1<<27)) || ((_xgetbv(0) & 6) != 6))
+    return false;
+  __cpuidex(regs,7,0);
+  return (regs[1] & (1<<5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif /* ROWCONV_X86 */
+
+/*
+
+  AArch64: NEON unpacking, and table lookups for small palettes
+
+*/
+
+#ifdef ROWCONV_NEON
+
+static inline void rowconv_UnpackNEON(uint8_t *idx,const uint8_t *src,int log2bpp)
+{
+  uint8x16_t v[8];
+  int n = 1, w, i;
+  v[0] = vld1q_u8(src);
+  for(w=4;w>=(1<<log2bpp);w>>=1)
+  {
+    uint8x16_t mask = vdupq_n_u8((1<<w)-1);
+    int8x16_t shift = vdupq_n_s8(-w);
+    for(i=n-1;i>=0;i--)
+    {
+      uint8x16_t lo = vandq_u8(v[i],mask);
+      uint8x16_t hi = vshlq_u8(v[i],shift);
+      v[2*i] = vzip1q_u8(lo,hi);
+      v[2*i+1] = vzip2q_u8(lo,hi);
+    }
+    n <<= 1;
+  }
+  for(i=0;i<n;i++)
+    vst1q_u8(idx+16*i,v[i]);
+}
+
+static inline void rowconv_LookupNEON_16(void *out,const uint8_t *idx,unsigned int count,const void *Palette,int log2bpp,int scale)
+{
+  uint16_t *o = (uint16_t *) out;
+  uint8x16x2_t planes;
+  unsigned int i;
+  int j;
+  if(log2bpp == 3)
+  {
+    rowconv_Lookup16(out,idx,count,Palette,scale);
+    return;
+  }
+  /* De-interleave the palette into byte planes, look up each plane, then
+     re-interleave on store */
+  planes = vld2q_u8((const uint8_t *) Palette);
+  for(i=0;i<count;i+=16)
+  {
+    uint8x16_t x[2];
+    x[0] = vld1q_u8(idx+i);
+    if(scale == 2)
+    {
+      x[1] = vzip2q_u8(x[0],x[0]);
+      x[0] = vzip1q_u8(x[0],x[0]);
+    }
+    for(j=0;j<scale;j++)
+    {
+      uint8x16x2_t r;
+      r.val[0] = vqtbl1q_u8(planes.val[0],x[j]);
+      r.val[1] = vqtbl1q_u8(planes.val[1],x[j]);
+      vst2q_u8((uint8_t *) o,r);
+      o += 16;
+    }
+  }
+}
+
+static inline void rowconv_LookupNEON_32(void *out,const uint8_t *idx,unsigned int count,const void *Palette,int log2bpp,int scale)
+{
+  uint32_t *o = (uint32_t *) out;
+  uint8x16x4_t planes;
+  unsigned int i;
+  int j;
+  if(log2bpp == 3)
+  {
+    rowconv_Lookup32(out,idx,count,Palette,scale);
+    return;
+  }
+  planes = vld4q_u8((const uint8_t *) Palette);
+  for(i=0;i<count;i+=16)
+  {
+    uint8x16_t x[2];
+    x[0] = vld1q_u8(idx+i);
+    if(scale == 2)
+    {
+      x[1] = vzip2q_u8(x[0],x[0]);
+      x[0] = vzip1q_u8(x[0],x[0]);
+    }
+    for(j=0;j<scale;j++)
+    {
+      uint8x16x4_t r;
+      r.val[0] = vqtbl1q_u8(planes.val[0],x[j]);
+      r.val[1] = vqtbl1q_u8(planes.val[1],x[j]);
+      r.val[2] = vqtbl1q_u8(planes.val[2],x[j]);
+      r.val[3] = vqtbl1q_u8(planes.val[3],x[j]);
+      vst4q_u8((uint8_t *) o,r);
+      o += 16;
+    }
+  }
+}
+
+static void *rowconv_NEON_16(void *out,const ARMword *RAM,uint32_t Vptr,unsigned int count,const void *Palette,int log2bpp,int scale)
+ROWCONV_DRIVER(uint16_t,rowconv_Scalar16,rowconv_UnpackNEON,rowconv_LookupNEON_16)
+
+static void *rowconv_NEON_32(void *out,const ARMword *RAM,uint32_t Vptr,unsigned int count,const void *Palette,int log2bpp,int scale)
+ROWCONV_DRIVER(uint32_t,rowconv_Scalar32,rowconv_UnpackNEON,rowconv_LookupNEON_32)
+
+#endif /* ROWCONV_NEON */
+
+/*
+
+  Selection & self test
+
+*/
+
+#define ROWCONV_TESTWORDS 64
+
+/* Compare a converter against the scalar code for all depths and scales, a
+   selection of start offsets and lengths, and random data */
+static bool rowconv_Check(RowConv_Func func,RowConv_Func ref,size_t hostbytes)
+{
+  static ARMword RAM[ROWCONV_TESTWORDS];
+  static uint32_t Palette[256];
+  static uint32_t out[2][ROWCONV_TESTWORDS*32*2+1];
+  static const unsigned int counts[] = {0,1,3,16,17,31,32,33,100,128,129,255,256,1000,2047};
+  uint32_t seed = 0x12345678;
+  int log2bpp, scale;
+  unsigned int i, c;
+  uint32_t Vptr;
+
+  for(i=0;i<ROWCONV_TESTWORDS;i++)
+    RAM[i] = (seed = seed*1664525+1013904223);
+  for(i=0;i<256;i++)
+    Palette[i] = (seed = seed*1664525+1013904223);
+
+  for(log2bpp=0;log2bpp<4;log2bpp++)
+  for(scale=1;scale<=2;scale++)
+  for(Vptr=0;Vptr<64;Vptr+=(1<<log2bpp))
+  for(c=0;c<sizeof(counts)/sizeof(counts[0]);c++)
+  {
+    unsigned int count = counts[c];
+    uint8_t *end[2];
+    if(Vptr+(count<<log2bpp) > ROWCONV_TESTWORDS*32)
+      continue;
+    memset(out,0xaa,sizeof(out));
+    end[0] = (uint8_t *) func(out[0],RAM,Vptr,count,Palette,log2bpp,scale);
+    end[1] = (uint8_t *) ref(out[1],RAM,Vptr,count,Palette,log2bpp,scale);
+    if((end[0]-(uint8_t *) out[0] != end[1]-(uint8_t *) out[1])
+       || (end[1]-(uint8_t *) out[1] != (ptrdiff_t) (count*scale*hostbytes))
+       || memcmp(out[0],out[1],sizeof(out[0])))
+    {
+      warn_vidc("RowConv: Self test failed for %d byte host colours, %dbpp, scale %d, offset %u, count %u\n",(int) hostbytes,1<<log2bpp,scale,Vptr,count);
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif
+
+RowConv_Func RowConv_Get(size_t hostbytes)
+{
+#if defined(ROWCONV_X86) || defined(ROWCONV_NEON)
+  static bool Checked = false;
+  static RowConv_Func Funcs[2];
+  int i;
+  if(!Checked)
+  {
+    RowConv_Func ref[2] = {rowconv_Scalar16, rowconv_Scalar32};
+#ifdef ROWCONV_X86
+    if(rowconv_HaveAVX2())
+    {
+      Funcs[0] = rowconv_AVX2_16;
+      Funcs[1] = rowconv_AVX2_32;
+    }
+    else
+    {
+      Funcs[0] = rowconv_SSE2_16;
+      Funcs[1] = rowconv_SSE2_32;
+    }
+#else
+    Funcs[0] = rowconv_NEON_16;
+    Funcs[1] = rowconv_NEON_32;
+#endif
+    for(i=0;i<2;i++)
+    {
+      if(!rowconv_Check(Funcs[i],ref[i],2<<i))
+        Funcs[i] = NULL;
+    }
+    Checked = true;
+  }
+  if(hostbytes == 2)
+    return Funcs[0];
+  if(hostbytes == 4)
+    return Funcs[1];
+#endif
+  return NULL;
+}
+
+/*
+
+  Row hashing
+
+  Used to spot unchanged rows when MEMC.UpdateFlags aren't available. The
+  words are consumed 32 bytes at a time by four 64 bit lanes, in the style of
+  XXH3: each lane accumulates the data, plus the product of the two halves of
+  the data XORed with a key. That 32x32->64 multiply is a single instruction
+  per lane pair on SSE2 (pmuludq) and NEON (umlal), and all versions give the
+  same result.
+
+*/
+
+#define ROWHASH_PRIME1 UINT64_C(0x9E3779B185EBCA87)
+#define ROWHASH_PRIME2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define ROWHASH_PRIME3 UINT64_C(0x165667B19E3779F9)
+
+static const uint64_t rowhash_Key[4] = {
+  UINT64_C(0xbe4ba423396cfeb8), UINT64_C(0x1cad21f72c81017c),
+  UINT64_C(0xdb979083e96dd4de), UINT64_C(0x1f67b3b7a4a44072),
+};
+
+static inline uint64_t rowhash_Rotl(uint64_t x,int n)
+{
+  return (x << n) | (x >> (64-n));
+}
+
+#ifdef ROWCONV_X86
+static void rowhash_Stripes(uint64_t *acc,const ARMword *words,size_t stripes)
+{
+  __m128i acc0 = _mm_loadu_si128((const __m128i *) acc);
+  __m128i acc1 = _mm_loadu_si128((const __m128i *) (acc+2));
+  const __m128i key0 = _mm_loadu_si128((const __m128i *) rowhash_Key);
+  const __m128i key1 = _mm_loadu_si128((const __m128i *) (rowhash_Key+2));
+  while(stripes--)
+  {
+    __m128i d0 = _mm_loadu_si128((const __m128i *) words);
+    __m128i d1 = _mm_loadu_si128((const __m128i *) (words+4));
+    __m128i k0 = _mm_xor_si128(d0,key0);
+    __m128i k1 = _mm_xor_si128(d1,key1);
+    acc0 = _mm_add_epi64(acc0,_mm_add_epi64(d0,_mm_mul_epu32(k0,_mm_srli_epi64(k0,32))));
+    acc1 = _mm_add_epi64(acc1,_mm_add_epi64(d1,_mm_mul_epu32(k1,_mm_srli_epi64(k1,32))));
+    words += 8;
+  }
+  _mm_storeu_si128((__m128i *) acc,acc0);
+  _mm_storeu_si128((__m128i *) (acc+2),acc1);
+}
+#elif defined(ROWCONV_NEON)
+static void rowhash_Stripes(uint64_t *acc,const ARMword *words,size_t stripes)
+{
+  uint64x2_t acc0 = vld1q_u64(acc);
+  uint64x2_t acc1 = vld1q_u64(acc+2);
+  const uint64x2_t key0 = vld1q_u64(rowhash_Key);
+  const uint64x2_t key1 = vld1q_u64(rowhash_Key+2);
+  while(stripes--)
+  {
+    uint64x2_t d0 = vreinterpretq_u64_u32(vld1q_u32(words));
+    uint64x2_t d1 = vreinterpretq_u64_u32(vld1q_u32(words+4));
+    uint64x2_t k0 = veorq_u64(d0,key0);
+    uint64x2_t k1 = veorq_u64(d1,key1);
+    acc0 = vmlal_u32(vaddq_u64(acc0,d0),vmovn_u64(k0),vshrn_n_u64(k0,32));
+    acc1 = vmlal_u32(vaddq_u64(acc1,d1),vmovn_u64(k1),vshrn_n_u64(k1,32));
+    words += 8;
+  }
+  vst1q_u64(acc,acc0);
+  vst1q_u64(acc+2,acc1);
+}
+#else
+static void rowhash_Stripes(uint64_t *acc,const ARMword *words,size_t stripes)
+{
+  int i;
+  while(stripes--)
+  {
+    for(i=0;i<4;i++)
+    {
+      uint64_t data = words[i*2] | (((uint64_t) words[i*2+1])<<32);
+      uint64_t dk = data ^ rowhash_Key[i];
+      acc[i] += data + (dk & 0xffffffff)*(dk >> 32);
+    }
+    words += 8;
+  }
+}
+#endif
+
+uint64_t RowConv_Hash(const ARMword *words,size_t count,uint64_t seed)
+{
+  uint64_t acc[4];
+  uint64_t h;
+  size_t stripes = count/8;
+  int i;
+
+  acc[0] = seed + ROWHASH_PRIME1;
+  acc[1] = seed ^ ROWHASH_PRIME2;
+  acc[2] = seed - ROWHASH_PRIME3;
+  acc[3] = ~seed;
+  rowhash_Stripes(acc,words,stripes);
+  words += stripes*8;
+
+  h = seed ^ (count * ROWHASH_PRIME3);
+  for(i=0;i<4;i++)
+    h = rowhash_Rotl(h ^ (acc[i] * ROWHASH_PRIME2),31) * ROWHASH_PRIME1;
+  for(count -= stripes*8;count;count--)
+    h = rowhash_Rotl(h ^ (*words++ * ROWHASH_PRIME1),23) * ROWHASH_PRIME2;
+
+  /* Avalanche */
+  h ^= h >> 33;
+  h *= ROWHASH_PRIME2;
+  h ^= h >> 29;
+  h *= ROWHASH_PRIME3;
+  h ^= h >> 32;
+  return h;
+}
@@ -0,0 +1,61 @@
+/*
+  arch/rowconv.h
+
+  Part of Arcem released under the GNU GPL, see file COPYING
+  for details.
+
+  Vectorised conversion of screen memory into host pixels, for use by display
+  drivers which can write directly to the host framebuffer, and hashing of
+  screen memory
+*/
+#ifndef ROWCONV_H
+#define ROWCONV_H
+
+#include "../armdefs.h"
+
+/**
+ * RowConv_Func
+ *
+ * Convert a run of screen pixels into host colours.
+ *
+ * @param out      Destination for the host pixels
+ * @param RAM      Base of physical RAM
+ * @param Vptr     Bit offset of the first source pixel within RAM
+ * @param count    Number of source pixels to convert
+ * @param Palette  Host colours for each pixel value. At least 16 entries must
+ *                 be readable, even for 1bpp and 2bpp sources
+ * @param log2bpp  Source pixel depth; 0-3 for 1bpp to 8bpp
+ * @param scale    Number of host pixels to write per source pixel (1 or 2)
+ * @returns Address just after the last host pixel written
+ */
+typedef void *(*RowConv_Func)(void *out,const ARMword *RAM,uint32_t Vptr,
+                              unsigned int count,const void *Palette,
+                              int log2bpp,int scale);
+
+/**
+ * RowConv_Get
+ *
+ * Select the best converter for the host CPU. On first use this checks each
+ * vectorised converter for bit-exact output against the scalar code.
+ *
+ * @param hostbytes Size of a host colour; 2 or 4 bytes
+ * @returns Converter, or NULL if there's nothing faster than the display
+ *          driver's own code on this host
+ */
+RowConv_Func RowConv_Get(size_t hostbytes);
+
+/**
+ * RowConv_Hash
+ *
+ * Fast (non-cryptographic) hash of a run of words, for spotting rows of screen
+ * memory that haven't changed. Runs can be chained by passing one result in
+ * as the seed for the next.
+ *
+ * @param words Words to hash
+ * @param count Number of words
+ * @param seed  Starting value
+ * @returns 64 bit hash
+ */
+uint64_t RowConv_Hash(const ARMword *words,size_t count,uint64_t seed);
+
+#endif
@@ -7,7 +7,7 @@ typedef int16_t SoundData;
 
 extern int Sound_BatchSize; /* How many 16*2 sample batches to attempt to deliver to the platform code at once */
 extern CycleCount Sound_DMARate; /* How many cycles between DMA fetches */
-extern CycleDiff Sound_FudgeRate; /* Extra fudge factor applied to Sound_DMARate */
+extern CycleDiff Sound_FudgeRate; /* Extra fudge factor applied to Sound_DMARate, for hosts which don't report Sound_HostFill */
 
 typedef enum {
   Stereo_LeftRight, /* Data is ordered with left channel first */
@@ -25,6 +25,17 @@ extern void Sound_UpdateDMARate(ARMul_State *state);
 #ifdef SOUND_SUPPORT
 extern uint32_t Sound_HostRate; /* Rate of host sound system, in 1/1024 Hz. Must be set by host on init. */
 
+/* Optional stats about the host's buffering, for hosts that track them.
+   Hosts which set Sound_HostFill and Sound_HostCapacity have the sound DMA
+   rate controlled by newsound.c to keep the fill at the target latency. */
+extern int32_t Sound_HostFill; /* Stereo pairs waiting to be played, as of the last Sound_HostBuffered call, or -1 if unknown */
+extern int32_t Sound_HostCapacity; /* Max stereo pairs the host can queue */
+extern uint32_t Sound_HostUnderruns; /* Times the host ran out of data to play */
+extern uint32_t Sound_HostOverruns; /* Times the host had no room for more data */
+
+/* Log the state of the host buffering and the latency controller */
+extern void Sound_LogStats(void);
+
 /* These calls are made by DispKbdShared when the corresponding registers are updated */
 extern void Sound_SoundFreqUpdated(ARMul_State *state);
 extern void Sound_StereoUpdated(ARMul_State *state);
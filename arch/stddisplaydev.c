@@ -54,6 +54,8 @@
    SDD_RowsAtOnce
     - The number of source rows to process per update. This can be a non-const
       variable if you want, so it can be tweaked on the fly to tune performance
+    - With DisplayDev_Governor this is a minimum; the governor may decide to
+      process more rows at once
 
    SDD_Row
     - A data type that acts as an iterator/accessor for a screen row. It can be
@@ -95,32 +97,75 @@
     - Function to fill N adjacent pixels with the same colour. 'count' may be
       zero. Only called between BeginUpdate & EndUpdate.
 
+   SDD_DirectRow
+    - Optional. Define this if SDD_Row is a plain SDD_HostColour pointer into
+      the host framebuffer, and Host_WritePixel(s) simply store through it.
+      The driver can then use the vectorised converters from rowconv.c (where
+      the host CPU supports them) instead of writing pixels one at a time.
+
+   SDD_RenderThread
+    - Optional. Define this to have the pixel conversion done on a separate
+      (pthreads) thread. The event code then only captures the state of each
+      row as it's reached (DMA pointer, palette changes, border colour, etc.)
+      and queues it up for the render thread. The queue is drained at the end
+      of each frame, so Host_ChangeMode and Host_PollDisplay will never run
+      while rows are being drawn.
+    - Host_GetColour and the Host_*Row, Host_*Update, Host_SkipPixels and
+      Host_WritePixel(s) functions will be called from the render thread, so
+      must be safe to use while the emulator thread continues to run.
+    - Screen memory itself isn't captured, so a row may show data written by
+      the CPU after the row was reached. The UpdateFlags are captured, so such
+      rows will be redrawn again on the next frame.
+    - Rows which the UpdateFlags, RefreshFlags and border colour show to be
+      unchanged aren't queued at all. The rest are handed over in bands of
+      consecutive rows.
+
+   SDD_RenderThreads
+    - Optional, for use with SDD_RenderThread. The number of render threads to
+      start (up to ROWQUEUE_THREADS); bands are drawn in parallel when there's
+      more than one. This can be a variable, it's only read when the driver is
+      initialised. Defaults to 1.
+    - Each thread writes to different host rows, but the Host_* functions may
+      be called concurrently, so any state they share must cope with that.
+
    SDD_DisplayDev
     - The name to use for the const DisplayDev struct that will be generated
     
    SDD_Stats
-    - Define this to enable the stats code.
+    - Define this to dump the stats every 100 frames and on each mode change.
+      The counters are always kept, and can be dumped at any time by setting
+      DisplayDev_StatsRequested (or sending SIGUSR1, where available; SIGUSR2
+      is the register and memory dump in armarc.c).
 
 */
 
 
 
 
+#include <signal.h>
+
+#include "rowconv.h"
+#include "capture.h"
+#include "hosttime.h"
+#ifdef SDD_RenderThread
+#include <pthread.h>
+#endif
+
 /*
 
   Stats
 
-  Note - don't enable for more than one SDD instance at once, the symbol names it uses aren't unique
+  Each display instance keeps its own counters. Those updated by the row
+  rendering code live in the renderers, so the render threads never share
+  them, and get added together when the stats are dumped.
 
 */
 
-#ifdef SDD_Stats
-#define VIDEO_STAT(STAT,COND,AMT) if(COND) {vidstats[vidstat_##STAT] += AMT;}
-#else
-#define VIDEO_STAT(STAT,COND,AMT) ((void)0)
-#endif
+#define VIDEO_STAT(STAT,COND,AMT) if(COND) {DC.Stats[vidstat_##STAT] += AMT;}
+#define RENDER_STAT(STAT,COND,AMT) if(COND) {RD.Stats[vidstat_##STAT] += AMT;}
 
-#ifdef SDD_Stats
+#ifndef SDD_VIDSTATS
+#define SDD_VIDSTATS /* Shared by all SDD instances in this file */
 enum vidstat {
   vidstat_BorderRedraw,
   vidstat_BorderRedrawForced,
@@ -138,9 +183,21 @@ enum vidstat {
   vidstat_ForceRefreshBPP,
   vidstat_RefreshFlagsVinit,
   vidstat_RefreshFlagsPalette,
+  vidstat_RowSkipped,
+  vidstat_RowHashMatch,
+  vidstat_GovernorSkipUp,
+  vidstat_GovernorSkipDown,
+  vidstat_GovernorRowsUp,
+  vidstat_GovernorRowsDown,
+  vidstat_GovernorFlagsOff,
+  vidstat_GovernorFlagsOn,
+  vidstat_ConvertTime,
+  vidstat_PresentTime,
+  vidstat_DisplayTime,
+  vidstat_VSyncTime,
+  vidstat_HostBytes,
   vidstat_MAX,
 };
-static uint32_t vidstats[vidstat_MAX];
 static const char *vidstatnames[vidstat_MAX] = {
  "BorderRedraw: Total border redraws",
  "BorderRedrawForced: Total forced border redraws",
@@ -158,18 +215,96 @@ static const char *vidstatnames[vidstat_MAX] = {
  "ForceRefreshBPP: Frames where ForceRefresh was set due to BPP change",
  "RefreshFlagsVinit: Frames where RefreshFlags were set due to Vinit change",
  "RefreshFlagsPalette: Palette writes causing RefreshFlags to be set",
+ "RowSkipped: Unchanged rows that weren't queued for the render threads",
+ "RowHashMatch: Display rows skipped because their hash was unchanged",
+ "GovernorSkipUp: Times the governor increased the frameskip",
+ "GovernorSkipDown: Times the governor reduced the frameskip",
+ "GovernorRowsUp: Times the governor increased the rows per event",
+ "GovernorRowsDown: Times the governor reduced the rows per event",
+ "GovernorFlagsOff: Times the governor turned UpdateFlags off",
+ "GovernorFlagsOn: Times the governor turned UpdateFlags on",
+ "ConvertTime: Microseconds spent converting rows, over all renderers",
+ "PresentTime: Microseconds spent in Host_PollDisplay",
+ "DisplayTime: Microseconds spent in display events on the emulator thread",
+ "VSyncTime: Microseconds of DisplayTime spent in DisplayDev_VSync",
+ "HostBytes: Bytes uploaded to the host display (as reported by the host)",
 };
+#endif
 
-static void vidstats_Dump(const char *c)
-{
-  warn_vidc("%s\n",c);
-  int i;
-  for(i=0;i<vidstat_MAX;i++)
-  {
-    warn_vidc("%12u %s\n",vidstats[i],vidstatnames[i]);
-    vidstats[i] = 0;
-  }
-}
+/*
+
+  Row state
+
+  Everything the row rendering code needs to know about a row, captured by the
+  event code at the point the row is reached. Without SDD_RenderThread this
+  lives in HD.Renderer.Row and is rendered immediately; with it, rows are
+  queued up and copied into the Row of whichever render thread picks them up.
+
+*/
+
+#define ROWTYPE_BORDER 0
+#define ROWTYPE_DISPLAY 1
+#define ROWTYPE_DISPLAYNOFLAGS 2
+#define ROWTYPE_DISPLAYHASH 3 /* NOFLAGS, but skipped if the row hash matches */
+
+#ifdef SDD_RenderThread
+#define ROWQUEUE_SIZE 1024 /* Rows in the render queue; enough for a whole frame */
+#define ROWQUEUE_FLAGS 16 /* Max number of UpdateFlags that can be captured per row */
+#define ROWQUEUE_BAND 16 /* Rows handed to a render thread at once */
+#define ROWQUEUE_THREADS 8 /* Max number of render threads */
+#ifndef SDD_RenderThreads
+#define SDD_RenderThreads 1
+#endif
+#endif
+
+struct SDD_Name(RowState) {
+  int Row; /* Source row number */
+  int HostStart,HostEnd; /* Host rows to fill */
+  uint_least8_t Type; /* ROWTYPE_ value */
+  bool ForceRefresh; /* Value of DC.ForceRefresh */
+  bool Refresh; /* Whether the row's RefreshFlags bit was set */
+  uint_least16_t Palette[16]; /* VIDC palette */
+  uint32_t PaletteGen; /* Value of DC.PaletteGen */
+  SDD_HostColour BorderCol; /* Value of HD.BorderCol */
+  uint_fast16_t VIDC_CR; /* Value of DC.VIDC_CR */
+  uint32_t Vptr,Vstart,Vend; /* DMA pointer & bounds, in bits */
+  const uint32_t *UpdateFlags; /* MEMC.UpdateFlags, or a copy of them */
+#ifdef SDD_RenderThread
+  int NumFlags; /* Number of captured UpdateFlags, -1 if there were too many */
+  uint32_t FlagsOffset[ROWQUEUE_FLAGS];
+  uint32_t Flags[ROWQUEUE_FLAGS];
+#endif
+};
+
+/*
+
+  Renderer state
+
+  Values that must only be used by the row rendering code. With
+  SDD_RenderThread each render thread has its own copy, so that bands can be
+  drawn in parallel.
+
+*/
+
+struct SDD_Name(Renderer) {
+  struct SDD_Name(RowState) Row; /* Row currently being rendered */
+  uint_least16_t DirtyPalette; /* Bit flags of which Palette entries need rebuilding */
+  uint_least16_t VIDCPalette[16]; /* VIDC palette that Palette was built from */
+  uint32_t PaletteGen; /* DC.PaletteGen that Palette was built for */
+  uint32_t RowsRedrawn; /* Count of display rows that needed redrawing, for the governor */
+  uint64_t Stats[vidstat_MAX]; /* Counters for RENDER_STAT */
+  SDD_HostColour Palette[256]; /* Host palette */
+#ifdef SDD_RenderThread
+  uint32_t RowFlags[(512*1024)/UPDATEBLOCKSIZE]; /* MEMC.UpdateFlags, as captured for the current row */
+#endif
+};
+
+#ifdef SDD_RenderThread
+struct SDD_Name(RenderWorker) {
+  ARMul_State *state;
+  pthread_t Thread;
+  struct SDD_Name(Renderer) Renderer;
+};
 #endif
 
 /*
@@ -191,6 +326,7 @@ struct SDD_Name(DisplayInfo) {
     /* Values which get updated by VIDCPutVal */
 
     uint_least16_t DirtyPalette; /* Bit flags of which palette entries have been modified */
+    uint32_t PaletteGen; /* Incremented whenever the renderers must rebuild their whole palette */
     bool ModeChanged; /* Set if any registers change which may require the host to change mode. Remains set until valid mode is available from host (suspends all display output) */
 
     /* Values that must only get updated by the event queue/screen blit code */
@@ -199,6 +335,7 @@ struct SDD_Name(DisplayInfo) {
     bool DMAEn; /* Whether video DMA is enabled for this frame */
     bool FLYBK; /* Flyback signal (i.e. whether we've triggered VSync IRQ this frame) */ 
     int LastHostWidth,LastHostHeight,LastHostHz; /* Values we used to request host mode */
+    uint32_t RateNum,RateDen; /* Exact frame rate of the current mode, RateNum/RateDen Hz */
     int LastRow; /* Row last event was scheduled to run up to */
     int NextRow; /* Row next event is scheduled to run up to */
     int MaxRow; /* Row to stop at for this frame */
@@ -208,10 +345,28 @@ struct SDD_Name(DisplayInfo) {
     uint32_t LastVinit; /* Last Vinit, so we can sync changes with the frame start */
     int FrameSkip; /* Current frame skip counter */
 
+    int RowsAtOnce; /* Number of rows to process per RowStart event */
+
     /* DisplayDev_AutoUpdateFlags logic */
 
     int Auto_FrameCount; /* How many frames have passed */
     int Auto_ForceRefresh; /* How many frames caused a forced refresh */
+
+    /* DisplayDev_Governor logic. Times are in microseconds */
+
+    int Gov_Frames; /* How many frames have passed this period, -1 to start a new period */
+    int Gov_Drawn; /* How many frames were drawn (i.e. not skipped) */
+    int Gov_FlagsWait; /* Periods until UpdateFlags are retried */
+    int Gov_FlagsBackoff; /* Value for Gov_FlagsWait when UpdateFlags are next turned off */
+    uint32_t Gov_Rows; /* How many display rows were processed */
+    CycleCount Gov_StartCycle; /* ARMul_Time at start of period */
+    uint64_t Gov_StartTime; /* Host time at start of period */
+    uint64_t Gov_DisplayTime; /* Host time spent in the display code */
+    uint64_t Gov_VSyncTime; /* Host time spent in DisplayDev_VSync (which includes speed governor sleeps) */
+    int Gov_RowsAtOnce; /* Governor's choice for RowsAtOnce */
+    bool Gov_ForceRefresh; /* Governor has switched UpdateFlags, so the next frame must be redrawn in full */
+
+    uint64_t Stats[vidstat_MAX]; /* Counters for VIDEO_STAT */
   } Control;
 
   struct {
@@ -221,11 +376,36 @@ struct SDD_Name(DisplayInfo) {
     /* The core handles these */
     int XOffset,YOffset; /* X & Y offset of first display pixel in host */
     SDD_HostColour BorderCol; /* VIDC.Border colour in host format */ 
-    SDD_HostColour Palette[256]; /* Host palette */
-    SDD_HostColour BorderCols[1024]; /* Last border colour used for each scanline */
     uint32_t RefreshFlags[1024/32]; /* Bit flags of which display scanlines need full refresh due to Vstart/Vend/palette changes */
+
+    /* Values that must only be used by the row rendering code (which may be
+       running on the render threads). Each row is only drawn by one thread,
+       so the per-row values can be shared */
+
+    struct SDD_Name(Renderer) Renderer; /* Renderer used on the emulator thread */
+#ifdef SDD_DirectRow
+    RowConv_Func RowConv; /* Vectorised row converter, if available */
+#endif
+    SDD_HostColour BorderCols[1024]; /* Last border colour used for each scanline */
+    uint64_t RowHashes[1024]; /* Hash of the source data & palette last drawn on each scanline, for DisplayDev_UseRowHashes. Only updated while UpdateFlags are off, so every switch to flags off must force a full refresh */
     uint32_t UpdateFlags[1024][(512*1024)/UPDATEBLOCKSIZE]; /* Flags for each scanline (8MB of flags - ouch!) */
   } HostDisplay;
+
+#ifdef SDD_RenderThread
+  struct {
+    int NumThreads; /* Number of render threads running */
+    bool Quit; /* Set to make the render threads exit */
+    pthread_mutex_t Mutex; /* Protects Next, Done, Tail & Quit */
+    pthread_cond_t Queued; /* Signalled when rows are queued, or on Quit */
+    pthread_cond_t Drawn; /* Signalled when all queued rows have been drawn */
+    uint32_t Next; /* Index of next row for a render thread to pick up */
+    uint32_t Done; /* Count of rows drawn */
+    uint32_t Tail; /* Count of rows queued */
+    uint32_t Captured; /* Count of rows captured; only used by the emulator thread */
+    struct SDD_Name(RowState) Queue[ROWQUEUE_SIZE];
+    struct SDD_Name(RenderWorker) Threads[ROWQUEUE_THREADS];
+  } Render;
+#endif
 };
 
 
@@ -260,6 +440,18 @@ struct SDD_Name(DisplayInfo) {
 #endif
 #define HD HOSTDISPLAY
 
+#ifdef RD
+#undef RD
+#endif
+#define RD (*rd)
+
+#ifdef SDD_RenderThread
+#ifdef RENDER
+#undef RENDER
+#endif
+#define RENDER (DISPLAYINFO.Render)
+#endif
+
 #define VideoRelUpdateAndForce(flag, writeto, from) \
 {\
   if ((writeto) != (from)) { \
@@ -275,36 +467,36 @@ struct SDD_Name(DisplayInfo) {
 
 */
 
-static inline void SDD_Name(PaletteUpdate)(ARMul_State *state,SDD_HostColour *Palette,int num)
+static inline void SDD_Name(PaletteUpdate)(ARMul_State *state,struct SDD_Name(Renderer) *rd,SDD_HostColour *Palette,int num)
 {
   /* Might be better if caller does this check? */
-  if(DC.DirtyPalette)
+  if(RD.DirtyPalette)
   {
     int i;
     for(i=0;i<num;i++)
     {
-      if(DC.DirtyPalette & (1<<i))
+      if(RD.DirtyPalette & (1<<i))
       {
-        Palette[i] = SDD_Name(Host_GetColour)(state,VIDC.Palette[i]);
+        Palette[i] = SDD_Name(Host_GetColour)(state,RD.VIDCPalette[i]);
       }
     }
-    DC.DirtyPalette = 0;
+    RD.DirtyPalette = 0;
   }
 }
 
-static inline void SDD_Name(PaletteUpdate8bpp)(ARMul_State *state,SDD_HostColour *Palette)
+static inline void SDD_Name(PaletteUpdate8bpp)(ARMul_State *state,struct SDD_Name(Renderer) *rd,SDD_HostColour *Palette)
 {
   /* Might be better if caller does this check? */
-  if(DC.DirtyPalette)
+  if(RD.DirtyPalette)
   {
     int i;
     for(i=0;i<16;i++)
     {
-      if(DC.DirtyPalette & (1<<i))
+      if(RD.DirtyPalette & (1<<i))
       {
         int j;
         /* Deal with the funky 8bpp palette */
-        uint_fast16_t Base = VIDC.Palette[i] & 0x1737; /* Only these bits of the palette entry are used in 8bpp modes */
+        uint_fast16_t Base = RD.VIDCPalette[i] & 0x1737; /* Only these bits of the palette entry are used in 8bpp modes */
         static const uint_least16_t ExtraPal[16] = {
           0x000, 0x008, 0x040, 0x048, 0x080, 0x088, 0x0c0, 0x0c8,
           0x800, 0x808, 0x840, 0x848, 0x880, 0x888, 0x8c0, 0x8c8
@@ -315,7 +507,7 @@ static inline void SDD_Name(PaletteUpdate8bpp)(ARMul_State *state,SDD_HostColour
         }
       }
     }
-    DC.DirtyPalette = 0;
+    RD.DirtyPalette = 0;
   }
 }
 
@@ -329,9 +521,9 @@ static inline void SDD_Name(PaletteUpdate8bpp)(ARMul_State *state,SDD_HostColour
    'drow' is expected to already be pointing to the start of the display area
    Returns non-zero if the row was updated
 */
-typedef int (*SDD_Name(RowFunc))(ARMul_State *state,int row,SDD_Row drow,int flags);
+typedef int (*SDD_Name(RowFunc))(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow,int flags);
 /* Alternate version for when UpdateFlags are disabled */
-typedef void (*SDD_Name(RowFuncNoFlags))(ARMul_State *state,int row,SDD_Row drow);
+typedef void (*SDD_Name(RowFuncNoFlags))(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow);
 
 
 #define ROWFUNC_FORCE 0x1 /* Force row to be fully redrawn */
@@ -347,20 +539,20 @@ typedef void (*SDD_Name(RowFuncNoFlags))(ARMul_State *state,int row,SDD_Row drow
 
 */
 
-static int SDD_Name(RowFunc1bpp1X)(ARMul_State *state,int row,SDD_Row drow,int flags)
+static int SDD_Name(RowFunc1bpp1X)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow,int flags)
 {
   int i, Remaining, startRemain;
   uint32_t Vptr, Vstart, Vend, startVptr;
   const ARMword *RAM;
   const uint32_t *MEMC_UpdateFlags;
   uint32_t *HD_UpdateFlags;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate)(state,Palette,2);
+  SDD_Name(PaletteUpdate)(state,rd,Palette,2);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth;
 
@@ -373,7 +565,7 @@ static int SDD_Name(RowFunc1bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
   /* Process the row */
   startVptr = Vptr;
   startRemain = Remaining;
-  MEMC_UpdateFlags = MEMC.UpdateFlags;
+  MEMC_UpdateFlags = RD.Row.UpdateFlags;
   HD_UpdateFlags = HD.UpdateFlags[row];
   while(Remaining > 0)
   {
@@ -384,25 +576,32 @@ static int SDD_Name(RowFunc1bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
     {
       const ARMword *In;
       ARMword Bit, Data;
-      VIDEO_STAT(DisplayRedraw,1,1);
-      VIDEO_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
-      VIDEO_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
-      VIDEO_STAT(DisplayBits,1,Available);
+      RENDER_STAT(DisplayRedraw,1,1);
+      RENDER_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
+      RENDER_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
+      RENDER_STAT(DisplayBits,1,Available);
       flags |= ROWFUNC_UPDATED;
       /* Process the pixels in this region, stopping at end of row/update block/Vend */
       SDD_Name(Host_BeginUpdate)(state,&drow,Available);
-      In = RAM+(Vptr>>5);
-      Bit = 1<<(Vptr & 31);
-      Data = *In++;
-      for(i=0;i<Available;i++)
+#ifdef SDD_DirectRow
+      if(HD.RowConv)
+        drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available,Palette,0,1);
+      else
+#endif
       {
-        int idx = (Data & Bit)?1:0;
-        SDD_Name(Host_WritePixel)(state,&drow,Palette[idx]);
-        Bit <<= 1;
-        if(!Bit)
+        In = RAM+(Vptr>>5);
+        Bit = 1<<(Vptr & 31);
+        Data = *In++;
+        for(i=0;i<Available;i++)
         {
-          Bit = 1;
-          Data = *In++;
+          int idx = (Data & Bit)?1:0;
+          SDD_Name(Host_WritePixel)(state,&drow,Palette[idx]);
+          Bit <<= 1;
+          if(!Bit)
+          {
+            Bit = 1;
+            Data = *In++;
+          }
         }
       }
       SDD_Name(Host_EndUpdate)(state,&drow);
@@ -415,7 +614,7 @@ static int SDD_Name(RowFunc1bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
         
   /* If we updated anything, copy over the updated flags (Done last in case the same flags block is encountered multiple times in the same row) */
   if((flags & (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS)) == (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS))
@@ -439,20 +638,20 @@ static int SDD_Name(RowFunc1bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
   return (flags & ROWFUNC_UPDATED);
 }
 
-static int SDD_Name(RowFunc2bpp1X)(ARMul_State *state,int row,SDD_Row drow,int flags)
+static int SDD_Name(RowFunc2bpp1X)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow,int flags)
 {
   int i, Remaining, startRemain;
   uint32_t Vptr, Vstart, Vend, startVptr;
   const ARMword *RAM;
   const uint32_t *MEMC_UpdateFlags;
   uint32_t *HD_UpdateFlags;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate)(state,Palette,4);
+  SDD_Name(PaletteUpdate)(state,rd,Palette,4);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth*2; /* Scale up to account for everything else counting in bits */
 
@@ -465,7 +664,7 @@ static int SDD_Name(RowFunc2bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
   /* Process the row */
   startVptr = Vptr;
   startRemain = Remaining;
-  MEMC_UpdateFlags = MEMC.UpdateFlags;
+  MEMC_UpdateFlags = RD.Row.UpdateFlags;
   HD_UpdateFlags = HD.UpdateFlags[row];
   while(Remaining > 0)
   {
@@ -478,25 +677,32 @@ static int SDD_Name(RowFunc2bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
       const ARMword *In;
       uint32_t Shift;
       ARMword Data;
-      VIDEO_STAT(DisplayRedraw,1,1);
-      VIDEO_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
-      VIDEO_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
-      VIDEO_STAT(DisplayBits,1,Available);
+      RENDER_STAT(DisplayRedraw,1,1);
+      RENDER_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
+      RENDER_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
+      RENDER_STAT(DisplayBits,1,Available);
       flags |= ROWFUNC_UPDATED;
       /* Process the pixels in this region, stopping at end of row/update block/Vend */
       SDD_Name(Host_BeginUpdate)(state,&drow,Available>>1);
-      In = RAM+(Vptr>>5);
-      Shift = (Vptr & 31);
-      Data = (*In++) >> Shift;
-      for(i=0;i<Available;i+=2)
+#ifdef SDD_DirectRow
+      if(HD.RowConv)
+        drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available>>1,Palette,1,1);
+      else
+#endif
       {
-        SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 3]);
-        Data >>= 2;
-        Shift += 2;
-        if(Shift == 32)
+        In = RAM+(Vptr>>5);
+        Shift = (Vptr & 31);
+        Data = (*In++) >> Shift;
+        for(i=0;i<Available;i+=2)
         {
-          Shift = 0;
-          Data = *In++;
+          SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 3]);
+          Data >>= 2;
+          Shift += 2;
+          if(Shift == 32)
+          {
+            Shift = 0;
+            Data = *In++;
+          }
         }
       }
       SDD_Name(Host_EndUpdate)(state,&drow);
@@ -509,7 +715,7 @@ static int SDD_Name(RowFunc2bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
         
   /* If we updated anything, copy over the updated flags (Done last in case the same flags block is encountered multiple times in the same row) */
   if((flags & (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS)) == (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS))
@@ -533,20 +739,20 @@ static int SDD_Name(RowFunc2bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
   return (flags & ROWFUNC_UPDATED);
 }
 
-static int SDD_Name(RowFunc4bpp1X)(ARMul_State *state,int row,SDD_Row drow,int flags)
+static int SDD_Name(RowFunc4bpp1X)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow,int flags)
 {
   int i, Remaining, startRemain;
   uint32_t Vptr, Vstart, Vend, startVptr;
   const ARMword *RAM;
   const uint32_t *MEMC_UpdateFlags;
   uint32_t *HD_UpdateFlags;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate)(state,Palette,16);
+  SDD_Name(PaletteUpdate)(state,rd,Palette,16);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth*4; /* Scale up to account for everything else counting in bits */
 
@@ -559,7 +765,7 @@ static int SDD_Name(RowFunc4bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
   /* Process the row */
   startVptr = Vptr;
   startRemain = Remaining;
-  MEMC_UpdateFlags = MEMC.UpdateFlags;
+  MEMC_UpdateFlags = RD.Row.UpdateFlags;
   HD_UpdateFlags = HD.UpdateFlags[row];
   while(Remaining > 0)
   {
@@ -572,30 +778,37 @@ static int SDD_Name(RowFunc4bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
       const ARMword *In;
       uint32_t Shift;
       ARMword Data;
-      VIDEO_STAT(DisplayRedraw,1,1);
-      VIDEO_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
-      VIDEO_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
-      VIDEO_STAT(DisplayBits,1,Available);
+      RENDER_STAT(DisplayRedraw,1,1);
+      RENDER_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
+      RENDER_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
+      RENDER_STAT(DisplayBits,1,Available);
       flags |= ROWFUNC_UPDATED;
       /* Process the pixels in this region, stopping at end of row/update block/Vend */
       SDD_Name(Host_BeginUpdate)(state,&drow,Available>>2);
 
       /* Display will always be a multiple of 2 pixels wide, so we can simplify things a bit compared to 1/2bpp case */
-      In = RAM+(Vptr>>5);      
-      Shift = (Vptr & 31);
-      Data = (*In++) >> Shift;
-      for(i=0;i<Available;i+=8)
+#ifdef SDD_DirectRow
+      if(HD.RowConv)
+        drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available>>2,Palette,2,1);
+      else
+#endif
       {
-        SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xf]);
-        Data >>= 4;
-        SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xf]);
-        Data >>= 4;
-        Shift += 8;
-        if(Shift == 32)
+        In = RAM+(Vptr>>5);      
+        Shift = (Vptr & 31);
+        Data = (*In++) >> Shift;
+        for(i=0;i<Available;i+=8)
         {
-          Shift = 0;
-          Data = *In++;
-        }        
+          SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xf]);
+          Data >>= 4;
+          SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xf]);
+          Data >>= 4;
+          Shift += 8;
+          if(Shift == 32)
+          {
+            Shift = 0;
+            Data = *In++;
+          }        
+        }
       }
       SDD_Name(Host_EndUpdate)(state,&drow);
     }
@@ -607,7 +820,7 @@ static int SDD_Name(RowFunc4bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
         
   /* If we updated anything, copy over the updated flags (Done last in case the same flags block is encountered multiple times in the same row) */
   if((flags & (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS)) == (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS))
@@ -631,20 +844,20 @@ static int SDD_Name(RowFunc4bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
   return (flags & ROWFUNC_UPDATED);
 }
 
-static int SDD_Name(RowFunc8bpp1X)(ARMul_State *state,int row,SDD_Row drow,int flags)
+static int SDD_Name(RowFunc8bpp1X)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow,int flags)
 {
   int i, Remaining, startRemain;
   uint32_t Vptr, Vstart, Vend, startVptr;
   const ARMword *RAM;
   const uint32_t *MEMC_UpdateFlags;
   uint32_t *HD_UpdateFlags;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate8bpp)(state,Palette);
+  SDD_Name(PaletteUpdate8bpp)(state,rd,Palette);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth*8; /* Scale up to account for everything else counting in bits */
 
@@ -657,7 +870,7 @@ static int SDD_Name(RowFunc8bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
   /* Process the row */
   startVptr = Vptr;
   startRemain = Remaining;
-  MEMC_UpdateFlags = MEMC.UpdateFlags;
+  MEMC_UpdateFlags = RD.Row.UpdateFlags;
   HD_UpdateFlags = HD.UpdateFlags[row];
   while(Remaining > 0)
   {
@@ -670,32 +883,39 @@ static int SDD_Name(RowFunc8bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
       const ARMword *In;
       uint32_t Shift;
       ARMword Data;
-      VIDEO_STAT(DisplayRedraw,1,1);
-      VIDEO_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
-      VIDEO_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
-      VIDEO_STAT(DisplayBits,1,Available);
+      RENDER_STAT(DisplayRedraw,1,1);
+      RENDER_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
+      RENDER_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
+      RENDER_STAT(DisplayBits,1,Available);
       flags |= ROWFUNC_UPDATED;
       /* Process the pixels in this region, stopping at end of row/update block/Vend */
       SDD_Name(Host_BeginUpdate)(state,&drow,Available>>3);
 
       /* Display will always be a multiple of 2 pixels wide, so we can simplify things a bit compared to 1/2bpp case */
-      In = RAM+(Vptr>>5);
-      Shift = (Vptr & 31);
-      Data = (*In++) >> Shift;
-      for(i=0;i<Available;i+=16)
+#ifdef SDD_DirectRow
+      if(HD.RowConv)
+        drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available>>3,Palette,3,1);
+      else
+#endif
       {
-        SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xff]);
-        Data >>= 8;
-        SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xff]);
-        if(Shift)
-        {
-          Shift = 0;
-          Data = *In++;
-        }
-        else
+        In = RAM+(Vptr>>5);
+        Shift = (Vptr & 31);
+        Data = (*In++) >> Shift;
+        for(i=0;i<Available;i+=16)
         {
-          Shift = 16;
+          SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xff]);
           Data >>= 8;
+          SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xff]);
+          if(Shift)
+          {
+            Shift = 0;
+            Data = *In++;
+          }
+          else
+          {
+            Shift = 16;
+            Data >>= 8;
+          }
         }
       }
       SDD_Name(Host_EndUpdate)(state,&drow);
@@ -708,7 +928,7 @@ static int SDD_Name(RowFunc8bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
         
   /* If we updated anything, copy over the updated flags (Done last in case the same flags block is encountered multiple times in the same row) */
   if((flags & (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS)) == (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS))
@@ -740,20 +960,20 @@ static int SDD_Name(RowFunc8bpp1X)(ARMul_State *state,int row,SDD_Row drow,int f
 
 */
 
-static int SDD_Name(RowFunc1bpp2X)(ARMul_State *state,int row,SDD_Row drow,int flags)
+static int SDD_Name(RowFunc1bpp2X)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow,int flags)
 {
   int i, Remaining, startRemain;
   uint32_t Vptr, Vstart, Vend, startVptr;
   const ARMword *RAM;
   const uint32_t *MEMC_UpdateFlags;
   uint32_t *HD_UpdateFlags;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate)(state,Palette,2);
+  SDD_Name(PaletteUpdate)(state,rd,Palette,2);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth;
 
@@ -766,7 +986,7 @@ static int SDD_Name(RowFunc1bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
   /* Process the row */
   startVptr = Vptr;
   startRemain = Remaining;
-  MEMC_UpdateFlags = MEMC.UpdateFlags;
+  MEMC_UpdateFlags = RD.Row.UpdateFlags;
   HD_UpdateFlags = HD.UpdateFlags[row];
   while(Remaining > 0)
   {
@@ -777,25 +997,32 @@ static int SDD_Name(RowFunc1bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
     {
       const ARMword *In;
       ARMword Bit, Data;
-      VIDEO_STAT(DisplayRedraw,1,1);
-      VIDEO_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
-      VIDEO_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
-      VIDEO_STAT(DisplayBits,1,Available);
+      RENDER_STAT(DisplayRedraw,1,1);
+      RENDER_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
+      RENDER_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
+      RENDER_STAT(DisplayBits,1,Available);
       flags |= ROWFUNC_UPDATED;
       /* Process the pixels in this region, stopping at end of row/update block/Vend */
       SDD_Name(Host_BeginUpdate)(state,&drow,Available<<1);
-      In = RAM+(Vptr>>5);
-      Bit = 1<<(Vptr & 31);
-      Data = *In++;
-      for(i=0;i<Available;i++)
+#ifdef SDD_DirectRow
+      if(HD.RowConv)
+        drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available,Palette,0,2);
+      else
+#endif
       {
-        int idx = (Data & Bit)?1:0;
-        SDD_Name(Host_WritePixels)(state,&drow,Palette[idx],2);
-        Bit <<= 1;
-        if(!Bit)
+        In = RAM+(Vptr>>5);
+        Bit = 1<<(Vptr & 31);
+        Data = *In++;
+        for(i=0;i<Available;i++)
         {
-          Bit = 1;
-          Data = *In++;
+          int idx = (Data & Bit)?1:0;
+          SDD_Name(Host_WritePixels)(state,&drow,Palette[idx],2);
+          Bit <<= 1;
+          if(!Bit)
+          {
+            Bit = 1;
+            Data = *In++;
+          }
         }
       }
       SDD_Name(Host_EndUpdate)(state,&drow);
@@ -808,7 +1035,7 @@ static int SDD_Name(RowFunc1bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
         
   /* If we updated anything, copy over the updated flags (Done last in case the same flags block is encountered multiple times in the same row) */
   if((flags & (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS)) == (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS))
@@ -832,20 +1059,20 @@ static int SDD_Name(RowFunc1bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
   return (flags & ROWFUNC_UPDATED);
 }
 
-static int SDD_Name(RowFunc2bpp2X)(ARMul_State *state,int row,SDD_Row drow,int flags)
+static int SDD_Name(RowFunc2bpp2X)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow,int flags)
 {
   int i, Remaining, startRemain;
   uint32_t Vptr, Vstart, Vend, startVptr;
   const ARMword *RAM;
   const uint32_t *MEMC_UpdateFlags;
   uint32_t *HD_UpdateFlags;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate)(state,Palette,4);
+  SDD_Name(PaletteUpdate)(state,rd,Palette,4);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth*2; /* Scale up to account for everything else counting in bits */
 
@@ -858,7 +1085,7 @@ static int SDD_Name(RowFunc2bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
   /* Process the row */
   startVptr = Vptr;
   startRemain = Remaining;
-  MEMC_UpdateFlags = MEMC.UpdateFlags;
+  MEMC_UpdateFlags = RD.Row.UpdateFlags;
   HD_UpdateFlags = HD.UpdateFlags[row];
   while(Remaining > 0)
   {
@@ -871,25 +1098,32 @@ static int SDD_Name(RowFunc2bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
       const ARMword *In;
       uint32_t Shift;
       ARMword Data;
-      VIDEO_STAT(DisplayRedraw,1,1);
-      VIDEO_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
-      VIDEO_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
-      VIDEO_STAT(DisplayBits,1,Available);
+      RENDER_STAT(DisplayRedraw,1,1);
+      RENDER_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
+      RENDER_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
+      RENDER_STAT(DisplayBits,1,Available);
       flags |= ROWFUNC_UPDATED;
       /* Process the pixels in this region, stopping at end of row/update block/Vend */
       SDD_Name(Host_BeginUpdate)(state,&drow,Available);
-      In = RAM+(Vptr>>5);
-      Shift = (Vptr & 31);
-      Data = (*In++) >> Shift;
-      for(i=0;i<Available;i+=2)
+#ifdef SDD_DirectRow
+      if(HD.RowConv)
+        drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available>>1,Palette,1,2);
+      else
+#endif
       {
-        SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 3],2);
-        Data >>= 2;
-        Shift += 2;
-        if(Shift == 32)
+        In = RAM+(Vptr>>5);
+        Shift = (Vptr & 31);
+        Data = (*In++) >> Shift;
+        for(i=0;i<Available;i+=2)
         {
-          Shift = 0;
-          Data = *In++;
+          SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 3],2);
+          Data >>= 2;
+          Shift += 2;
+          if(Shift == 32)
+          {
+            Shift = 0;
+            Data = *In++;
+          }
         }
       }
       SDD_Name(Host_EndUpdate)(state,&drow);
@@ -902,7 +1136,7 @@ static int SDD_Name(RowFunc2bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
         
   /* If we updated anything, copy over the updated flags (Done last in case the same flags block is encountered multiple times in the same row) */
   if((flags & (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS)) == (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS))
@@ -926,20 +1160,20 @@ static int SDD_Name(RowFunc2bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
   return (flags & ROWFUNC_UPDATED);
 }
 
-static int SDD_Name(RowFunc4bpp2X)(ARMul_State *state,int row,SDD_Row drow,int flags)
+static int SDD_Name(RowFunc4bpp2X)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow,int flags)
 {
   int i, Remaining, startRemain;
   uint32_t Vptr, Vstart, Vend, startVptr;
   const ARMword *RAM;
   const uint32_t *MEMC_UpdateFlags;
   uint32_t *HD_UpdateFlags;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate)(state,Palette,16);
+  SDD_Name(PaletteUpdate)(state,rd,Palette,16);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth*4; /* Scale up to account for everything else counting in bits */
 
@@ -952,7 +1186,7 @@ static int SDD_Name(RowFunc4bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
   /* Process the row */
   startVptr = Vptr;
   startRemain = Remaining;
-  MEMC_UpdateFlags = MEMC.UpdateFlags;
+  MEMC_UpdateFlags = RD.Row.UpdateFlags;
   HD_UpdateFlags = HD.UpdateFlags[row];
   while(Remaining > 0)
   {
@@ -965,30 +1199,37 @@ static int SDD_Name(RowFunc4bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
       const ARMword *In;
       uint32_t Shift;
       ARMword Data;
-      VIDEO_STAT(DisplayRedraw,1,1);
-      VIDEO_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
-      VIDEO_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
-      VIDEO_STAT(DisplayBits,1,Available);
+      RENDER_STAT(DisplayRedraw,1,1);
+      RENDER_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
+      RENDER_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
+      RENDER_STAT(DisplayBits,1,Available);
       flags |= ROWFUNC_UPDATED;
       /* Process the pixels in this region, stopping at end of row/update block/Vend */
       SDD_Name(Host_BeginUpdate)(state,&drow,Available>>1);
 
       /* Display will always be a multiple of 2 pixels wide, so we can simplify things a bit compared to 1/2bpp case */
-      In = RAM+(Vptr>>5);      
-      Shift = (Vptr & 31);
-      Data = (*In++) >> Shift;
-      for(i=0;i<Available;i+=8)
+#ifdef SDD_DirectRow
+      if(HD.RowConv)
+        drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available>>2,Palette,2,2);
+      else
+#endif
       {
-        SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xf],2);
-        Data >>= 4;
-        SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xf],2);
-        Data >>= 4;
-        Shift += 8;
-        if(Shift == 32)
+        In = RAM+(Vptr>>5);      
+        Shift = (Vptr & 31);
+        Data = (*In++) >> Shift;
+        for(i=0;i<Available;i+=8)
         {
-          Shift = 0;
-          Data = *In++;
-        }        
+          SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xf],2);
+          Data >>= 4;
+          SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xf],2);
+          Data >>= 4;
+          Shift += 8;
+          if(Shift == 32)
+          {
+            Shift = 0;
+            Data = *In++;
+          }        
+        }
       }
       SDD_Name(Host_EndUpdate)(state,&drow);
     }
@@ -1000,7 +1241,7 @@ static int SDD_Name(RowFunc4bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
         
   /* If we updated anything, copy over the updated flags (Done last in case the same flags block is encountered multiple times in the same row) */
   if((flags & (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS)) == (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS))
@@ -1024,20 +1265,20 @@ static int SDD_Name(RowFunc4bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
   return (flags & ROWFUNC_UPDATED);
 }
 
-static int SDD_Name(RowFunc8bpp2X)(ARMul_State *state,int row,SDD_Row drow,int flags)
+static int SDD_Name(RowFunc8bpp2X)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow,int flags)
 {
   int i, Remaining, startRemain;
   uint32_t Vptr, Vstart, Vend, startVptr;
   const ARMword *RAM;
   const uint32_t *MEMC_UpdateFlags;
   uint32_t *HD_UpdateFlags;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate8bpp)(state,Palette);
+  SDD_Name(PaletteUpdate8bpp)(state,rd,Palette);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth*8; /* Scale up to account for everything else counting in bits */
 
@@ -1050,7 +1291,7 @@ static int SDD_Name(RowFunc8bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
   /* Process the row */
   startVptr = Vptr;
   startRemain = Remaining;
-  MEMC_UpdateFlags = MEMC.UpdateFlags;
+  MEMC_UpdateFlags = RD.Row.UpdateFlags;
   HD_UpdateFlags = HD.UpdateFlags[row];
   while(Remaining > 0)
   {
@@ -1063,32 +1304,39 @@ static int SDD_Name(RowFunc8bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
       const ARMword *In;
       uint32_t Shift;
       ARMword Data;
-      VIDEO_STAT(DisplayRedraw,1,1);
-      VIDEO_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
-      VIDEO_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
-      VIDEO_STAT(DisplayBits,1,Available);
+      RENDER_STAT(DisplayRedraw,1,1);
+      RENDER_STAT(DisplayRedrawForced,(flags & ROWFUNC_FORCE),1);
+      RENDER_STAT(DisplayRedrawUpdated,(HD_UpdateFlags[FlagsOffset] != MEMC_UpdateFlags[FlagsOffset]),1);
+      RENDER_STAT(DisplayBits,1,Available);
       flags |= ROWFUNC_UPDATED;
       /* Process the pixels in this region, stopping at end of row/update block/Vend */
       SDD_Name(Host_BeginUpdate)(state,&drow,Available>>2);
 
       /* Display will always be a multiple of 2 pixels wide, so we can simplify things a bit compared to 1/2bpp case */
-      In = RAM+(Vptr>>5);
-      Shift = (Vptr & 31);
-      Data = (*In++) >> Shift;
-      for(i=0;i<Available;i+=16)
+#ifdef SDD_DirectRow
+      if(HD.RowConv)
+        drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available>>3,Palette,3,2);
+      else
+#endif
       {
-        SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xff],2);
-        Data >>= 8;
-        SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xff],2);
-        if(Shift)
+        In = RAM+(Vptr>>5);
+        Shift = (Vptr & 31);
+        Data = (*In++) >> Shift;
+        for(i=0;i<Available;i+=16)
         {
-          Shift = 0;
-          Data = *In++;
-        }
-        else
-        {
-          Shift = 16;
+          SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xff],2);
           Data >>= 8;
+          SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xff],2);
+          if(Shift)
+          {
+            Shift = 0;
+            Data = *In++;
+          }
+          else
+          {
+            Shift = 16;
+            Data >>= 8;
+          }
         }
       }
       SDD_Name(Host_EndUpdate)(state,&drow);
@@ -1101,7 +1349,7 @@ static int SDD_Name(RowFunc8bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
         
   /* If we updated anything, copy over the updated flags (Done last in case the same flags block is encountered multiple times in the same row) */
   if((flags & (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS)) == (ROWFUNC_UPDATED | ROWFUNC_UPDATEFLAGS))
@@ -1133,18 +1381,18 @@ static int SDD_Name(RowFunc8bpp2X)(ARMul_State *state,int row,SDD_Row drow,int f
 
 */
 
-static void SDD_Name(RowFunc1bpp1XNoFlags)(ARMul_State *state,int row,SDD_Row drow)
+static void SDD_Name(RowFunc1bpp1XNoFlags)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow)
 {
   int i, Remaining;
   uint32_t Vptr, Vstart, Vend;
   const ARMword *RAM;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate)(state,Palette,2);
+  SDD_Name(PaletteUpdate)(state,rd,Palette,2);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth;
 
@@ -1161,21 +1409,28 @@ static void SDD_Name(RowFunc1bpp1XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     int Available = MIN((uint32_t)Remaining,Vend-Vptr);
     const ARMword *In;
     ARMword Bit, Data;
-    VIDEO_STAT(DisplayRedraw,1,1);
-    VIDEO_STAT(DisplayBits,1,Available);
+    RENDER_STAT(DisplayRedraw,1,1);
+    RENDER_STAT(DisplayBits,1,Available);
     /* Process the pixels in this region, stopping at end of row/Vend */
-    In = RAM+(Vptr>>5);
-    Bit = 1<<(Vptr & 31);
-    Data = *In++;
-    for(i=0;i<Available;i++)
+#ifdef SDD_DirectRow
+    if(HD.RowConv)
+      drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available,Palette,0,1);
+    else
+#endif
     {
-      int idx = (Data & Bit)?1:0;
-      SDD_Name(Host_WritePixel)(state,&drow,Palette[idx]);
-      Bit <<= 1;
-      if(!Bit)
+      In = RAM+(Vptr>>5);
+      Bit = 1<<(Vptr & 31);
+      Data = *In++;
+      for(i=0;i<Available;i++)
       {
-        Bit = 1;
-        Data = *In++;
+        int idx = (Data & Bit)?1:0;
+        SDD_Name(Host_WritePixel)(state,&drow,Palette[idx]);
+        Bit <<= 1;
+        if(!Bit)
+        {
+          Bit = 1;
+          Data = *In++;
+        }
       }
     }
     Remaining -= Available;      
@@ -1183,22 +1438,22 @@ static void SDD_Name(RowFunc1bpp1XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
   SDD_Name(Host_EndUpdate)(state,&drow);
 }
 
-static void SDD_Name(RowFunc2bpp1XNoFlags)(ARMul_State *state,int row,SDD_Row drow)
+static void SDD_Name(RowFunc2bpp1XNoFlags)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow)
 {
   int i, Remaining;
   uint32_t Vptr, Vstart, Vend;
   const ARMword *RAM;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate)(state,Palette,4);
+  SDD_Name(PaletteUpdate)(state,rd,Palette,4);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth*2; /* Scale up to account for everything else counting in bits */
 
@@ -1217,21 +1472,28 @@ static void SDD_Name(RowFunc2bpp1XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     const ARMword *In;
     uint32_t Shift;
     ARMword Data;
-    VIDEO_STAT(DisplayRedraw,1,1);
-    VIDEO_STAT(DisplayBits,1,Available);
+    RENDER_STAT(DisplayRedraw,1,1);
+    RENDER_STAT(DisplayBits,1,Available);
     /* Process the pixels in this region, stopping at end of row/Vend */
-    In = RAM+(Vptr>>5);
-    Shift = (Vptr & 31);
-    Data = (*In++) >> Shift;
-    for(i=0;i<Available;i+=2)
+#ifdef SDD_DirectRow
+    if(HD.RowConv)
+      drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available>>1,Palette,1,1);
+    else
+#endif
     {
-      SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 3]);
-      Data >>= 2;
-      Shift += 2;
-      if(Shift == 32)
+      In = RAM+(Vptr>>5);
+      Shift = (Vptr & 31);
+      Data = (*In++) >> Shift;
+      for(i=0;i<Available;i+=2)
       {
-        Shift = 0;
-        Data = *In++;
+        SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 3]);
+        Data >>= 2;
+        Shift += 2;
+        if(Shift == 32)
+        {
+          Shift = 0;
+          Data = *In++;
+        }
       }
     }
 
@@ -1240,22 +1502,22 @@ static void SDD_Name(RowFunc2bpp1XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
   SDD_Name(Host_EndUpdate)(state,&drow);
 }
 
-static void SDD_Name(RowFunc4bpp1XNoFlags)(ARMul_State *state,int row,SDD_Row drow)
+static void SDD_Name(RowFunc4bpp1XNoFlags)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow)
 {
   int i, Remaining;
   uint32_t Vptr, Vstart, Vend;
   const ARMword *RAM;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate)(state,Palette,16);
+  SDD_Name(PaletteUpdate)(state,rd,Palette,16);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth*4; /* Scale up to account for everything else counting in bits */
 
@@ -1274,26 +1536,33 @@ static void SDD_Name(RowFunc4bpp1XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     const ARMword *In;
     uint32_t Shift;
     ARMword Data;
-    VIDEO_STAT(DisplayRedraw,1,1);
-    VIDEO_STAT(DisplayBits,1,Available);
+    RENDER_STAT(DisplayRedraw,1,1);
+    RENDER_STAT(DisplayBits,1,Available);
     /* Process the pixels in this region, stopping at end of row/Vend */
 
     /* Display will always be a multiple of 2 pixels wide, so we can simplify things a bit compared to 1/2bpp case */
-    In = RAM+(Vptr>>5);      
-    Shift = (Vptr & 31);
-    Data = (*In++) >> Shift;
-    for(i=0;i<Available;i+=8)
+#ifdef SDD_DirectRow
+    if(HD.RowConv)
+      drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available>>2,Palette,2,1);
+    else
+#endif
     {
-      SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xf]);
-      Data >>= 4;
-      SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xf]);
-      Data >>= 4;
-      Shift += 8;
-      if(Shift == 32)
+      In = RAM+(Vptr>>5);      
+      Shift = (Vptr & 31);
+      Data = (*In++) >> Shift;
+      for(i=0;i<Available;i+=8)
       {
-        Shift = 0;
-        Data = *In++;
-      }        
+        SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xf]);
+        Data >>= 4;
+        SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xf]);
+        Data >>= 4;
+        Shift += 8;
+        if(Shift == 32)
+        {
+          Shift = 0;
+          Data = *In++;
+        }        
+      }
     }
 
     Remaining -= Available;      
@@ -1301,22 +1570,22 @@ static void SDD_Name(RowFunc4bpp1XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
   SDD_Name(Host_EndUpdate)(state,&drow);
 }
 
-static void SDD_Name(RowFunc8bpp1XNoFlags)(ARMul_State *state,int row,SDD_Row drow)
+static void SDD_Name(RowFunc8bpp1XNoFlags)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow)
 {
   int i, Remaining;
   uint32_t Vptr, Vstart, Vend;
   const ARMword *RAM;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate8bpp)(state,Palette);
+  SDD_Name(PaletteUpdate8bpp)(state,rd,Palette);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth*8; /* Scale up to account for everything else counting in bits */
 
@@ -1335,28 +1604,35 @@ static void SDD_Name(RowFunc8bpp1XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     const ARMword *In;
     uint32_t Shift;
     ARMword Data;
-    VIDEO_STAT(DisplayRedraw,1,1);
-    VIDEO_STAT(DisplayBits,1,Available);
+    RENDER_STAT(DisplayRedraw,1,1);
+    RENDER_STAT(DisplayBits,1,Available);
     /* Process the pixels in this region, stopping at end of row/Vend */
 
     /* Display will always be a multiple of 2 pixels wide, so we can simplify things a bit compared to 1/2bpp case */
-    In = RAM+(Vptr>>5);
-    Shift = (Vptr & 31);
-    Data = (*In++) >> Shift;
-    for(i=0;i<Available;i+=16)
+#ifdef SDD_DirectRow
+    if(HD.RowConv)
+      drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available>>3,Palette,3,1);
+    else
+#endif
     {
-      SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xff]);
-      Data >>= 8;
-      SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xff]);
-      if(Shift)
-      {
-        Shift = 0;
-        Data = *In++;
-      }
-      else
+      In = RAM+(Vptr>>5);
+      Shift = (Vptr & 31);
+      Data = (*In++) >> Shift;
+      for(i=0;i<Available;i+=16)
       {
-        Shift = 16;
+        SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xff]);
         Data >>= 8;
+        SDD_Name(Host_WritePixel)(state,&drow,Palette[Data & 0xff]);
+        if(Shift)
+        {
+          Shift = 0;
+          Data = *In++;
+        }
+        else
+        {
+          Shift = 16;
+          Data >>= 8;
+        }
       }
     }
 
@@ -1365,7 +1641,7 @@ static void SDD_Name(RowFunc8bpp1XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
   SDD_Name(Host_EndUpdate)(state,&drow);
 }
 
@@ -1377,18 +1653,18 @@ static void SDD_Name(RowFunc8bpp1XNoFlags)(ARMul_State *state,int row,SDD_Row dr
 
 */
 
-static void SDD_Name(RowFunc1bpp2XNoFlags)(ARMul_State *state,int row,SDD_Row drow)
+static void SDD_Name(RowFunc1bpp2XNoFlags)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow)
 {
   int i, Remaining;
   uint32_t Vptr, Vstart, Vend;
   const ARMword *RAM;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate)(state,Palette,2);
+  SDD_Name(PaletteUpdate)(state,rd,Palette,2);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth;
 
@@ -1405,21 +1681,28 @@ static void SDD_Name(RowFunc1bpp2XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     int Available = MIN((uint32_t)Remaining,Vend-Vptr);
     const ARMword *In;
     ARMword Bit, Data;
-    VIDEO_STAT(DisplayRedraw,1,1);
-    VIDEO_STAT(DisplayBits,1,Available);
+    RENDER_STAT(DisplayRedraw,1,1);
+    RENDER_STAT(DisplayBits,1,Available);
     /* Process the pixels in this region, stopping at end of row/Vend */
-    In = RAM+(Vptr>>5);
-    Bit = 1<<(Vptr & 31);
-    Data = *In++;
-    for(i=0;i<Available;i++)
+#ifdef SDD_DirectRow
+    if(HD.RowConv)
+      drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available,Palette,0,2);
+    else
+#endif
     {
-      int idx = (Data & Bit)?1:0;
-      SDD_Name(Host_WritePixels)(state,&drow,Palette[idx],2);
-      Bit <<= 1;
-      if(!Bit)
+      In = RAM+(Vptr>>5);
+      Bit = 1<<(Vptr & 31);
+      Data = *In++;
+      for(i=0;i<Available;i++)
       {
-        Bit = 1;
-        Data = *In++;
+        int idx = (Data & Bit)?1:0;
+        SDD_Name(Host_WritePixels)(state,&drow,Palette[idx],2);
+        Bit <<= 1;
+        if(!Bit)
+        {
+          Bit = 1;
+          Data = *In++;
+        }
       }
     }
 
@@ -1428,22 +1711,22 @@ static void SDD_Name(RowFunc1bpp2XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
   SDD_Name(Host_EndUpdate)(state,&drow);
 }
 
-static void SDD_Name(RowFunc2bpp2XNoFlags)(ARMul_State *state,int row,SDD_Row drow)
+static void SDD_Name(RowFunc2bpp2XNoFlags)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow)
 {
   int i, Remaining;
   uint32_t Vptr, Vstart, Vend;
   const ARMword *RAM;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate)(state,Palette,4);
+  SDD_Name(PaletteUpdate)(state,rd,Palette,4);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth*2; /* Scale up to account for everything else counting in bits */
 
@@ -1462,21 +1745,28 @@ static void SDD_Name(RowFunc2bpp2XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     const ARMword *In;
     uint32_t Shift;
     ARMword Data;
-    VIDEO_STAT(DisplayRedraw,1,1);
-    VIDEO_STAT(DisplayBits,1,Available);
+    RENDER_STAT(DisplayRedraw,1,1);
+    RENDER_STAT(DisplayBits,1,Available);
     /* Process the pixels in this region, stopping at end of row/Vend */
-    In = RAM+(Vptr>>5);
-    Shift = (Vptr & 31);
-    Data = (*In++) >> Shift;
-    for(i=0;i<Available;i+=2)
+#ifdef SDD_DirectRow
+    if(HD.RowConv)
+      drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available>>1,Palette,1,2);
+    else
+#endif
     {
-      SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 3],2);
-      Data >>= 2;
-      Shift += 2;
-      if(Shift == 32)
+      In = RAM+(Vptr>>5);
+      Shift = (Vptr & 31);
+      Data = (*In++) >> Shift;
+      for(i=0;i<Available;i+=2)
       {
-        Shift = 0;
-        Data = *In++;
+        SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 3],2);
+        Data >>= 2;
+        Shift += 2;
+        if(Shift == 32)
+        {
+          Shift = 0;
+          Data = *In++;
+        }
       }
     }
 
@@ -1485,22 +1775,22 @@ static void SDD_Name(RowFunc2bpp2XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
   SDD_Name(Host_EndUpdate)(state,&drow);
 }
 
-static void SDD_Name(RowFunc4bpp2XNoFlags)(ARMul_State *state,int row,SDD_Row drow)
+static void SDD_Name(RowFunc4bpp2XNoFlags)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow)
 {
   int i, Remaining;
   uint32_t Vptr, Vstart, Vend;
   const ARMword *RAM;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate)(state,Palette,16);
+  SDD_Name(PaletteUpdate)(state,rd,Palette,16);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth*4; /* Scale up to account for everything else counting in bits */
 
@@ -1519,26 +1809,33 @@ static void SDD_Name(RowFunc4bpp2XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     const ARMword *In;
     uint32_t Shift;
     ARMword Data;
-    VIDEO_STAT(DisplayRedraw,1,1);
-    VIDEO_STAT(DisplayBits,1,Available);
+    RENDER_STAT(DisplayRedraw,1,1);
+    RENDER_STAT(DisplayBits,1,Available);
     /* Process the pixels in this region, stopping at end of row/Vend */
 
     /* Display will always be a multiple of 2 pixels wide, so we can simplify things a bit compared to 1/2bpp case */
-    In = RAM+(Vptr>>5);      
-    Shift = (Vptr & 31);
-    Data = (*In++) >> Shift;
-    for(i=0;i<Available;i+=8)
+#ifdef SDD_DirectRow
+    if(HD.RowConv)
+      drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available>>2,Palette,2,2);
+    else
+#endif
     {
-      SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xf],2);
-      Data >>= 4;
-      SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xf],2);
-      Data >>= 4;
-      Shift += 8;
-      if(Shift == 32)
+      In = RAM+(Vptr>>5);      
+      Shift = (Vptr & 31);
+      Data = (*In++) >> Shift;
+      for(i=0;i<Available;i+=8)
       {
-        Shift = 0;
-        Data = *In++;
-      }        
+        SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xf],2);
+        Data >>= 4;
+        SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xf],2);
+        Data >>= 4;
+        Shift += 8;
+        if(Shift == 32)
+        {
+          Shift = 0;
+          Data = *In++;
+        }        
+      }
     }
 
     Remaining -= Available;      
@@ -1546,22 +1843,22 @@ static void SDD_Name(RowFunc4bpp2XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
   SDD_Name(Host_EndUpdate)(state,&drow);
 }
 
-static void SDD_Name(RowFunc8bpp2XNoFlags)(ARMul_State *state,int row,SDD_Row drow)
+static void SDD_Name(RowFunc8bpp2XNoFlags)(ARMul_State *state,struct SDD_Name(Renderer) *rd,int row,SDD_Row drow)
 {
   int i, Remaining;
   uint32_t Vptr, Vstart, Vend;
   const ARMword *RAM;
-  SDD_HostColour *Palette = HD.Palette;
+  SDD_HostColour *Palette = RD.Palette;
   /* Handle palette updates */
-  SDD_Name(PaletteUpdate8bpp)(state,Palette);
+  SDD_Name(PaletteUpdate8bpp)(state,rd,Palette);
 
-  Vptr = DC.Vptr;
-  Vstart = MEMC.Vstart<<7;
-  Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  Vptr = RD.Row.Vptr;
+  Vstart = RD.Row.Vstart;
+  Vend = RD.Row.Vend;
   RAM = MEMC.PhysRam;
   Remaining = DC.LastHostWidth*8; /* Scale up to account for everything else counting in bits */
 
@@ -1580,28 +1877,35 @@ static void SDD_Name(RowFunc8bpp2XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     const ARMword *In;
     uint32_t Shift;
     ARMword Data;
-    VIDEO_STAT(DisplayRedraw,1,1);
-    VIDEO_STAT(DisplayBits,1,Available);
+    RENDER_STAT(DisplayRedraw,1,1);
+    RENDER_STAT(DisplayBits,1,Available);
     /* Process the pixels in this region, stopping at end of row/Vend */
 
     /* Display will always be a multiple of 2 pixels wide, so we can simplify things a bit compared to 1/2bpp case */
-    In = RAM+(Vptr>>5);
-    Shift = (Vptr & 31);
-    Data = (*In++) >> Shift;
-    for(i=0;i<Available;i+=16)
+#ifdef SDD_DirectRow
+    if(HD.RowConv)
+      drow = (SDD_Row) HD.RowConv(drow,RAM,Vptr,Available>>3,Palette,3,2);
+    else
+#endif
     {
-      SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xff],2);
-      Data >>= 8;
-      SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xff],2);
-      if(Shift)
-      {
-        Shift = 0;
-        Data = *In++;
-      }
-      else
+      In = RAM+(Vptr>>5);
+      Shift = (Vptr & 31);
+      Data = (*In++) >> Shift;
+      for(i=0;i<Available;i+=16)
       {
-        Shift = 16;
+        SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xff],2);
         Data >>= 8;
+        SDD_Name(Host_WritePixels)(state,&drow,Palette[Data & 0xff],2);
+        if(Shift)
+        {
+          Shift = 0;
+          Data = *In++;
+        }
+        else
+        {
+          Shift = 16;
+          Data >>= 8;
+        }
       }
     }
 
@@ -1610,7 +1914,7 @@ static void SDD_Name(RowFunc8bpp2XNoFlags)(ARMul_State *state,int row,SDD_Row dr
     if(Vptr >= Vend)
       Vptr = Vstart;
   }
-  DC.Vptr = Vptr;
+  RD.Row.Vptr = Vptr;
   SDD_Name(Host_EndUpdate)(state,&drow);
 }
 
@@ -1628,25 +1932,20 @@ static bool SDD_Name(IsColourEqual)(SDD_HostColour left, SDD_HostColour right) {
 #endif
 }
 
-static void SDD_Name(BorderRow)(ARMul_State *state,int row)
+static void SDD_Name(BorderRow)(ARMul_State *state,struct SDD_Name(Renderer) *rd)
 {
-  int hoststart, hostend;
+  int row = RD.Row.Row;
+  int hoststart = RD.Row.HostStart;
   /* Render a border row */
-  SDD_HostColour col = HD.BorderCol;
+  SDD_HostColour col = RD.Row.BorderCol;
   bool colourChanged = !SDD_Name(IsColourEqual)(HD.BorderCols[row], col);
-  if(!DC.ForceRefresh && !colourChanged)
+  if(!RD.Row.ForceRefresh && !colourChanged)
     return;
-  VIDEO_STAT(BorderRedraw,1,1);
-  VIDEO_STAT(BorderRedrawForced,DC.ForceRefresh,1);
-  VIDEO_STAT(BorderRedrawColourChanged,colourChanged,1);
+  RENDER_STAT(BorderRedraw,1,1);
+  RENDER_STAT(BorderRedrawForced,RD.Row.ForceRefresh,1);
+  RENDER_STAT(BorderRedrawColourChanged,colourChanged,1);
   HD.BorderCols[row] = col;
-  hoststart = (row-(VIDC.Vert_DisplayStart+1))*HD.YScale+HD.YOffset;
-  hostend = hoststart + HD.YScale;
-  if(hoststart < 0)
-    hoststart = 0;
-  if(hostend > HD.Height)
-    hostend = HD.Height;
-  while(hoststart < hostend)
+  while(hoststart < RD.Row.HostEnd)
   {
     SDD_Row drow = SDD_Name(Host_BeginRow)(state,hoststart++,0);
     SDD_Name(Host_BeginUpdate)(state,&drow,HD.Width);
@@ -1671,35 +1970,29 @@ static const SDD_Name(RowFunc) SDD_Name(RowFuncs)[2][4] = {
  }
 };
 
-static void SDD_Name(DisplayRow)(ARMul_State *state,int row)
+static void SDD_Name(DisplayRow)(ARMul_State *state,struct SDD_Name(Renderer) *rd)
 {
-  int rowflags;
+  int rowflags, updateflags;
   SDD_HostColour col;
   bool colourChanged;
-  uint32_t flags, bit;
   SDD_Row drow;
   const SDD_Name(RowFunc) *rf;
   /* Render a display row */
-  int hoststart = (row-(VIDC.Vert_DisplayStart+1))*HD.YScale+HD.YOffset;
-  int hostend = hoststart + HD.YScale;
-  if(hoststart < 0)
-    hoststart = 0;
-  if(hostend > HD.Height)
-    hostend = HD.Height;
-  if(hoststart >= hostend)
-    return;
+  int row = RD.Row.Row;
+  int hoststart = RD.Row.HostStart;
+  int hostend = RD.Row.HostEnd;
 
   /* Handle border colour updates */
-  rowflags = (DC.ForceRefresh?ROWFUNC_FORCE:0);
-  col = HD.BorderCol;
+  rowflags = (RD.Row.ForceRefresh?ROWFUNC_FORCE:0);
+  col = RD.Row.BorderCol;
   colourChanged = !SDD_Name(IsColourEqual)(HD.BorderCols[row], col);
   
   if(rowflags || colourChanged)
   {
     int i;
-    VIDEO_STAT(BorderRedraw,1,1);
-    VIDEO_STAT(BorderRedrawForced,rowflags,1);
-    VIDEO_STAT(BorderRedrawColourChanged,colourChanged,1);
+    RENDER_STAT(BorderRedraw,1,1);
+    RENDER_STAT(BorderRedrawForced,rowflags,1);
+    RENDER_STAT(BorderRedrawColourChanged,colourChanged,1);
     HD.BorderCols[row] = col;
     for(i=hoststart;i<hostend;i++)
     {
@@ -1720,42 +2013,48 @@ static void SDD_Name(DisplayRow)(ARMul_State *state,int row)
 
   /* Display area */
 
-  flags = HD.RefreshFlags[row>>5];
-  bit = UINT32_C(1)<<(row&31);
-  if(flags & bit)
+  if(RD.Row.Refresh)
   {
-    VIDEO_STAT(DisplayRowForce,1,1);
+    RENDER_STAT(DisplayRowForce,1,1);
     rowflags = ROWFUNC_FORCE;
-    HD.RefreshFlags[row>>5] = (flags &~ bit);
   }
 
+  updateflags = ROWFUNC_UPDATEFLAGS;
+#ifdef SDD_RenderThread
+  /* Can't update the flags if they couldn't all be captured */
+  if(RD.Row.NumFlags < 0)
+    updateflags = 0;
+#endif
+
   drow = SDD_Name(Host_BeginRow)(state,hoststart++,HD.XOffset);
-  rf = &SDD_Name(RowFuncs)[HD.XScale-1][(DC.VIDC_CR&0xc)>>2];
+  rf = &SDD_Name(RowFuncs)[HD.XScale-1][(RD.Row.VIDC_CR&0xc)>>2];
   if(hoststart == hostend)
   {
-    if((*rf)(state,row,drow,rowflags | ROWFUNC_UPDATEFLAGS))
+    if((*rf)(state,rd,row,drow,rowflags | updateflags))
     {
-      VIDEO_STAT(DisplayRowRedraw,1,1);
+      RENDER_STAT(DisplayRowRedraw,1,1);
+      RD.RowsRedrawn++;
     }
     SDD_Name(Host_EndRow)(state,&drow);
   }
   else
   {
     /* Remember current Vptr */
-    uint32_t Vptr = DC.Vptr;
-    int updated = (*rf)(state,row,drow,rowflags);
+    uint32_t Vptr = RD.Row.Vptr;
+    int updated = (*rf)(state,rd,row,drow,rowflags);
     SDD_Name(Host_EndRow)(state,&drow);
     if(updated)
     {
-      VIDEO_STAT(DisplayRowRedraw,1,1);
+      RENDER_STAT(DisplayRowRedraw,1,1);
+      RD.RowsRedrawn++;
       /* Call the same func again on the same source data to update the copies of this scanline */
       while(hoststart < hostend)
       {
-        DC.Vptr = Vptr;
+        RD.Row.Vptr = Vptr;
         drow = SDD_Name(Host_BeginRow)(state,hoststart++,HD.XOffset);
         if(hoststart == hostend)
-          rowflags |= ROWFUNC_UPDATEFLAGS;
-        (*rf)(state,row,drow,rowflags);
+          rowflags |= updateflags;
+        (*rf)(state,rd,row,drow,rowflags);
         SDD_Name(Host_EndRow)(state,&drow);
       }
     }
@@ -1777,32 +2076,65 @@ static const SDD_Name(RowFuncNoFlags) SDD_Name(RowFuncsNoFlags)[2][4] = {
  }
 };
 
-static void SDD_Name(DisplayRowNoFlags)(ARMul_State *state,int row)
+/* Hash the source data & palette of the row described by RD.Row, and return
+   the DMA pointer for the start of the next row. This follows the same path
+   through memory as the row funcs; whole words are hashed, so pixels either
+   side of the row can cause the odd unnecessary redraw. */
+static uint64_t SDD_Name(RowHash)(ARMul_State *state,struct SDD_Name(Renderer) *rd,uint32_t *nextVptr)
+{
+  uint32_t Vptr = RD.Row.Vptr;
+  uint32_t Vstart = RD.Row.Vstart;
+  uint32_t Vend = RD.Row.Vend;
+  int Remaining = DC.LastHostWidth<<((RD.Row.VIDC_CR&0xc)>>2); /* In bits */
+  ARMword pal[9];
+  uint64_t hash;
+  int i;
+
+  for(i=0;i<8;i++)
+    pal[i] = RD.Row.Palette[i*2] | (RD.Row.Palette[i*2+1]<<16);
+  pal[8] = RD.Row.VIDC_CR & 0xc;
+  hash = RowConv_Hash(pal,9,RD.Row.PaletteGen);
+
+  /* Sanity checks to avoid looping forever */
+  if(Vend == Vstart)
+    Vend = Vstart+128;
+  if(Vptr >= Vend)
+    Vptr = Vstart;
+
+  while(Remaining > 0)
+  {
+    int Available = MIN((uint32_t)Remaining,Vend-Vptr);
+    hash = RowConv_Hash(MEMC.PhysRam+(Vptr>>5),((Vptr+Available+31)>>5)-(Vptr>>5),hash);
+    Remaining -= Available;
+    Vptr += Available;
+    if(Vptr >= Vend)
+      Vptr = Vstart;
+  }
+  *nextVptr = Vptr;
+  return hash;
+}
+
+static void SDD_Name(DisplayRowNoFlags)(ARMul_State *state,struct SDD_Name(Renderer) *rd)
 {
   SDD_HostColour col;
   bool colourChanged;
   const SDD_Name(RowFuncNoFlags) *rf;
   uint32_t Vptr;
   /* Render a display row */
-  int hoststart = (row-(VIDC.Vert_DisplayStart+1))*HD.YScale+HD.YOffset;
-  int hostend = hoststart + HD.YScale;
-  if(hoststart < 0)
-    hoststart = 0;
-  if(hostend > HD.Height)
-    hostend = HD.Height;
-  if(hoststart >= hostend)
-    return;
+  int row = RD.Row.Row;
+  int hoststart = RD.Row.HostStart;
+  int hostend = RD.Row.HostEnd;
 
   /* Handle border colour updates */
-  col = HD.BorderCol;
+  col = RD.Row.BorderCol;
   colourChanged = !SDD_Name(IsColourEqual)(HD.BorderCols[row], col);
   
-  if(DC.ForceRefresh || colourChanged)
+  if(RD.Row.ForceRefresh || colourChanged)
   {
     int i;
-    VIDEO_STAT(BorderRedraw,1,1);
-    VIDEO_STAT(BorderRedrawForced,DC.ForceRefresh,1);
-    VIDEO_STAT(BorderRedrawColourChanged,colourChanged,1);
+    RENDER_STAT(BorderRedraw,1,1);
+    RENDER_STAT(BorderRedrawForced,RD.Row.ForceRefresh,1);
+    RENDER_STAT(BorderRedrawColourChanged,colourChanged,1);
     HD.BorderCols[row] = col;
     for(i=hoststart;i<hostend;i++)
     {
@@ -1823,19 +2155,557 @@ static void SDD_Name(DisplayRowNoFlags)(ARMul_State *state,int row)
 
   /* Display area */
 
-  rf = &SDD_Name(RowFuncsNoFlags)[HD.XScale-1][(DC.VIDC_CR&0xc)>>2];
+  if(RD.Row.Type == ROWTYPE_DISPLAYHASH)
+  {
+    uint64_t hash = SDD_Name(RowHash)(state,rd,&Vptr);
+    if(!RD.Row.ForceRefresh && (hash == HD.RowHashes[row]))
+    {
+      RENDER_STAT(RowHashMatch,1,1);
+      RD.Row.Vptr = Vptr;
+      return;
+    }
+    HD.RowHashes[row] = hash;
+  }
+  RD.RowsRedrawn++;
+
+  rf = &SDD_Name(RowFuncsNoFlags)[HD.XScale-1][(RD.Row.VIDC_CR&0xc)>>2];
   /* Remember current Vptr */
-  Vptr = DC.Vptr;
+  Vptr = RD.Row.Vptr;
   do
   {
     SDD_Row drow;
-    DC.Vptr = Vptr;
+    RD.Row.Vptr = Vptr;
     drow = SDD_Name(Host_BeginRow)(state,hoststart,HD.XOffset);
-    (*rf)(state,row,drow);
+    (*rf)(state,rd,row,drow);
     SDD_Name(Host_EndRow)(state,&drow);
   } while(++hoststart < hostend);
 }
 
+/*
+
+  Row capture & rendering
+
+*/
+
+/* Render the row described by RD.Row */
+static void SDD_Name(RenderRow)(ARMul_State *state,struct SDD_Name(Renderer) *rd)
+{
+  uint64_t start = HostTime_Now();
+
+  /* Pick up any palette changes. Rows may be drawn by a different renderer
+     to the previous row, so compare against the palette this renderer last
+     saw instead of relying on DC.DirtyPalette */
+  if(RD.Row.PaletteGen != RD.PaletteGen)
+  {
+    RD.PaletteGen = RD.Row.PaletteGen;
+    RD.DirtyPalette = 65535;
+    memcpy(RD.VIDCPalette,RD.Row.Palette,sizeof(RD.VIDCPalette));
+  }
+  else
+  {
+    int i;
+    for(i=0;i<16;i++)
+    {
+      if(RD.VIDCPalette[i] != RD.Row.Palette[i])
+      {
+        RD.VIDCPalette[i] = RD.Row.Palette[i];
+        RD.DirtyPalette |= (1<<i);
+      }
+    }
+  }
+
+  switch(RD.Row.Type)
+  {
+  case ROWTYPE_BORDER:
+    SDD_Name(BorderRow)(state,rd);
+    break;
+  case ROWTYPE_DISPLAY:
+    SDD_Name(DisplayRow)(state,rd);
+    break;
+  default:
+    SDD_Name(DisplayRowNoFlags)(state,rd);
+    break;
+  }
+
+  RENDER_STAT(ConvertTime,1,HostTime_Now()-start);
+}
+
+/* Capture the state needed to render a row. Returns false if the row isn't
+   visible in the host display */
+static bool SDD_Name(CaptureRow)(ARMul_State *state,struct SDD_Name(RowState) *rs,int row,int type)
+{
+  int hoststart = (row-(VIDC.Vert_DisplayStart+1))*HD.YScale+HD.YOffset;
+  int hostend = hoststart + HD.YScale;
+  if(hoststart < 0)
+    hoststart = 0;
+  if(hostend > HD.Height)
+    hostend = HD.Height;
+  if(hoststart >= hostend)
+    return false;
+
+  rs->Row = row;
+  rs->HostStart = hoststart;
+  rs->HostEnd = hostend;
+  rs->Type = type;
+  rs->ForceRefresh = DC.ForceRefresh;
+  rs->Refresh = false;
+  if(type == ROWTYPE_DISPLAY)
+  {
+    uint32_t flags = HD.RefreshFlags[row>>5];
+    uint32_t bit = UINT32_C(1)<<(row&31);
+    if(flags & bit)
+    {
+      rs->Refresh = true;
+      HD.RefreshFlags[row>>5] = (flags &~ bit);
+    }
+  }
+  if(DC.DirtyPalette == 65535)
+    DC.PaletteGen++; /* Full rebuild requested */
+  DC.DirtyPalette = 0;
+  rs->PaletteGen = DC.PaletteGen;
+  memcpy(rs->Palette,VIDC.Palette,sizeof(rs->Palette));
+  rs->BorderCol = HD.BorderCol;
+  rs->VIDC_CR = DC.VIDC_CR;
+  rs->Vptr = DC.Vptr;
+  rs->Vstart = MEMC.Vstart<<7;
+  rs->Vend = (MEMC.Vend+1)<<7; /* Point to pixel after end */
+  rs->UpdateFlags = MEMC.UpdateFlags;
+  return true;
+}
+
+#ifdef SDD_RenderThread
+/* Capture the UpdateFlags a display row will look at, and advance DC.Vptr to
+   the start of the next row. This follows the same path through memory as the
+   row funcs. */
+static void SDD_Name(CaptureFlags)(ARMul_State *state,struct SDD_Name(RowState) *rs)
+{
+  uint32_t Vptr = rs->Vptr;
+  uint32_t Vstart = rs->Vstart;
+  uint32_t Vend = rs->Vend;
+  int Remaining = DC.LastHostWidth<<((rs->VIDC_CR&0xc)>>2); /* In bits */
+  int NumFlags = 0;
+
+  /* Sanity checks to avoid looping forever */
+  if(Vend == Vstart)
+    Vend = Vstart+128;
+  if(Vptr >= Vend)
+    Vptr = Vstart;
+
+  while(Remaining > 0)
+  {
+    uint32_t FlagsOffset = Vptr/(8*UPDATEBLOCKSIZE);
+    int Available = MIN((uint32_t)Remaining,MIN(((FlagsOffset+1)*8*UPDATEBLOCKSIZE)-Vptr,Vend-Vptr));
+
+    if(NumFlags < ROWQUEUE_FLAGS)
+    {
+      rs->FlagsOffset[NumFlags] = FlagsOffset;
+      rs->Flags[NumFlags] = MEMC.UpdateFlags[FlagsOffset];
+    }
+    NumFlags++;
+
+    Remaining -= Available;
+    Vptr += Available;
+    if(Vptr >= Vend)
+      Vptr = Vstart;
+  }
+  DC.Vptr = Vptr;
+
+  if(NumFlags > ROWQUEUE_FLAGS)
+  {
+    /* Tiny Vstart-Vend range; just redraw the row in full */
+    rs->NumFlags = -1;
+    rs->Refresh = true;
+  }
+  else
+    rs->NumFlags = NumFlags;
+}
+
+/* Check whether a display or border row would draw anything. Reading
+   HD.UpdateFlags and HD.BorderCols is safe here; the render threads only touch
+   the entries for rows in the queue, and this row isn't. */
+static bool SDD_Name(RowIsClean)(ARMul_State *state,const struct SDD_Name(RowState) *rs)
+{
+  int i;
+  if(rs->ForceRefresh || rs->Refresh || (rs->Type > ROWTYPE_DISPLAY))
+    return false; /* NOFLAGS rows need checking by the renderer */
+  if(!SDD_Name(IsColourEqual)(HD.BorderCols[rs->Row],rs->BorderCol))
+    return false;
+  if(rs->Type == ROWTYPE_BORDER)
+    return true;
+  if(rs->NumFlags < 0)
+    return false;
+  for(i=0;i<rs->NumFlags;i++)
+  {
+    if(HD.UpdateFlags[rs->Row][rs->FlagsOffset[i]] != rs->Flags[i])
+      return false;
+  }
+  return true;
+}
+
+static void *SDD_Name(RenderThread)(void *arg)
+{
+  struct SDD_Name(RenderWorker) *worker = (struct SDD_Name(RenderWorker) *) arg;
+  ARMul_State *state = worker->state;
+  struct SDD_Name(Renderer) *rd = &worker->Renderer;
+  pthread_mutex_lock(&RENDER.Mutex);
+  for(;;)
+  {
+    uint32_t first,count,i;
+    while((RENDER.Next == RENDER.Tail) && !RENDER.Quit)
+      pthread_cond_wait(&RENDER.Queued,&RENDER.Mutex);
+    if(RENDER.Next == RENDER.Tail)
+      break;
+    /* Claim a band of rows */
+    first = RENDER.Next;
+    count = MIN(RENDER.Tail-first,ROWQUEUE_BAND);
+    RENDER.Next = first+count;
+    pthread_mutex_unlock(&RENDER.Mutex);
+
+    /* The emulator won't touch these entries until Done reaches Tail */
+    for(i=first;i<first+count;i++)
+    {
+      RD.Row = RENDER.Queue[i];
+      if(RD.Row.Type == ROWTYPE_DISPLAY)
+      {
+        int j;
+        for(j=0;j<RD.Row.NumFlags;j++)
+          RD.RowFlags[RD.Row.FlagsOffset[j]] = RD.Row.Flags[j];
+        RD.Row.UpdateFlags = RD.RowFlags;
+      }
+      SDD_Name(RenderRow)(state,rd);
+    }
+
+    pthread_mutex_lock(&RENDER.Mutex);
+    RENDER.Done += count;
+    if(RENDER.Done == RENDER.Tail)
+      pthread_cond_broadcast(&RENDER.Drawn);
+  }
+  pthread_mutex_unlock(&RENDER.Mutex);
+  return NULL;
+}
+
+/* Hand all captured rows to the render threads and wait for them to be
+   drawn. Afterwards the queue is empty. */
+static void SDD_Name(RenderSync)(ARMul_State *state)
+{
+  if(!RENDER.NumThreads)
+    return;
+  pthread_mutex_lock(&RENDER.Mutex);
+  if(RENDER.Tail != RENDER.Captured)
+  {
+    RENDER.Tail = RENDER.Captured;
+    pthread_cond_broadcast(&RENDER.Queued);
+  }
+  while(RENDER.Done != RENDER.Tail)
+    pthread_cond_wait(&RENDER.Drawn,&RENDER.Mutex);
+  RENDER.Next = RENDER.Done = RENDER.Tail = RENDER.Captured = 0;
+  pthread_mutex_unlock(&RENDER.Mutex);
+}
+#endif
+
+/* Draw a row, or queue it for the render threads */
+static void SDD_Name(QueueRow)(ARMul_State *state,int row,int type)
+{
+  struct SDD_Name(Renderer) *rd;
+#ifdef SDD_RenderThread
+  if(RENDER.NumThreads)
+  {
+    struct SDD_Name(RowState) *rs;
+    if(RENDER.Captured == ROWQUEUE_SIZE)
+      SDD_Name(RenderSync)(state);
+
+    rs = &RENDER.Queue[RENDER.Captured];
+    if(!SDD_Name(CaptureRow)(state,rs,row,type))
+      return;
+    if(type != ROWTYPE_BORDER)
+      SDD_Name(CaptureFlags)(state,rs);
+    if(SDD_Name(RowIsClean)(state,rs))
+    {
+      VIDEO_STAT(RowSkipped,1,1);
+      return;
+    }
+
+    /* Publish rows a band at a time, to keep the locking overhead down */
+    if(++RENDER.Captured - RENDER.Tail >= ROWQUEUE_BAND)
+    {
+      pthread_mutex_lock(&RENDER.Mutex);
+      RENDER.Tail = RENDER.Captured;
+      pthread_cond_signal(&RENDER.Queued);
+      pthread_mutex_unlock(&RENDER.Mutex);
+    }
+    return;
+  }
+#endif
+  rd = &HD.Renderer;
+  if(SDD_Name(CaptureRow)(state,&RD.Row,row,type))
+  {
+    SDD_Name(RenderRow)(state,rd);
+    if(type != ROWTYPE_BORDER)
+      DC.Vptr = RD.Row.Vptr;
+  }
+}
+
+/*
+
+  Stats dumping
+
+*/
+
+#ifdef SIGUSR1
+/* Whatever SIGUSR1 did before Init, restored by Shutdown */
+static void (*SDD_Name(PrevStatsSignal))(int) = SIG_DFL;
+
+static void SDD_Name(StatsSignal)(int sig)
+{
+  DisplayDev_StatsRequested = 1;
+}
+#endif
+
+/* Add the renderer's counters to 'stats', and reset them */
+static void SDD_Name(StatsCollect)(struct SDD_Name(Renderer) *rd,uint64_t *stats)
+{
+  int i;
+  for(i=0;i<vidstat_MAX;i++)
+    stats[i] += RD.Stats[i];
+  memset(RD.Stats,0,sizeof(RD.Stats));
+}
+
+/* Log and reset all the counters. Only safe when the render threads are
+   idle. */
+static void SDD_Name(StatsDump)(ARMul_State *state,const char *c)
+{
+  uint64_t stats[vidstat_MAX];
+  double frames;
+  int i;
+
+  memcpy(stats,DC.Stats,sizeof(stats));
+  memset(DC.Stats,0,sizeof(DC.Stats));
+  SDD_Name(StatsCollect)(&HD.Renderer,stats);
+#ifdef SDD_RenderThread
+  for(i=0;i<RENDER.NumThreads;i++)
+    SDD_Name(StatsCollect)(&RENDER.Threads[i].Renderer,stats);
+#endif
+
+  warn_vidc("%s\n",c);
+  for(i=0;i<vidstat_MAX;i++)
+  {
+    warn_vidc("%12.0f %s\n",(double) stats[i],vidstatnames[i]);
+  }
+
+  /* Per-frame costs. VSync time is mostly the speed limiter sleeping, so
+     leave it out of the display time */
+  frames = (double) MAX(stats[vidstat_DisplayFrames],1);
+  warn_vidc("Per frame: %.0fus converting, %.0fus presenting, %.0fus display total, %.0f bytes uploaded\n",
+            stats[vidstat_ConvertTime]/frames,stats[vidstat_PresentTime]/frames,
+            (stats[vidstat_DisplayTime]-MIN(stats[vidstat_VSyncTime],stats[vidstat_DisplayTime]))/frames,
+            stats[vidstat_HostBytes]/frames);
+  warn_vidc("Frameskip %d, %d rows per event, UpdateFlags %s, row hashes %s, governor %s\n",DisplayDev_FrameSkip,DC.RowsAtOnce,
+            (DisplayDev_UseUpdateFlags?"on":"off"),(DisplayDev_UseRowHashes?"on":"off"),(DisplayDev_Governor?"on":"off"));
+  if(EmuRate_GetTarget(state))
+    warn_vidc("Emulation speed %u%% of real hardware, limited to %.1fMHz\n",(unsigned) EmuRate_GetSpeedPercent(),EmuRate_GetTarget(state)/1e6);
+  else
+    warn_vidc("Emulation speed %u%% of real hardware, unlimited\n",(unsigned) EmuRate_GetSpeedPercent());
+#ifdef SOUND_SUPPORT
+  Sound_LogStats();
+#endif
+}
+
+/*
+
+  Display governor
+
+  With DisplayDev_Governor set, the host time spent in the display code
+  (drawing rows, waiting for render threads, presenting frames) is measured
+  against the time spent emulating. Every GOVERNOR_PERIOD frames the settings
+  are re-chosen:
+
+  - If the speed governor has a target rate, the frameskip is the smallest
+    one that lets each frame's emulation, plus its share of the cost of a drawn
+    frame, fit into the time the frame should take at that rate.
+  - With no target rate, the frameskip is the smallest one that keeps the
+    display below GOVERNOR_SHARE percent of the host time.
+  - Either way, the frameskip is capped so that at least GOVERNOR_MINFPS
+    frames are drawn per second.
+  - If no frameskip is good enough, RowsAtOnce is doubled (up to
+    GOVERNOR_MAXROWS) to cut down on event overhead. It's halved again once
+    frames are being drawn unskipped within budget.
+  - UpdateFlags are turned off if nearly every display row gets redrawn
+    anyway, since the flags then only slow down guest writes to screen
+    memory. They're turned back on if few rows are changing (as seen by
+    DisplayDev_UseRowHashes). Without row hashes there's no way of telling,
+    so they're just retried after a while, backing off exponentially.
+
+*/
+
+#define GOVERNOR_PERIOD 25 /* Frames per measurement period */
+#define GOVERNOR_MAXSKIP 10
+#define GOVERNOR_SHARE 20 /* Display budget when unthrottled, percent of host time */
+#define GOVERNOR_MINFPS 10
+#define GOVERNOR_MAXROWS 16
+#define GOVERNOR_FLAGSOFF 90 /* Turn UpdateFlags off if this percentage of rows get redrawn */
+#define GOVERNOR_FLAGSON 25 /* Turn UpdateFlags on if only this percentage of rows change */
+#define GOVERNOR_MAXBACKOFF 64 /* Max periods to wait before retrying UpdateFlags */
+
+/* Start timing a chunk of display code, returning the start time */
+static inline uint64_t SDD_Name(TimeStart)(void)
+{
+  return HostTime_Now();
+}
+
+static inline void SDD_Name(TimeStop)(ARMul_State *state,uint64_t start)
+{
+  uint64_t time = HostTime_Now()-start;
+  VIDEO_STAT(DisplayTime,1,time);
+  DC.Gov_DisplayTime += time;
+}
+
+/* Sum the RowsRedrawn counts of all the renderers, and reset them. Only safe
+   when the render threads are idle. */
+static uint32_t SDD_Name(GovernorRowsRedrawn)(ARMul_State *state)
+{
+  uint32_t count = HD.Renderer.RowsRedrawn;
+  HD.Renderer.RowsRedrawn = 0;
+#ifdef SDD_RenderThread
+  {
+    int i;
+    for(i=0;i<RENDER.NumThreads;i++)
+    {
+      count += RENDER.Threads[i].Renderer.RowsRedrawn;
+      RENDER.Threads[i].Renderer.RowsRedrawn = 0;
+    }
+  }
+#endif
+  return count;
+}
+
+/* Start a new measurement period */
+static void SDD_Name(GovernorReset)(ARMul_State *state,uint64_t now)
+{
+  DC.RowsAtOnce = MAX(SDD_RowsAtOnce,DC.Gov_RowsAtOnce);
+  DC.Gov_Frames = 0;
+  DC.Gov_Drawn = 0;
+  DC.Gov_Rows = 0;
+  DC.Gov_StartCycle = ARMul_Time;
+  DC.Gov_StartTime = now;
+  DC.Gov_DisplayTime = 0;
+  DC.Gov_VSyncTime = 0;
+}
+
+static void SDD_Name(Governor)(ARMul_State *state)
+{
+  uint64_t now, wall, display, emu, drawcost, limit;
+  uint32_t target, rows, redrawn;
+  int frames, skip, maxskip;
+  bool met;
+
+  if(!DisplayDev_Governor)
+  {
+    DC.Gov_Frames = -1;
+    DC.RowsAtOnce = SDD_RowsAtOnce;
+    return;
+  }
+
+  now = HostTime_Now();
+  if(DC.Gov_Frames < 0)
+  {
+    /* Just been enabled */
+    DC.Gov_RowsAtOnce = SDD_RowsAtOnce;
+    DC.Gov_FlagsBackoff = 1;
+    SDD_Name(GovernorRowsRedrawn)(state);
+    SDD_Name(GovernorReset)(state,now);
+    return;
+  }
+  if(++DC.Gov_Frames < GOVERNOR_PERIOD)
+    return;
+
+  /* Work out the cost of emulating a frame, and of drawing a frame */
+  frames = DC.Gov_Frames;
+  wall = now-DC.Gov_StartTime;
+  display = MIN(DC.Gov_DisplayTime,wall);
+  emu = wall-display;
+  emu -= MIN(DC.Gov_VSyncTime,emu);
+  emu /= frames;
+  drawcost = display/MAX(DC.Gov_Drawn,1);
+
+  /* Don't skip so much that we drop below GOVERNOR_MINFPS */
+  maxskip = GOVERNOR_MAXSKIP;
+  while((maxskip > 0) && ((maxskip+1)*emu + drawcost > 1000000/GOVERNOR_MINFPS))
+    maxskip--;
+
+  target = EmuRate_GetTarget(state);
+  limit = 0;
+  if(target)
+    limit = ((uint64_t) (uint32_t) (ARMul_Time-DC.Gov_StartCycle))*1000000/target/frames;
+  met = false;
+  for(skip=0;skip<=maxskip;skip++)
+  {
+    uint64_t cost = drawcost/(skip+1);
+    if(target ? (emu+cost <= limit) : (cost*100 <= (emu+cost)*GOVERNOR_SHARE))
+    {
+      met = true;
+      break;
+    }
+  }
+  if(!met)
+    skip = maxskip;
+
+  if(skip > DisplayDev_FrameSkip)
+  {
+    VIDEO_STAT(GovernorSkipUp,1,1);
+    DisplayDev_FrameSkip = skip;
+  }
+  else if(skip < DisplayDev_FrameSkip)
+  {
+    /* Back off gradually, to avoid oscillating */
+    VIDEO_STAT(GovernorSkipDown,1,1);
+    DisplayDev_FrameSkip--;
+  }
+
+  if(!met && (DC.Gov_RowsAtOnce < GOVERNOR_MAXROWS))
+  {
+    VIDEO_STAT(GovernorRowsUp,1,1);
+    DC.Gov_RowsAtOnce *= 2;
+  }
+  else if(met && !skip && (DC.Gov_RowsAtOnce > SDD_RowsAtOnce))
+  {
+    VIDEO_STAT(GovernorRowsDown,1,1);
+    DC.Gov_RowsAtOnce /= 2;
+  }
+
+  /* Decide whether UpdateFlags are worth it */
+  rows = DC.Gov_Rows;
+  redrawn = SDD_Name(GovernorRowsRedrawn)(state);
+  if(DisplayDev_UseUpdateFlags)
+  {
+    if(rows && (((uint64_t) redrawn)*100 >= ((uint64_t) rows)*GOVERNOR_FLAGSOFF))
+    {
+      VIDEO_STAT(GovernorFlagsOff,1,1);
+      DisplayDev_UseUpdateFlags = false;
+      ARMul_RebuildFastMap(state);
+      /* The row hashes weren't kept up to date while the flags were on */
+      DC.Gov_ForceRefresh = true;
+      /* If the flags were only just turned back on, wait longer before the next retry */
+      DC.Gov_FlagsWait = DC.Gov_FlagsBackoff;
+      DC.Gov_FlagsBackoff = MIN(DC.Gov_FlagsBackoff*2,GOVERNOR_MAXBACKOFF);
+    }
+    else
+      DC.Gov_FlagsBackoff = 1;
+  }
+  else if(DisplayDev_UseRowHashes ? (((uint64_t) redrawn)*100 <= ((uint64_t) rows)*GOVERNOR_FLAGSON) : (--DC.Gov_FlagsWait <= 0))
+  {
+    VIDEO_STAT(GovernorFlagsOn,1,1);
+    DisplayDev_UseUpdateFlags = true;
+    ARMul_RebuildFastMap(state);
+    /* Ensure the updateflags get reset */
+    DC.Gov_ForceRefresh = true;
+    DC.FrameSkip = 0;
+  }
+
+  dbug_vidc("Governor: emu %uus draw %uus limit %uus -> frameskip %d, %d rows per event, UpdateFlags %s\n",(unsigned) emu,(unsigned) drawcost,(unsigned) limit,DisplayDev_FrameSkip,DC.Gov_RowsAtOnce,(DisplayDev_UseUpdateFlags?"on":"off"));
+
+  SDD_Name(GovernorReset)(state,now);
+}
+
 /*
 
   EventQ funcs
@@ -1855,7 +2725,15 @@ static void SDD_Name(Flyback)(ARMul_State *state)
 
   /* Trigger VSync */
   DC.FLYBK = true;
-  DisplayDev_VSync(state);
+  {
+    /* Don't count this as display time; it can include speed governor sleeps */
+    uint64_t start = HostTime_Now();
+    DisplayDev_VSync(state);
+    start = HostTime_Now()-start;
+    VIDEO_STAT(VSyncTime,1,start);
+    DC.Gov_VSyncTime += start;
+    DC.Gov_DisplayTime -= start;
+  }
 
   /* If EmuRate has just changed, recalculate the line rate now to try and keep things in sync */
   if(oldrate != ARMul_EmuRate)
@@ -1905,8 +2783,10 @@ static void SDD_Name(Reschedule)(ARMul_State *state,CycleCount nowtime,EventQ_Fu
 
 static void SDD_Name(DisplayEnd)(ARMul_State *state,CycleCount nowtime)
 {
+  uint64_t start = SDD_Name(TimeStart)();
   /* Go to FrameEnd, with a VSync trigger */
   SDD_Name(Reschedule)(state,nowtime,SDD_Name(FrameEnd),(VIDC.Vert_Cycle+1),true);
+  SDD_Name(TimeStop)(state,start);
 }
 
 static void SDD_Name(SkipFrame)(ARMul_State *state,CycleCount nowtime)
@@ -1916,7 +2796,7 @@ static void SDD_Name(SkipFrame)(ARMul_State *state,CycleCount nowtime)
   SDD_Name(Reschedule)(state,nowtime,SDD_Name(DisplayEnd),vsync+1,false);
 }
 
-static void SDD_Name(FrameStart)(ARMul_State *state,CycleCount nowtime)
+static void SDD_Name(NewFrame)(ARMul_State *state,CycleCount nowtime)
 {
   bool newDMAEn;
   /* Assuming a multiplier of 2, these are the required clock dividers
@@ -1960,6 +2840,14 @@ static void SDD_Name(FrameStart)(ARMul_State *state,CycleCount nowtime)
   DC.DMAEn = newDMAEn;
   VIDEO_STAT(ForceRefreshDMA,DC.ForceRefresh,1);
 
+  /* Governor runs just before this, so its refresh request must be applied
+     here rather than set directly */
+  if(DC.Gov_ForceRefresh)
+  {
+    DC.Gov_ForceRefresh = false;
+    DC.ForceRefresh = true;
+  }
+
   /* Ensure full palette rebuild & screen refresh on BPP change */
   if((DC.VIDC_CR & 0xc) != (NewCR & 0xc))
   {
@@ -2003,12 +2891,14 @@ static void SDD_Name(FrameStart)(ARMul_State *state,CycleCount nowtime)
     }
     FramePeriod = (VIDC.Horiz_Cycle*2+2)*(VIDC.Vert_Cycle+1);
     FrameRate = ClockIn/(FramePeriod*ClockDivider);
+    DC.RateNum = ClockIn;
+    DC.RateDen = FramePeriod*ClockDivider;
     
     if((Width != DC.LastHostWidth) || (Height != DC.LastHostHeight) || (FrameRate != DC.LastHostHz))
     {
       warn_vidc("New mode: %dx%d, %dHz (CR %x ClockIn %dMhz)\n",Width,Height,FrameRate,NewCR,(int)(ClockIn/2000000));
-#ifdef VIDEO_STATS
-      vidstats_Dump("Stats for previous mode");
+#ifdef SDD_Stats
+      SDD_Name(StatsDump)(state,"Stats for previous mode");
 #endif
       /* Try selecting new mode */
       if((Width < 1) || (Height < 1))
@@ -2031,13 +2921,15 @@ static void SDD_Name(FrameStart)(ARMul_State *state,CycleCount nowtime)
     DC.ModeChanged = false;
   }
 
-#ifdef VIDEO_STATS
-  if(vidstats[vidstat_DisplayFrames] >= 100)
-    vidstats_Dump("Stats for last 100 frames");
+#ifdef SDD_Stats
+  if(DC.Stats[vidstat_DisplayFrames] >= 100)
+  {
+    SDD_Name(StatsDump)(state,"Stats for last 100 frames");
+  }
 #endif
 
   /* Update AutoUpdateFlags */
-  if(DisplayDev_AutoUpdateFlags)
+  if(DisplayDev_AutoUpdateFlags && !DisplayDev_Governor)
   {
     DC.Auto_FrameCount++;
     if(DC.ForceRefresh || HD.RefreshFlags[0])
@@ -2056,6 +2948,8 @@ static void SDD_Name(FrameStart)(ARMul_State *state,CycleCount nowtime)
           DisplayDev_UseUpdateFlags = 0;
           DisplayDev_FrameSkip = DC.Auto_FrameCount/DC.Auto_ForceRefresh;
           ARMul_RebuildFastMap(state);
+          /* The row hashes weren't kept up to date while the flags were on */
+          DC.ForceRefresh = true;
         }
         DC.Auto_FrameCount = 0;
         DC.Auto_ForceRefresh = 0;
@@ -2099,8 +2993,9 @@ static void SDD_Name(FrameStart)(ARMul_State *state,CycleCount nowtime)
   else
   {
     /* Only update if forced, or frameskip has run out
-       We use the first RefreshFlags entry to detect if any DMA changes have occured since the start of the last frame. If any have, we redraw the entire screen */
-    if(DC.ForceRefresh || HD.RefreshFlags[0] || !DC.FrameSkip)
+       We use the first RefreshFlags entry to detect if any DMA changes have occured since the start of the last frame. If any have, we redraw the entire screen
+       With row hashes, every frame is processed; unchanged rows are cheap */
+    if(DC.ForceRefresh || HD.RefreshFlags[0] || !DC.FrameSkip || DisplayDev_UseRowHashes)
     {
       DC.FrameSkip = DisplayDev_FrameSkip;
       HD.RefreshFlags[0] = 0;
@@ -2117,20 +3012,51 @@ static void SDD_Name(FrameStart)(ARMul_State *state,CycleCount nowtime)
   }      
   
   /* Update host */
-  SDD_Name(Host_PollDisplay)(state);
+  DC.Gov_Drawn++;
+  {
+    uint64_t start = HostTime_Now();
+    SDD_Name(Host_PollDisplay)(state);
+    VIDEO_STAT(PresentTime,1,HostTime_Now()-start);
+  }
+  VIDEO_STAT(HostBytes,1,DisplayDev_HostBytes);
+  DisplayDev_HostBytes = 0;
+}
+
+static void SDD_Name(FrameStart)(ARMul_State *state,CycleCount nowtime)
+{
+  uint64_t start;
+  SDD_Name(Governor)(state);
+  start = SDD_Name(TimeStart)();
+  SDD_Name(NewFrame)(state,nowtime);
+  SDD_Name(TimeStop)(state,start);
 }
 
 static void SDD_Name(FrameEnd)(ARMul_State *state,CycleCount nowtime)
 {
+  uint64_t start = SDD_Name(TimeStart)();
   VIDEO_STAT(DisplayFrames,1,1);
 
+#ifdef SDD_RenderThread
+  /* Make sure the frame is complete before the host gets to see it */
+  SDD_Name(RenderSync)(state);
+#endif
+
   SDD_Name(Flyback)(state); /* Paranoia */
 
+  Capture_Frame(state,DC.RateNum,DC.RateDen);
+
   /* Set up the next frame */
   DC.LastRow = 0;
   DC.NextRow = VIDC.Vert_SyncWidth+1;
   nowtime = state->EventQ[0].Time; /* Ignore the supplied time and use the time the event was last scheduled for - should eliminate any slip/skew */
   EventQ_Reschedule(state,nowtime+DC.NextRow*DC.LineRate,SDD_Name(FrameStart),EventQ_Find2(state,SDD_Name(FrameEnd)));
+  SDD_Name(TimeStop)(state,start);
+
+  if(DisplayDev_StatsRequested)
+  {
+    DisplayDev_StatsRequested = 0;
+    SDD_Name(StatsDump)(state,"Stats since last dump");
+  }
 }
 
 static void SDD_Name(RowStart)(ARMul_State *state,CycleCount nowtime)
@@ -2140,6 +3066,7 @@ static void SDD_Name(RowStart)(ARMul_State *state,CycleCount nowtime)
   bool dmaen = DC.DMAEn;
   bool flybk = false;
   int row = DC.LastRow;
+  uint64_t start = SDD_Name(TimeStart)();
   if(row < VIDC.Vert_BorderStart+1)
     row = VIDC.Vert_BorderStart+1; /* Skip pre-border rows */
   while(row < stop)
@@ -2147,30 +3074,36 @@ static void SDD_Name(RowStart)(ARMul_State *state,CycleCount nowtime)
     if(row < (VIDC.Vert_DisplayStart+1))
     {
       /* Border region */
-      SDD_Name(BorderRow)(state,row);
+      SDD_Name(QueueRow)(state,row,ROWTYPE_BORDER);
     }
     else if(dmaen && (row < (VIDC.Vert_DisplayEnd+1)))
     {
       /* Display */
+      DC.Gov_Rows++;
       if(DisplayDev_UseUpdateFlags)
       {
-        SDD_Name(DisplayRow)(state,row);
+        SDD_Name(QueueRow)(state,row,ROWTYPE_DISPLAY);
+      }
+      else if(DisplayDev_UseRowHashes)
+      {
+        SDD_Name(QueueRow)(state,row,ROWTYPE_DISPLAYHASH);
       }
       else
       {
-        SDD_Name(DisplayRowNoFlags)(state,row);
+        SDD_Name(QueueRow)(state,row,ROWTYPE_DISPLAYNOFLAGS);
       }
     }
     else if(row < (VIDC.Vert_BorderEnd+1))
     {
       /* Border again */
       flybk = true;
-      SDD_Name(BorderRow)(state,row);
+      SDD_Name(QueueRow)(state,row,ROWTYPE_BORDER);
     }
     else
     {
       /* Reached end of screen */
       SDD_Name(Reschedule)(state,nowtime,SDD_Name(FrameEnd),VIDC.Vert_Cycle+1,flybk);
+      SDD_Name(TimeStop)(state,start);
       return;
     }
     VIDEO_STAT(DisplayRows,1,1);
@@ -2182,10 +3115,11 @@ static void SDD_Name(RowStart)(ARMul_State *state,CycleCount nowtime)
     flybk = true;
   }
   /* Skip ahead to next row */
-  nextrow = row+SDD_RowsAtOnce;
-  if((SDD_RowsAtOnce > 1) && (row <= VIDC.Vert_Cycle) && (nextrow > VIDC.Vert_Cycle+1))
+  nextrow = row+DC.RowsAtOnce;
+  if((DC.RowsAtOnce > 1) && (row <= VIDC.Vert_Cycle) && (nextrow > VIDC.Vert_Cycle+1))
     nextrow = VIDC.Vert_Cycle+1;
   SDD_Name(Reschedule)(state,nowtime,SDD_Name(RowStart),nextrow,flybk);
+  SDD_Name(TimeStop)(state,start);
 }
 
 /*
@@ -2389,6 +3323,7 @@ static int SDD_Name(Init)(ARMul_State *state,const struct Vidc_Regs *Vidc)
 
   DC.ModeChanged = true;
   DC.LastHostWidth = DC.LastHostHeight = DC.LastHostHz = -1;
+  DC.RateNum = DC.RateDen = 0;
   DC.DirtyPalette = 65535;
   DC.NextRow = 0;
   DC.LastRow = 0;
@@ -2398,14 +3333,50 @@ static int SDD_Name(Init)(ARMul_State *state,const struct Vidc_Regs *Vidc)
   DC.FLYBK = false;
   DC.LineRate = 10000;
   DC.LastVinit = MEMC.Vinit;
+  DC.RowsAtOnce = SDD_RowsAtOnce;
+  DC.Gov_Frames = -1;
+  DC.Gov_ForceRefresh = false;
   HD.BorderCol = SDD_Name(Host_GetColour)(state,VIDC.BorderCol);
+#ifdef SDD_DirectRow
+  HD.RowConv = RowConv_Get(sizeof(SDD_HostColour));
+#endif
 
   memset(HOSTDISPLAY.RefreshFlags,0xff,sizeof(HOSTDISPLAY.RefreshFlags));
   memset(HOSTDISPLAY.UpdateFlags,0,sizeof(HOSTDISPLAY.UpdateFlags)); /* Initial value in MEMC.UpdateFlags is 1 */   
 
+#ifdef SDD_RenderThread
+  pthread_mutex_init(&RENDER.Mutex,NULL);
+  pthread_cond_init(&RENDER.Queued,NULL);
+  pthread_cond_init(&RENDER.Drawn,NULL);
+  {
+    int i,num = SDD_RenderThreads;
+    if(num < 1)
+      num = 1;
+    else if(num > ROWQUEUE_THREADS)
+      num = ROWQUEUE_THREADS;
+    for(i=0;i<num;i++)
+    {
+      struct SDD_Name(RenderWorker) *worker = &RENDER.Threads[RENDER.NumThreads];
+      worker->state = state;
+      if(pthread_create(&worker->Thread,NULL,SDD_Name(RenderThread),worker))
+        break;
+      RENDER.NumThreads++;
+    }
+    if(!RENDER.NumThreads) {
+      warn_vidc("Failed to create render thread, rendering on main thread instead\n");
+    }
+  }
+#endif
+
   /* Schedule first update event */
   EventQ_Insert(state,ARMul_Time+100,SDD_Name(FrameStart));
 
+#ifdef SIGUSR1
+  SDD_Name(PrevStatsSignal) = signal(SIGUSR1,SDD_Name(StatsSignal));
+  if(SDD_Name(PrevStatsSignal) == SIG_ERR)
+    SDD_Name(PrevStatsSignal) = SIG_DFL;
+#endif
+
   return 0;
 }
 
@@ -2424,6 +3395,25 @@ static void SDD_Name(Shutdown)(ARMul_State *state)
   {
     ControlPane_Error(EXIT_FAILURE,"Couldn't find SDD event func!\n");
   }
+#ifdef SIGUSR1
+  signal(SIGUSR1,SDD_Name(PrevStatsSignal));
+#endif
+#ifdef SDD_RenderThread
+  if(RENDER.NumThreads)
+  {
+    int i;
+    SDD_Name(RenderSync)(state);
+    pthread_mutex_lock(&RENDER.Mutex);
+    RENDER.Quit = true;
+    pthread_cond_broadcast(&RENDER.Queued);
+    pthread_mutex_unlock(&RENDER.Mutex);
+    for(i=0;i<RENDER.NumThreads;i++)
+      pthread_join(RENDER.Threads[i].Thread,NULL);
+  }
+  pthread_cond_destroy(&RENDER.Drawn);
+  pthread_cond_destroy(&RENDER.Queued);
+  pthread_mutex_destroy(&RENDER.Mutex);
+#endif
   free(state->Display);
   state->Display = NULL;
 }
@@ -2458,4 +3448,11 @@ const DisplayDev SDD_DisplayDev = {
 #undef ROWFUNC_FORCE
 #undef ROWFUNC_UPDATEFLAGS
 #undef ROWFUNC_UPDATED
+#undef ROWTYPE_BORDER
+#undef ROWTYPE_DISPLAY
+#undef ROWTYPE_DISPLAYNOFLAGS
+#ifdef SDD_RenderThread
+#undef ROWQUEUE_SIZE
+#undef ROWQUEUE_FLAGS
+#endif
 
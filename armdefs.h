@@ -180,18 +180,21 @@ typedef struct {
   EventQ_Func Func;    /* Function to call */
 } EventQ_Entry;
 
-#define EVENTQ_SIZE 8
+#define EVENTQ_INITIAL_SIZE 8
 
-/* NOTE - For speed reasons there aren't any overflow checks in the eventq
-          code, so be aware of how many systems are using the queue. At the
-          moment, these are:
+/* NOTE - The queue is a 4-ary heap which grows on demand, so there's no hard
+          limit on the number of systems using it. The index values returned
+          by the eventq functions are only valid until the next modification
+          of the queue; use EventQ_Find to locate an event again afterwards.
+          At the moment, the users are:
 
           arch/newsound.c - One entry for sound DMA fetches
           arch/XXXdisplaydev.c - One entry for screen updates
           arch/keyboard.c - One entry for keyboard/mouse polling
-          arch/archio.c - One entry for IOC timers
-          arch/archio.c - One entry for FDC & HDC updates
-        = 5 total
+          arch/keyboard.c - One entry while a byte is sent to the keyboard
+          arch/archio.c - One entry for IOC timers, only while timer 0 or 1 can interrupt
+          arch/fdc1772.c - One entry while a floppy command is active
+          arch/hdc63463.c - One entry while a hard disc command is active
 */
 
 /***************************************************************************\
@@ -232,8 +235,9 @@ struct ARMul_State {
    ArcemConfig *Config;
 
    /* Event queue */
-   EventQ_Entry EventQ[EVENTQ_SIZE];
-   uint_fast8_t NumEvents;
+   EventQ_Entry *EventQ;      /* Heap storage, EventQ[0] is the next event */
+   int NumEvents;
+   int EventQSize;            /* Allocated size of EventQ */
 
    /* Fastmap stuff */
    FastMapUInt FastMapMode;   /* Current access mode flags */
@@ -329,9 +333,15 @@ extern uint32_t ARMul_EmuRate;
 /* Reset the EmuRate code, to cope with situations where the emulator has just been resumed after being suspended for a period of time (i.e. > 1 second) */
 void EmuRate_Reset(ARMul_State *state);
 
-/* Update the EmuRate value. Note: Manipulates event queue! */
+/* Update the EmuRate value, and pace the emulation if a speed limit is set. Note: Manipulates event queue! */
 void EmuRate_Update(ARMul_State *state);
 
+/* Measured emulation speed, as a percentage of a real 8MHz ARM2 */
+uint32_t EmuRate_GetSpeedPercent(void);
+
+/* Cycle rate the speed governor is aiming for, or 0 if the speed is unlimited */
+uint32_t EmuRate_GetTarget(ARMul_State *state);
+
 #include "arch/archio.h"
 #include "arch/armarc.h"
 #include "eventq.h"
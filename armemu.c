@@ -20,9 +20,10 @@
 #include "armdefs.h"
 #include "armemu.h"
 #include "armcopro.h"
-#include <time.h>
 #include "prof.h"
 #include "arch/archio.h"
+#include "arch/ArcemConfig.h"
+#include "arch/hosttime.h"
 #include "ControlPane.h"
 
 ARMul_State statestr;
@@ -1022,28 +1023,72 @@ done:
 \***************************************************************************/
 
 static CycleCount EmuRate_LastUpdateCycle;
-static clock_t EmuRate_LastUpdateTime;
+static uint64_t EmuRate_LastUpdateTime; /* In microseconds */
 uint32_t ARMul_EmuRate = 1000000; /* Start with safe value of 1MHz */
 
+/* Speed governor state: the emulated cycle count and the host time at which
+   we were (ideally) at that point in the emulation */
+static CycleCount Governor_BaseCycle;
+static uint64_t Governor_BaseTime;
+
+#define EMURATE_REALTIME 8000000 /* Cycle rate of a real 8MHz ARM2 */
+#define GOVERNOR_MAXLAG 100000 /* Give up trying to catch up if we're more than 100ms behind */
+
 void EmuRate_Reset(ARMul_State *state)
 {
   /* Reset the EmuRate code */
-  EmuRate_LastUpdateCycle = ARMul_Time;
-  EmuRate_LastUpdateTime = clock();
+  EmuRate_LastUpdateCycle = Governor_BaseCycle = ARMul_Time;
+  EmuRate_LastUpdateTime = Governor_BaseTime = HostTime_Now();
+}
+
+static void EmuRate_Govern(ARMul_State *state,CycleCount nowcycle)
+{
+  uint64_t target, due, nowtime;
+  if(!CONFIG.uSpeedLimit)
+    return;
+  /* Work out when we should reach nowcycle */
+  target = (((uint64_t) EMURATE_REALTIME)*CONFIG.uSpeedLimit)/100;
+  due = Governor_BaseTime + (((uint64_t) (uint32_t) (nowcycle-Governor_BaseCycle))*1000000)/target;
+  nowtime = HostTime_Now();
+  if(due > nowtime)
+  {
+    /* Running too fast. If the host can't sleep there's nothing we can do */
+    HostTime_Sleep((uint32_t) MIN(due-nowtime,GOVERNOR_MAXLAG));
+  }
+  else if(nowtime-due > GOVERNOR_MAXLAG)
+  {
+    /* Too far behind (slow host, or we've been suspended), don't try to catch up */
+    due = nowtime;
+  }
+  /* Rebase, so that the cycle difference never overflows */
+  Governor_BaseCycle = nowcycle;
+  Governor_BaseTime = due;
+}
+
+uint32_t EmuRate_GetSpeedPercent(void)
+{
+  return ARMul_EmuRate/(EMURATE_REALTIME/100);
+}
+
+uint32_t EmuRate_GetTarget(ARMul_State *state)
+{
+  return (uint32_t) ((((uint64_t) EMURATE_REALTIME)*CONFIG.uSpeedLimit)/100);
 }
 
 void EmuRate_Update(ARMul_State *state)
 {
-  uint64_t iocrate;
-  clock_t nowtime, timediff;
+  uint64_t iocrate, nowtime, timediff;
   CycleCount nowcycle = ARMul_Time;
-  CycleDiff cycles = nowcycle-EmuRate_LastUpdateCycle;
+  CycleDiff cycles;
+  /* Pace the emulation first, so that the measured rate includes the time spent sleeping */
+  EmuRate_Govern(state,nowcycle);
+  cycles = nowcycle-EmuRate_LastUpdateCycle;
   /* Ignore if not much time has passed */
   if(cycles < 40000)
     return;
-  nowtime = clock();
+  nowtime = HostTime_Now();
   timediff = nowtime-EmuRate_LastUpdateTime;
-  if(timediff < 10)
+  if(timediff < 10000)
     return;
 
   EmuRate_LastUpdateCycle = nowcycle;
@@ -1059,11 +1104,11 @@ void EmuRate_Update(ARMul_State *state)
   ARMul_EmuRate = 8000000;
 #else
   {
-  uint32_t newrate = (uint32_t) ((((double)cycles)*CLOCKS_PER_SEC)/timediff);
+  uint32_t newrate = (uint32_t) ((((double)cycles)*1000000)/timediff);
   /* Clamp to a sensible minimum value, just in case something crazy happens */
   if(newrate < 1000000)
     newrate = 1000000;
-  /* Smooth the value a bit, in case of sudden jumps, and to cope with systems with poor clock() granularity */
+  /* Smooth the value a bit, in case of sudden jumps, and to cope with systems with poor clock granularity */
   ARMul_EmuRate = (ARMul_EmuRate*3+newrate)>>2;
   }
 #endif
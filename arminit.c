@@ -21,6 +21,7 @@
 #include "armarc.h"
 #include "arch/ArcemConfig.h"
 #include "arch/dbugsys.h"
+#include "arch/hdc63463.h"
 #include "hostfs.h"
 
 FastMapEntry FastMap[FASTMAP_SIZE];
@@ -140,6 +141,7 @@ ARMul_State *ARMul_NewState(ArcemConfig *pConfig)
 
 void ARMul_FreeState(ARMul_State *state)
 {
+ EventQ_Free(state);
  state_free(state);
 }
 
@@ -222,6 +224,9 @@ void ARMul_Abort(ARMul_State *state, ARMword vector) {
          if ((instr & 0xfdffc0) == ARCEM_SWI_CHUNK) {
            switch (instr & 0x3f) {
            case ARCEM_SWI_SHUTDOWN-ARCEM_SWI_CHUNK:
+             /* Make sure the guest's last writes are on disc before it's
+                told it's safe to power off */
+             HDC_Sync();
              ARMul_Exit(state,state->Reg[0] & 0xff);
              break;
 #ifdef HOSTFS_SUPPORT
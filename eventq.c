@@ -11,7 +11,10 @@
   so real-time events will need an extra helping hand (e.g. ARMul_EmuRate)
 */
 
+#include <stdlib.h>
+
 #include "eventq.h"
+#include "ControlPane.h"
 
 static void DummyEventFunc(ARMul_State *state,CycleCount nowtime)
 {
@@ -20,9 +23,35 @@ static void DummyEventFunc(ARMul_State *state,CycleCount nowtime)
 }
 
 void EventQ_Init(ARMul_State *state)
+{
+	state->EventQSize = EVENTQ_INITIAL_SIZE;
+	state->EventQ = (EventQ_Entry *) malloc(sizeof(EventQ_Entry)*EVENTQ_INITIAL_SIZE);
+	if(!state->EventQ)
+		ControlPane_Error(1,"Failed to allocate event queue\n");
+	EventQ_Reset(state);
+}
+
+void EventQ_Free(ARMul_State *state)
+{
+	free(state->EventQ);
+	state->EventQ = NULL;
+	state->NumEvents = state->EventQSize = 0;
+}
+
+void EventQ_Reset(ARMul_State *state)
 {
 	/* When empty, the first entry in the queue is a dummy entry so that the main loop doesn't have to worry about checking for an empty queue */
 	state->NumEvents = 0;
 	state->EventQ[0].Time = ARMul_Time+MAX_CYCLES_INTO_FUTURE;
 	state->EventQ[0].Func = DummyEventFunc;
 }
+
+void EventQ_Grow(ARMul_State *state)
+{
+	int newsize = state->EventQSize*2;
+	EventQ_Entry *newq = (EventQ_Entry *) realloc(state->EventQ,sizeof(EventQ_Entry)*newsize);
+	if(!newq)
+		ControlPane_Error(1,"Failed to grow event queue to %d entries\n",newsize);
+	state->EventQ = newq;
+	state->EventQSize = newsize;
+}
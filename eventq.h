@@ -10,13 +10,15 @@
   Events are scheduled using the cycle counter (ARMul_Time) as the time base,
   so real-time events will need an extra helping hand (e.g. ARMul_EmuRate)
 
+  The queue is a growable 4-ary min-heap. EventQ[0] is always the next event
+  to fire, so the main loop can peek at it without any extra work.
+
   See also armdefs.h for more docs
 */
 
 #ifndef EVENTQ_H
 #define EVENTQ_H
 
-#include <string.h>
 #include "armdefs.h"
 
 /* Event queue functions */
@@ -24,57 +26,108 @@
 /* Initialise the queue */
 extern void EventQ_Init(ARMul_State *state);
 
+/* Free the queue storage */
+extern void EventQ_Free(ARMul_State *state);
+
+/* Empty the queue, leaving just the dummy head entry */
+extern void EventQ_Reset(ARMul_State *state);
+
+/* Double the size of the queue storage */
+extern void EventQ_Grow(ARMul_State *state);
+
+#define EVENTQ_PARENT(idx) (((idx)-1)>>2)
+#define EVENTQ_CHILD(idx) (((idx)<<2)+1)
+
+/* Internal: Move entry towards the head until the heap is valid, returns new index */
+static inline int EventQ_SiftUp(ARMul_State *state,EventQ_Entry entry,int idx)
+{
+	EventQ_Entry *q = state->EventQ;
+	while(idx > 0)
+	{
+		int parent = EVENTQ_PARENT(idx);
+		if(((CycleDiff) (q[parent].Time-entry.Time)) <= 0)
+			break;
+		q[idx] = q[parent];
+		idx = parent;
+	}
+	q[idx] = entry;
+	return idx;
+}
+
+/* Internal: Move entry away from the head until the heap is valid, returns new index */
+static inline int EventQ_SiftDown(ARMul_State *state,EventQ_Entry entry,int idx)
+{
+	EventQ_Entry *q = state->EventQ;
+	int num = state->NumEvents;
+	int child;
+	while((child = EVENTQ_CHILD(idx)) < num)
+	{
+		int best = child;
+		int end = MIN(child+4,num);
+		while(++child < end)
+		{
+			if(((CycleDiff) (q[child].Time-q[best].Time)) < 0)
+				best = child;
+		}
+		if(((CycleDiff) (q[best].Time-entry.Time)) >= 0)
+			break;
+		q[idx] = q[best];
+		idx = best;
+	}
+	q[idx] = entry;
+	return idx;
+}
+
+/* Internal: Place entry at idx, moving it up or down as necessary. Returns new index */
+static inline int EventQ_Place(ARMul_State *state,EventQ_Entry entry,int idx)
+{
+	if((idx > 0) && (((CycleDiff) (state->EventQ[EVENTQ_PARENT(idx)].Time-entry.Time)) > 0))
+		return EventQ_SiftUp(state,entry,idx);
+	return EventQ_SiftDown(state,entry,idx);
+}
+
 /* Remove an entry with a certain index */
 static inline void EventQ_Remove(ARMul_State *state,int idx)
 {
-	if(--state->NumEvents)
+	int last = --state->NumEvents;
+	if(last)
 	{
-		memmove(&state->EventQ[idx],&state->EventQ[idx+1],sizeof(EventQ_Entry)*(state->NumEvents-idx));
+		if(idx != last)
+			EventQ_Place(state,state->EventQ[last],idx);
 	}
 	else
 	{
-		EventQ_Init(state); /* Unlikely case */
+		EventQ_Reset(state); /* Unlikely case */
 	}
 }
 
 /* Reschedule an arbitrary entry, returns new index */
 static inline int EventQ_Reschedule(ARMul_State *state,CycleCount eventtime,EventQ_Func func,int idx)
 {
-	int top = state->NumEvents-1;
-	while((idx > 0) && (((CycleDiff) (state->EventQ[idx-1].Time-eventtime)) > 0))
-	{
-		state->EventQ[idx] = state->EventQ[idx-1];
-		idx--;
-	}
-	while((idx < top) && (((CycleDiff) (state->EventQ[idx+1].Time-eventtime)) < 0))
-	{
-		state->EventQ[idx] = state->EventQ[idx+1];
-		idx++;
-	}
-	state->EventQ[idx].Time = eventtime;
-	state->EventQ[idx].Func = func;
-	return idx;
+	EventQ_Entry entry;
+	entry.Time = eventtime;
+	entry.Func = func;
+	return EventQ_Place(state,entry,idx);
 }
 
 /* Reschedule the head entry, returns new index */
 static inline int EventQ_RescheduleHead(ARMul_State *state,CycleCount eventtime,EventQ_Func func)
 {
-	return EventQ_Reschedule(state,eventtime,func,0);
+	EventQ_Entry entry;
+	entry.Time = eventtime;
+	entry.Func = func;
+	return EventQ_SiftDown(state,entry,0);
 }
 
 /* Insert new entry, returns index */
 static inline int EventQ_Insert(ARMul_State *state,CycleCount eventtime,EventQ_Func func)
 {
-	/* Assume new events will occur far in the future, so insert from back */
-	int idx = state->NumEvents++;
-	while((idx > 0) && (((CycleDiff) (state->EventQ[idx-1].Time-eventtime)) > 0))
-	{
-		state->EventQ[idx] = state->EventQ[idx-1];
-		idx--;
-	}
-	state->EventQ[idx].Time = eventtime;
-	state->EventQ[idx].Func = func;
-	return idx;
+	EventQ_Entry entry;
+	if(state->NumEvents == state->EventQSize)
+		EventQ_Grow(state);
+	entry.Time = eventtime;
+	entry.Func = func;
+	return EventQ_SiftUp(state,entry,state->NumEvents++);
 }
 
 /* Return index of given event func, or -1 if not found */
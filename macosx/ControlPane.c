@@ -7,6 +7,7 @@
 #include "armarc.h"
 #include "ControlPane.h"
 #include "arch/dbugsys.h"
+#include "arch/hdc63463.h"
 
 #include <stdarg.h>
 #include <stdio.h>
@@ -26,10 +27,24 @@ void ControlPane_Error(int code,const char *fmt,...)
   log_msgv(LOG_ERROR,fmt,args);
   va_end(args);
 
+  /* Don't lose any disc changes that haven't been written back yet */
+  FDC_Sync();
+  HDC_Sync();
+
   /* Quit */
   exit(code);
 }
 
+void ControlPane_Warning(const char *fmt,...)
+{
+  va_list args;
+
+  /* Log it */
+  va_start(args,fmt);
+  log_msgv(LOG_WARN,fmt,args);
+  va_end(args);
+}
+
 void log_msgv(int type, const char *format, va_list ap)
 {
   if (type >= LOG_WARN)
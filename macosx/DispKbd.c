@@ -197,6 +197,14 @@ static void RefreshMouse(ARMul_State *state)
   } /* y */
 }
 
+/* There's no cheap way to tell whether there's input waiting, so always
+   let Kbd_PollHostKbd look */
+bool
+Kbd_HostInputPending(ARMul_State *state)
+{
+  return true;
+}
+
 int
 Kbd_PollHostKbd(ARMul_State *state)
 {
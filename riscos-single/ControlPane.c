@@ -7,6 +7,7 @@
 #include "armarc.h"
 #include "ControlPane.h"
 #include "arch/dbugsys.h"
+#include "arch/hdc63463.h"
 
 #include <stdarg.h>
 #include <stdio.h>
@@ -32,10 +33,23 @@ void ControlPane_Error(int code,const char *fmt,...)
   log_msgv(LOG_ERROR,"%s",buf);
   /* Report error */
   puts(buf);
+  /* Don't lose any disc changes that haven't been written back yet */
+  FDC_Sync();
+  HDC_Sync();
+
   /* Quit */
   exit(code);
 }
 
+void ControlPane_Warning(const char *fmt,...)
+{
+  va_list args;
+  /* The emulator owns the screen, so just log it */
+  va_start(args,fmt);
+  log_msgv(LOG_WARN,fmt,args);
+  va_end(args);
+}
+
 void log_msgv(int type, const char *format, va_list ap)
 {
   /* stdout is reserved for menu/stats display on RISC OS */
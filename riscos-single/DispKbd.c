@@ -906,6 +906,15 @@ static void MouseMoved(ARMul_State *state, int mousex, int mousey/*,XMotionEvent
 #endif
 } /* MouseMoved */
 
+/*----------------------------------------------------------------------------*/
+/* There's no cheap way to tell whether there's input waiting, so always
+   let Kbd_PollHostKbd look */
+bool
+Kbd_HostInputPending(ARMul_State *state)
+{
+  return true;
+}
+
 /*----------------------------------------------------------------------------*/
 int
 Kbd_PollHostKbd(ARMul_State *state)
@@ -1285,6 +1294,10 @@ static void GoMenu(ARMul_State *state)
         break;
     if(i==ITEM_QUIT)
     {
+      /* The display has been torn down, so exit straight away rather than
+         via ARMul_Exit; make sure the disc images are up to date first */
+      FDC_Sync();
+      HDC_Sync();
       exit(0);
     }
     else if(i==ITEM_RESUME)
@@ -37,8 +37,6 @@ volatile int sound_buffer_in=BUFFER_SAMPLES; /* Number of samples we've placed i
 volatile int sound_buffer_out=0; /* Number of samples read out by the IRQ routine */
 int sound_buff_mask=BUFFER_SAMPLES-1; /* For benefit of assembler code */
 int sound_rate = 1<<24; /* Fixed output rate! */
-static int buffer_threshold; /* Threshold value used to control desired buffer level; chosen based around the output sample rate & buffer_seconds */
-static float buffer_seconds = 0.2f; /* How much audio we want to try and keep buffered */ 
 
 extern void buffer_fill(void); /* Assembler function for performing the buffer fills */
 extern void error_handler(void); /* Assembler function attached to ErrorV */
@@ -148,16 +146,7 @@ static int init_sharedsound(void)
 #endif
 	/* Get our sample rate */
 	_swix(SharedSound_SampleRate,_INR(0,1)|_OUT(1),sound_handler_id,0,&Sound_HostRate);
-	/* Calculate the buffer threshold value
-	   This is the low threshold value, so we divide by 512 to get the desired level, then by two again to get the low level */
-	buffer_threshold = ((int)(buffer_seconds*((float)Sound_HostRate)))>>10;
-	/* Low thresholds may cause issues */
-	if(buffer_threshold<Sound_BatchSize*4)
-		buffer_threshold = Sound_BatchSize*4;
-	/* Big thresholds will cause problems too! */
-	if(buffer_threshold*4 > BUFFER_SAMPLES)
-		buffer_threshold = BUFFER_SAMPLES>>2;
-	warn_vidc("Host audio rate %dHz, using buffer threshold %d\n",Sound_HostRate>>10,buffer_threshold);
+	warn_vidc("Host audio rate %dHz\n",Sound_HostRate>>10);
 	return 0;
 }                           
 
@@ -235,34 +224,19 @@ void Sound_HostBuffered(SoundData *buffer,int32_t numSamples)
 
   sound_buffer_in += numSamples;
 
+  /* Report the fill level, for the latency controller */
+  Sound_HostFill = (used+numSamples)>>1;
+  Sound_HostCapacity = BUFFER_SAMPLES>>1;
+
   if(buffree == numSamples)
   {
     warn_vidc("*** sound overflow! ***\n");
-    if(Sound_FudgeRate < -10)
-      Sound_FudgeRate = Sound_FudgeRate/2;
-    else
-      Sound_FudgeRate+=10;
+    Sound_HostOverruns++;
   }
   else if(!used)
   {
     warn_vidc("*** sound underflow! ***\n");
-    if(Sound_FudgeRate > 10)
-      Sound_FudgeRate = Sound_FudgeRate/2;
-    else
-      Sound_FudgeRate-=10;
-  }
-  else if(used < buffer_threshold)
-  {
-    Sound_FudgeRate-=3;
-  }
-  else if(used < buffer_threshold*3)
-  {
-    Sound_FudgeRate+=3;
-  }
-  else if(Sound_FudgeRate)
-  {
-    /* Bring the fudge value back towards 0 until we go out of the comfort zone */
-    Sound_FudgeRate += (Sound_FudgeRate>0?-1:1);
+    Sound_HostUnderruns++;
   }
 }
 
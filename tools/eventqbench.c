@@ -0,0 +1,250 @@
+/*
+  tools/eventqbench.c
+
+  Part of Arcem released under the GNU GPL, see file COPYING
+  for details.
+
+  Microbenchmark for the event queue. Runs the same stream of operations
+  through the heap in eventq.h and through the sorted array that it
+  replaced, and reports the time per operation for a range of queue sizes.
+
+  The operation mix follows what the emulator does: mostly the head event
+  rescheduling itself (video rows, IOC timers, sound), plus some events being
+  moved by register writes and some one-shot events (disc, keyboard) being
+  inserted and removed again.
+
+  Every event time carries the event's number in its low bits, so no two
+  events are ever due at once and both queues see exactly the same sequence;
+  a checksum of the events fired is printed to show this.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../armdefs.h"
+#include "../eventq.h"
+#include "../arch/ControlPane.h"
+
+#define MAXKINDS 32
+#define KINDBITS 6
+#define KINDMASK ((1<<KINDBITS)-1)
+
+#define DEFAULT_OPS 20000000
+
+/* Percentage of operations that reschedule the head event; of the rest, most
+   move some other event and the remainder insert or remove a one-shot */
+#define MIX_HEAD 85
+#define MIX_MOVE 93
+
+/* eventq.c's only other dependency */
+void ControlPane_Error(int code,const char *fmt,...)
+{
+  (void) fmt;
+  fprintf(stderr, "eventqbench: event queue allocation failed\n");
+  exit(code);
+}
+
+/*------------------------------------------------------------------------------*/
+/* One handler per event, as the queue identifies events by their handler */
+
+#define HANDLER(n) static void Event##n(ARMul_State *state,CycleCount nowtime) { (void) state; (void) nowtime; }
+HANDLER(0) HANDLER(1) HANDLER(2) HANDLER(3) HANDLER(4) HANDLER(5) HANDLER(6) HANDLER(7)
+HANDLER(8) HANDLER(9) HANDLER(10) HANDLER(11) HANDLER(12) HANDLER(13) HANDLER(14) HANDLER(15)
+HANDLER(16) HANDLER(17) HANDLER(18) HANDLER(19) HANDLER(20) HANDLER(21) HANDLER(22) HANDLER(23)
+HANDLER(24) HANDLER(25) HANDLER(26) HANDLER(27) HANDLER(28) HANDLER(29) HANDLER(30) HANDLER(31)
+#undef HANDLER
+
+static const EventQ_Func Handlers[MAXKINDS] = {
+  Event0, Event1, Event2, Event3, Event4, Event5, Event6, Event7,
+  Event8, Event9, Event10, Event11, Event12, Event13, Event14, Event15,
+  Event16, Event17, Event18, Event19, Event20, Event21, Event22, Event23,
+  Event24, Event25, Event26, Event27, Event28, Event29, Event30, Event31,
+};
+
+/* Rough periods, in cycles, from a video row up to a frame */
+static const CycleCount Periods[8] = {512, 1024, 2000, 8000, 20000, 40000, 80000, 160000};
+
+/*------------------------------------------------------------------------------*/
+/* The old fixed size sorted array */
+
+typedef struct {
+  EventQ_Entry Q[MAXKINDS];
+  int Num;
+} OldQ;
+
+static inline void OldQ_Remove(OldQ *q,int idx)
+{
+  --q->Num;
+  memmove(&q->Q[idx],&q->Q[idx+1],sizeof(EventQ_Entry)*(q->Num-idx));
+}
+
+static inline int OldQ_Reschedule(OldQ *q,CycleCount eventtime,EventQ_Func func,int idx)
+{
+  int top = q->Num-1;
+  while((idx > 0) && (((CycleDiff) (q->Q[idx-1].Time-eventtime)) > 0))
+  {
+    q->Q[idx] = q->Q[idx-1];
+    idx--;
+  }
+  while((idx < top) && (((CycleDiff) (q->Q[idx+1].Time-eventtime)) < 0))
+  {
+    q->Q[idx] = q->Q[idx+1];
+    idx++;
+  }
+  q->Q[idx].Time = eventtime;
+  q->Q[idx].Func = func;
+  return idx;
+}
+
+static inline int OldQ_Insert(OldQ *q,CycleCount eventtime,EventQ_Func func)
+{
+  int idx = q->Num++;
+  while((idx > 0) && (((CycleDiff) (q->Q[idx-1].Time-eventtime)) > 0))
+  {
+    q->Q[idx] = q->Q[idx-1];
+    idx--;
+  }
+  q->Q[idx].Time = eventtime;
+  q->Q[idx].Func = func;
+  return idx;
+}
+
+static inline int OldQ_Find(OldQ *q,EventQ_Func func)
+{
+  int idx = q->Num;
+  while(--idx >= 0)
+  {
+    if(q->Q[idx].Func == func)
+      break;
+  }
+  return idx;
+}
+
+/*------------------------------------------------------------------------------*/
+static inline uint32_t Random(uint32_t *seed)
+{
+  uint32_t x = *seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *seed = x;
+}
+
+/* Time for event 'kind', roughly 'delay' cycles after 'now' */
+static inline CycleCount EventTime(CycleCount now,CycleCount delay,int kind)
+{
+  return ((now+delay) & ~(CycleCount) KINDMASK) + (1<<KINDBITS) + kind;
+}
+
+/* The benchmark loop, written once for both queues. 'kinds' events are
+   always queued; event 'kinds' is the one-shot. */
+#define BENCH_LOOP(HEAD, INSERT, FIND, REMOVE, RESCHEDULE, RESCHEDULEHEAD) \
+  for(op = 0; op < ops; op++) \
+  { \
+    CycleCount now = HEAD.Time; \
+    int kind = now & KINDMASK; \
+    uint32_t r = Random(&seed); \
+    sum = sum*31 + now; \
+    if((r % 100) < MIX_HEAD) \
+    { \
+      RESCHEDULEHEAD(EventTime(now, Periods[kind & 7] + ((r >> 8) & 255), kind), Handlers[kind]); \
+    } \
+    else if((r % 100) < MIX_MOVE) \
+    { \
+      int other = (r >> 8) % kinds; \
+      int idx = FIND(Handlers[other]); \
+      RESCHEDULE(EventTime(now, Periods[(r >> 16) & 7], other), Handlers[other], idx); \
+    } \
+    else \
+    { \
+      int idx = FIND(Handlers[kinds]); \
+      if(idx >= 0) \
+        REMOVE(idx); \
+      else \
+        INSERT(EventTime(now, Periods[(r >> 16) & 7], kinds), Handlers[kinds]); \
+    } \
+  }
+
+static double BenchOld(int kinds,uint32_t ops,uint32_t *check)
+{
+  OldQ q;
+  uint32_t seed = 12345, sum = 0, op;
+  clock_t start;
+  int i;
+
+  q.Num = 0;
+  for(i = 0; i < kinds; i++)
+    OldQ_Insert(&q, EventTime(0, Periods[i & 7], i), Handlers[i]);
+
+#define O_INSERT(t,f) OldQ_Insert(&q,t,f)
+#define O_FIND(f) OldQ_Find(&q,f)
+#define O_REMOVE(i) OldQ_Remove(&q,i)
+#define O_RESCHEDULE(t,f,i) OldQ_Reschedule(&q,t,f,i)
+#define O_RESCHEDULEHEAD(t,f) OldQ_Reschedule(&q,t,f,0)
+  start = clock();
+  BENCH_LOOP(q.Q[0], O_INSERT, O_FIND, O_REMOVE, O_RESCHEDULE, O_RESCHEDULEHEAD)
+  *check = sum;
+  return ((double) (clock()-start))/CLOCKS_PER_SEC;
+}
+
+static double BenchHeap(ARMul_State *state,int kinds,uint32_t ops,uint32_t *check)
+{
+  uint32_t seed = 12345, sum = 0, op;
+  clock_t start;
+  int i;
+
+  EventQ_Init(state);
+  for(i = 0; i < kinds; i++)
+    EventQ_Insert(state, EventTime(0, Periods[i & 7], i), Handlers[i]);
+
+#define H_INSERT(t,f) EventQ_Insert(state,t,f)
+#define H_FIND(f) EventQ_Find(state,f)
+#define H_REMOVE(i) EventQ_Remove(state,i)
+#define H_RESCHEDULE(t,f,i) EventQ_Reschedule(state,t,f,i)
+#define H_RESCHEDULEHEAD(t,f) EventQ_RescheduleHead(state,t,f)
+  start = clock();
+  BENCH_LOOP(state->EventQ[0], H_INSERT, H_FIND, H_REMOVE, H_RESCHEDULE, H_RESCHEDULEHEAD)
+  *check = sum;
+  EventQ_Free(state);
+  return ((double) (clock()-start))/CLOCKS_PER_SEC;
+}
+
+/*------------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+  static const int sizes[] = {4, 8, 16, 31};
+  uint32_t ops = DEFAULT_OPS;
+  ARMul_State *state;
+  unsigned int i;
+  int ok = 1;
+
+  if (argc > 2 || (argc == 2 && !(ops = (uint32_t) strtoul(argv[1], NULL, 0)))) {
+    fprintf(stderr, "Usage: %s [operations]\n", argv[0]);
+    return 1;
+  }
+
+  state = calloc(1, sizeof(ARMul_State));
+  if (!state) {
+    fprintf(stderr, "%s: out of memory\n", argv[0]);
+    return 1;
+  }
+
+  printf("%lu operations: %d%% reschedule head, %d%% move other, %d%% insert/remove one-shot\n",
+         (unsigned long) ops, MIX_HEAD, MIX_MOVE-MIX_HEAD, 100-MIX_MOVE);
+  printf("events  sorted array  4-ary heap  (ns/op, plus one one-shot event)\n");
+  for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+    uint32_t oldcheck, heapcheck;
+    double oldtime = BenchOld(sizes[i], ops, &oldcheck);
+    double heaptime = BenchHeap(state, sizes[i], ops, &heapcheck);
+    printf("%6d  %12.2f  %10.2f%s\n", sizes[i],
+           oldtime*1e9/ops, heaptime*1e9/ops,
+           (oldcheck == heapcheck ? "" : "  MISMATCH"));
+    if (oldcheck != heapcheck)
+      ok = 0;
+  }
+
+  free(state);
+  return ok ? 0 : 1;
+}
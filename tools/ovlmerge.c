@@ -0,0 +1,54 @@
+/*
+  tools/ovlmerge.c
+
+  Part of Arcem released under the GNU GPL, see file COPYING
+  for details.
+
+  Merges the changes held in a disc image overlay back into its base image.
+  The overlay is left alone; delete it afterwards if it's no longer wanted,
+  as it can't be used again once the base has changed.
+*/
+
+#include <stdio.h>
+
+#include "../arch/overlay.h"
+
+int main(int argc, char *argv[])
+{
+  const char *err;
+  Overlay *ov;
+  FILE *base;
+  int32_t count;
+
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <image> <overlay>\n", argv[0]);
+    return 1;
+  }
+
+  base = fopen(argv[1], "rb+");
+  if (!base) {
+    fprintf(stderr, "%s: couldn't open image %s\n", argv[0], argv[1]);
+    return 1;
+  }
+
+  ov = Overlay_Open(base, argv[2], false, &err);
+  if (!ov) {
+    fprintf(stderr, "%s: %s: %s\n", argv[0], argv[2], err);
+    fclose(base);
+    return 1;
+  }
+
+  count = Overlay_Merge(ov, base, &err);
+  Overlay_Close(ov);
+  if (fclose(base) && count >= 0) {
+    err = "couldn't write to image";
+    count = -1;
+  }
+  if (count < 0) {
+    fprintf(stderr, "%s: %s: %s\n", argv[0], argv[1], err);
+    return 1;
+  }
+
+  printf("Merged %ld blocks into %s\n", (long) count, argv[1]);
+  return 0;
+}
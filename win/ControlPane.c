@@ -7,6 +7,7 @@
 #include "armarc.h"
 #include "ControlPane.h"
 #include "arch/dbugsys.h"
+#include "arch/hdc63463.h"
 
 #include <stdarg.h>
 #include <stdio.h>
@@ -30,10 +31,28 @@ void ControlPane_Error(int code,const char *fmt,...)
   MessageBoxA(NULL, err, "ArcEm", MB_ICONERROR);
   va_end(args);
 
+  /* Don't lose any disc changes that haven't been written back yet */
+  FDC_Sync();
+  HDC_Sync();
+
   /* Quit */
   exit(code);
 }
 
+void ControlPane_Warning(const char *fmt,...)
+{
+  char err[100];
+  va_list args;
+
+  va_start(args,fmt);
+  vsnprintf(err, sizeof(err), fmt, args);
+  va_end(args);
+
+  /* Log it */
+  log_msg(LOG_WARN, "%s", err);
+  MessageBoxA(NULL, err, "ArcEm", MB_ICONWARNING);
+}
+
 void log_msgv(int type, const char *format, va_list ap)
 {
   if (type >= LOG_WARN)
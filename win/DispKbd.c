@@ -511,6 +511,15 @@ DisplayDev_Init(ARMul_State *state)
   return DisplayDev_Select(state,CONFIG.eDisplayDriver);
 }
 
+/*-----------------------------------------------------------------------------*/
+/* There's no cheap way to tell whether there's input waiting, so always
+   let Kbd_PollHostKbd look */
+bool
+Kbd_HostInputPending(ARMul_State *state)
+{
+  return true;
+}
+
 /*-----------------------------------------------------------------------------*/
 int
 Kbd_PollHostKbd(ARMul_State *state)